@@ -0,0 +1,67 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec3 a_Position;
+
+void main()
+{
+	gl_Position = vec4(a_Position, 1.0);
+}
+
+#shader fragment
+#version 330 core
+layout(location = 0) out vec4 o_Color;
+
+// Normalized iteration values (n / u_MaxIterations) produced by the CPU
+// renderer or the GPU fractal pass, one R32F texel per framebuffer pixel,
+// bottom row first. This pass is all a colour change has to redo.
+uniform sampler2D u_Iterations;
+uniform vec4      u_Color;
+
+// Period of each interior pixel cycle detection settled (R32UI, 0 for the
+// rest), from the CPU renderer or the GPU fractal pass. With
+// u_InteriorByPeriod set those pixels get a hue per period instead of black.
+uniform usampler2D u_Periods;
+uniform int        u_InteriorByPeriod;
+
+// Debug overlay: 1 where the CPU strategy filled the pixel instead of
+// iterating it (R8), only bound while u_ShowGuessed is set.
+uniform sampler2D u_Guessed;
+uniform int       u_ShowGuessed;
+
+vec3 MapToColor(float v)
+{
+	float r = 10.0 * u_Color.x * (1.0 - v) * v * v * v;
+	float g = 10.0 * u_Color.y * (1.0 - v) * (1.0 - v) * v * v;
+	float b = 10.0 * u_Color.z * (1.0 - v) * (1.0 - v) * (1.0 - v) * v;
+
+	// The 10x scaling combined with arbitrary u_Color components can drive
+	// channels above 1.0 (visible as saturated bands when displayed in sRGB).
+	return clamp(vec3(r, g, b), 0.0, 1.0);
+}
+
+// Golden-ratio steps around the hue circle, so that neighbouring periods
+// (a component and the bulbs on it) never look alike; dim, so the interior
+// stays darker than the boundary.
+vec3 PeriodToColor(uint period)
+{
+	float hue = fract(float(period) * 0.618034);
+	vec3 rgb = clamp(abs(fract(hue + vec3(0.0, 2.0 / 3.0, 1.0 / 3.0)) * 6.0 - 3.0) - 1.0, 0.0, 1.0);
+	return 0.35 * rgb;
+}
+
+
+void main()
+{
+	float pixelValue = texelFetch(u_Iterations, ivec2(gl_FragCoord.xy), 0).r;
+	vec3 color = MapToColor(pixelValue);
+	if (u_InteriorByPeriod != 0 && pixelValue >= 1.0)
+	{
+		uint period = texelFetch(u_Periods, ivec2(gl_FragCoord.xy), 0).r;
+		if (period > 0u)
+			color = PeriodToColor(period);
+	}
+	if (u_ShowGuessed != 0 && texelFetch(u_Guessed, ivec2(gl_FragCoord.xy), 0).r > 0.5)
+		color = mix(color, vec3(1.0, 0.0, 1.0), 0.5);
+	o_Color = vec4(color, 1.0);
+}
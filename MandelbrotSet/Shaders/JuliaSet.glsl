@@ -10,44 +10,212 @@ void main()
 
 #shader fragment
 #version 330 core
-layout(location = 0) out vec4 o_Color;
+// Normalized iterations only, into the R32F scene target; Colorize.glsl maps
+// them to colour in a separate pass, so colour changes need no re-iteration.
+layout(location = 0) out float o_Iterations;
+// Full frames also keep each pixel's orbit for a later, higher cap: (z, saved
+// z) of the pixels that ran out of iterations, their lo parts in float-float;
+// Settled in .z for every other pixel.
+layout(location = 1) out vec4 o_Orbit;
+layout(location = 2) out vec4 o_OrbitLo;
+// The period cycle detection found for an interior pixel, 0 for the rest,
+// into the R32UI period target; Colorize.glsl colours the interior by it.
+// (Location 3 is Mandelbrot.glsl's glitch flag.)
+layout(location = 4) out uint o_Period;
 
 uniform int   u_MaxIterations;
 uniform vec2  u_ScreenSize;
 uniform float u_Zoom;
 uniform vec2  u_Offset;
-uniform vec4  u_Color;
 uniform float u_RealComponent;
 uniform float u_ImaginaryComponent;
 
-float JuliaSet(vec2 c)
+// Mid-range zoom: z_0 is formed in float-float from u_Offset + u_OffsetLo.
+uniform bool  u_DoubleFloat;
+uniform vec2  u_OffsetLo;
+
+// Raised cap: u_ResumeFrom > 0 is the cap of the full frame in
+// u_PreviousIterations / u_PreviousOrbit(Lo). Settled pixels keep their
+// count, rescaled, and their period from u_PreviousPeriods; the others
+// continue their orbit from there, with cycle detection's last save at
+// iteration u_ResumeSavedAt.
+uniform int        u_ResumeFrom;
+uniform int        u_ResumeSavedAt;
+uniform sampler2D  u_PreviousIterations;
+uniform sampler2D  u_PreviousOrbit;
+uniform sampler2D  u_PreviousOrbitLo;
+uniform usampler2D u_PreviousPeriods;
+const float Settled = 1.0e30;
+
+// Brent cycle detection, as in Mandelbrot.glsl: z is saved after iterations
+// 1, 2, 4, 8, ... and an orbit back within PeriodTolerance pixels of it is
+// interior. Returns (normalized iterations, period or 0).
+const float PeriodTolerance = 1.0e-3;
+const int   PeriodCheckShift = 3;
+
+vec2 JuliaSet(vec2 c)
 {
+	float tolerance = PeriodTolerance / u_Zoom;
+	tolerance *= tolerance;
+
 	int n = 0;
 	vec2 z = c;
-	for (n = 0; n < u_MaxIterations; n++)
+	vec2 saved = z;
+	int savedAt = 0;
+	if (u_ResumeFrom > 0)
+	{
+		vec4 orbit = texelFetch(u_PreviousOrbit, ivec2(gl_FragCoord.xy), 0);
+		z = orbit.xy;
+		saved = orbit.zw;
+		savedAt = u_ResumeSavedAt;
+		n = u_ResumeFrom;
+	}
+	for (; n < u_MaxIterations; n++)
 	{
 		vec2 znew;
 		znew.x = (z.x * z.x) - (z.y * z.y) + u_RealComponent;
 		znew.y = (2.0 * z.x * z.y) + u_ImaginaryComponent;
 		z = znew;
 		if ((z.x * z.x) + (z.y * z.y) > 16.0) break;
+
+		int k = n + 1;
+		if (k - savedAt <= (savedAt >> PeriodCheckShift))
+		{
+			vec2 d = z - saved;
+			if ((d.x * d.x) + (d.y * d.y) < tolerance)
+				return vec2(1.0, float(k - savedAt));
+		}
+		if ((k & (k - 1)) == 0)
+		{
+			saved = z;
+			savedAt = k;
+		}
 	}
-	return n / float(u_MaxIterations);
+	if (n == u_MaxIterations)
+		o_Orbit = vec4(z, saved);
+	return vec2(n / float(u_MaxIterations), 0.0);
 }
 
-vec3 MapToColor(float v)
+// Float-float arithmetic: a value is the unevaluated sum hi + lo of a vec2,
+// giving ~48 significant bits out of fp32 (Dekker / Knuth, as in the CPU's
+// double-double kernels). Relies on the driver not contracting a * b + c
+// into an FMA, which would break TwoProduct's splitting.
+vec2 TwoSum(float a, float b)
 {
-	float r = 10.0 * u_Color.x * (1.0 - v) * v * v * v;
-	float g = 10.0 * u_Color.y * (1.0 - v) * (1.0 - v) * v * v;
-	float b = 10.0 * u_Color.z * (1.0 - v) * (1.0 - v) * (1.0 - v) * v;
+	float s = a + b;
+	float v = s - a;
+	return vec2(s, (a - (s - v)) + (b - v));
+}
 
-	return clamp(vec3(r, g, b), 0.0, 1.0);
+vec2 QuickTwoSum(float a, float b)
+{
+	float s = a + b;
+	return vec2(s, b - (s - a));
 }
 
+vec2 TwoProduct(float a, float b)
+{
+	const float splitter = 4097.0;   // 2^12 + 1
+	float p = a * b;
+	float ta = splitter * a;
+	float aHi = ta - (ta - a);
+	float aLo = a - aHi;
+	float tb = splitter * b;
+	float bHi = tb - (tb - b);
+	float bLo = b - bHi;
+	return vec2(p, (((aHi * bHi - p) + aHi * bLo) + aLo * bHi) + aLo * bLo);
+}
+
+vec2 FFAdd(vec2 a, vec2 b)
+{
+	vec2 s = TwoSum(a.x, b.x);
+	return QuickTwoSum(s.x, s.y + (a.y + b.y));
+}
+
+vec2 FFMul(vec2 a, vec2 b)
+{
+	vec2 p = TwoProduct(a.x, b.x);
+	return QuickTwoSum(p.x, p.y + (a.x * b.y + a.y * b.x));
+}
+
+vec2 JuliaSetDoubleFloat(vec2 pixelOffset)
+{
+	vec2 d = pixelOffset / u_Zoom;
+	vec2 zx = FFAdd(vec2(d.x, 0.0), -vec2(u_Offset.x, u_OffsetLo.x));
+	vec2 zy = FFAdd(vec2(d.y, 0.0), -vec2(u_Offset.y, u_OffsetLo.y));
+	vec2 cx = vec2(u_RealComponent, 0.0);
+	vec2 cy = vec2(u_ImaginaryComponent, 0.0);
+
+	float tolerance = PeriodTolerance / u_Zoom;
+	tolerance *= tolerance;
+
+	int n = 0;
+	vec2 savedX = zx;
+	vec2 savedY = zy;
+	int savedAt = 0;
+	if (u_ResumeFrom > 0)
+	{
+		vec4 orbit = texelFetch(u_PreviousOrbit, ivec2(gl_FragCoord.xy), 0);
+		vec4 orbitLo = texelFetch(u_PreviousOrbitLo, ivec2(gl_FragCoord.xy), 0);
+		zx = vec2(orbit.x, orbitLo.x);
+		zy = vec2(orbit.y, orbitLo.y);
+		savedX = vec2(orbit.z, orbitLo.z);
+		savedY = vec2(orbit.w, orbitLo.w);
+		savedAt = u_ResumeSavedAt;
+		n = u_ResumeFrom;
+	}
+	for (; n < u_MaxIterations; n++)
+	{
+		vec2 x = FFAdd(FFAdd(FFMul(zx, zx), -FFMul(zy, zy)), cx);
+		vec2 y = FFAdd(FFMul(2.0 * zx, zy), cy);
+		zx = x;
+		zy = y;
+		if ((zx.x * zx.x) + (zy.x * zy.x) > 16.0) break;
+
+		int k = n + 1;
+		if (k - savedAt <= (savedAt >> PeriodCheckShift))
+		{
+			float dx = (zx.x - savedX.x) + (zx.y - savedX.y);
+			float dy = (zy.x - savedY.x) + (zy.y - savedY.y);
+			if ((dx * dx) + (dy * dy) < tolerance)
+				return vec2(1.0, float(k - savedAt));
+		}
+		if ((k & (k - 1)) == 0)
+		{
+			savedX = zx;
+			savedY = zy;
+			savedAt = k;
+		}
+	}
+	if (n == u_MaxIterations)
+	{
+		o_Orbit = vec4(zx.x, zy.x, savedX.x, savedY.x);
+		o_OrbitLo = vec4(zx.y, zy.y, savedX.y, savedY.y);
+	}
+	return vec2(n / float(u_MaxIterations), 0.0);
+}
 
 void main()
 {
-	float pixelValue = JuliaSet(((gl_FragCoord.xy - u_ScreenSize / 2.0) / u_Zoom) - u_Offset);
-	vec3 color = MapToColor(pixelValue);
-	o_Color = vec4(color, 1.0);
+	o_Orbit = vec4(0.0, 0.0, Settled, 0.0);
+	o_OrbitLo = vec4(0.0);
+	if (u_ResumeFrom > 0)
+	{
+		// The count of a settled pixel, n / u_ResumeFrom, carried over to
+		// the new cap.
+		vec4 orbit = texelFetch(u_PreviousOrbit, ivec2(gl_FragCoord.xy), 0);
+		if (orbit.z == Settled)
+		{
+			float previous = texelFetch(u_PreviousIterations, ivec2(gl_FragCoord.xy), 0).r;
+			o_Iterations = previous < 1.0 ? round(previous * float(u_ResumeFrom)) / float(u_MaxIterations) : 1.0;
+			o_Period = texelFetch(u_PreviousPeriods, ivec2(gl_FragCoord.xy), 0).r;
+			return;
+		}
+	}
+
+	vec2 pixelValue = u_DoubleFloat ?
+		JuliaSetDoubleFloat(gl_FragCoord.xy - u_ScreenSize / 2.0) :
+		JuliaSet(((gl_FragCoord.xy - u_ScreenSize / 2.0) / u_Zoom) - u_Offset);
+	o_Iterations = pixelValue.x;
+	o_Period = uint(pixelValue.y);
 }
@@ -10,19 +10,118 @@ void main()
 
 #shader fragment
 #version 330 core
-layout(location = 0) out vec4 o_Color;
+// Normalized iterations only, into the R32F scene target; Colorize.glsl maps
+// them to colour in a separate pass, so colour changes need no re-iteration.
+layout(location = 0) out float o_Iterations;
+// Full frames also keep each pixel's orbit for a later, higher cap: (z, saved
+// z) of the pixels that ran out of iterations, their lo parts in float-float;
+// Settled in .z for every other pixel.
+layout(location = 1) out vec4 o_Orbit;
+layout(location = 2) out vec4 o_OrbitLo;
+// Perturbation frames flag the pixels whose result can't be trusted, as
+// Perturbation::IterateSpan() does; the CPU re-renders them against
+// references of their own.
+layout(location = 3) out float o_Glitched;
+// The period cycle detection found for an interior pixel, 0 for the rest,
+// into the R32UI period target; Colorize.glsl colours the interior by it.
+layout(location = 4) out uint o_Period;
 
 uniform int   u_MaxIterations;
 uniform vec2  u_ScreenSize;
 uniform float u_Zoom;
 uniform vec2  u_Offset;
-uniform vec4  u_Color;
 
-float Mandelbrot(vec2 fragCoord)
+// Mid-range zoom: c is formed in float-float from u_Offset + u_OffsetLo.
+uniform bool  u_DoubleFloat;
+uniform vec2  u_OffsetLo;
+
+// Raised cap: u_ResumeFrom > 0 is the cap of the full frame in
+// u_PreviousIterations / u_PreviousOrbit(Lo). Settled pixels keep their
+// count, rescaled, and their period from u_PreviousPeriods; the others
+// continue their orbit from there, with cycle detection's last save at
+// iteration u_ResumeSavedAt.
+uniform int        u_ResumeFrom;
+uniform int        u_ResumeSavedAt;
+uniform sampler2D  u_PreviousIterations;
+uniform sampler2D  u_PreviousOrbit;
+uniform sampler2D  u_PreviousOrbitLo;
+uniform usampler2D u_PreviousPeriods;
+const float Settled = 1.0e30;
+
+// Deep zoom (see Perturbation.h). u_Zoom / u_Offset are unused in this mode:
+// fp32 cannot hold c any more, so each pixel only iterates its offset from a
+// reference orbit computed on the CPU.
+uniform bool      u_Perturbation;
+uniform sampler2D u_ReferenceOrbit;     // RG32F, Z_n at (n % 1024, n / 1024)
+uniform int       u_ReferenceLength;
+uniform vec2      u_ReferencePixel;     // reference point, pixels from the screen centre
+uniform float     u_PixelScale;         // 1 / zoom == u_PixelScale * 2^u_PixelScaleExp
+uniform int       u_PixelScaleExp;
+
+// Series approximation: d at n = u_SeriesSkip is sum_k b_k u^k, u = pixel
+// offset / u_SeriesRadius, with b_k == u_SeriesCoefficients[k] * 2^u_SeriesExp.
+uniform int   u_SeriesSkip;
+uniform int   u_SeriesTerms;
+uniform float u_SeriesRadius;
+uniform vec2  u_SeriesCoefficients[8];
+uniform int   u_SeriesExp;
+
+// Perturbation::GlitchTolerance: once |Z_n + d_n|^2 drops below this much of
+// |Z_n|^2 the delta has cancelled the reference down to its rounding noise.
+const float GlitchTolerance = 1.0e-6;
+
+// Closed-form test for the main cardioid, q (q + x - 1/4) <= y^2 / 4 with
+// q = (x - 1/4)^2 + y^2, and the period-2 disc |c + 1| <= 1/4. Points inside
+// never escape, so they skip straight to the u_MaxIterations result; in an
+// overview that is most of the set's interior. Returns the component's
+// period (1 or 2), 0 outside both. Same operation order as
+// MainComponentPeriod() in Fractal.h.
+int MainComponentPeriod(vec2 c)
+{
+	float y2 = c.y * c.y;
+	float x = c.x - 0.25;
+	float q = x * x + y2;
+	if (q * (q + x) <= 0.25 * y2)
+		return 1;
+	float x1 = c.x + 1.0;
+	return x1 * x1 + y2 <= 0.0625 ? 2 : 0;
+}
+
+// Brent cycle detection (PeriodTolerance / PeriodCheckShift in Fractal.h):
+// z is saved after iterations 1, 2, 4, 8, ...; an orbit that comes back within
+// PeriodTolerance pixels of the saved z (checked over the first eighth of
+// each save interval) has settled on an attracting cycle and counts as
+// interior, with period = iterations since the save.
+const float PeriodTolerance = 1.0e-3;
+const int   PeriodCheckShift = 3;
+
+// The escape functions return (normalized iterations, period), the period
+// being 0 unless the pixel was found to be interior.
+vec2 Mandelbrot(vec2 fragCoord)
 {
+	float tolerance = PeriodTolerance / u_Zoom;
+	tolerance *= tolerance;
+
 	int n = 0;
 	vec2 z = vec2(0.0);
-	for (n = 0; n < u_MaxIterations; n++)
+	vec2 saved = z;
+	int savedAt = 0;
+	if (u_ResumeFrom > 0)
+	{
+		vec4 orbit = texelFetch(u_PreviousOrbit, ivec2(gl_FragCoord.xy), 0);
+		z = orbit.xy;
+		saved = orbit.zw;
+		savedAt = u_ResumeSavedAt;
+		n = u_ResumeFrom;
+	}
+	else
+	{
+		int period = MainComponentPeriod(fragCoord);
+		if (period > 0)
+			return vec2(1.0, float(period));
+	}
+
+	for (; n < u_MaxIterations; n++)
 	{
 		vec2 znew;
 		znew.x = (z.x * z.x) - (z.y * z.y) + fragCoord.x;
@@ -30,25 +129,259 @@ float Mandelbrot(vec2 fragCoord)
 		z = znew;
 		if ((z.x * z.x) + (z.y * z.y) > 16.0)
 			break;
+
+		int k = n + 1;
+		if (k - savedAt <= (savedAt >> PeriodCheckShift))
+		{
+			vec2 d = z - saved;
+			if ((d.x * d.x) + (d.y * d.y) < tolerance)
+				return vec2(1.0, float(k - savedAt));
+		}
+		if ((k & (k - 1)) == 0)
+		{
+			saved = z;
+			savedAt = k;
+		}
 	}
-	return n / float(u_MaxIterations);
+	if (n == u_MaxIterations)
+		o_Orbit = vec4(z, saved);
+	return vec2(n / float(u_MaxIterations), 0.0);
+}
+
+// Float-float arithmetic: a value is the unevaluated sum hi + lo of a vec2,
+// giving ~48 significant bits out of fp32 (Dekker / Knuth, as in the CPU's
+// double-double kernels). Relies on the driver not contracting a * b + c
+// into an FMA, which would break TwoProduct's splitting.
+vec2 TwoSum(float a, float b)
+{
+	float s = a + b;
+	float v = s - a;
+	return vec2(s, (a - (s - v)) + (b - v));
 }
 
-vec3 MapToColor(float v)
+vec2 QuickTwoSum(float a, float b)
 {
-	float r = 10.0 * u_Color.x * (1.0 - v) * v * v * v;
-	float g = 10.0 * u_Color.y * (1.0 - v) * (1.0 - v) * v * v;
-	float b = 10.0 * u_Color.z * (1.0 - v) * (1.0 - v) * (1.0 - v) * v;
+	float s = a + b;
+	return vec2(s, b - (s - a));
+}
 
-	// The 10x scaling combined with arbitrary u_Color components can drive
-	// channels above 1.0 (visible as saturated bands when displayed in sRGB).
-	return clamp(vec3(r, g, b), 0.0, 1.0);
+vec2 TwoProduct(float a, float b)
+{
+	const float splitter = 4097.0;   // 2^12 + 1
+	float p = a * b;
+	float ta = splitter * a;
+	float aHi = ta - (ta - a);
+	float aLo = a - aHi;
+	float tb = splitter * b;
+	float bHi = tb - (tb - b);
+	float bLo = b - bHi;
+	return vec2(p, (((aHi * bHi - p) + aHi * bLo) + aLo * bHi) + aLo * bLo);
 }
 
+vec2 FFAdd(vec2 a, vec2 b)
+{
+	vec2 s = TwoSum(a.x, b.x);
+	return QuickTwoSum(s.x, s.y + (a.y + b.y));
+}
+
+vec2 FFMul(vec2 a, vec2 b)
+{
+	vec2 p = TwoProduct(a.x, b.x);
+	return QuickTwoSum(p.x, p.y + (a.x * b.y + a.y * b.x));
+}
+
+// MainComponentPeriod() on a float-float c. The hi part alone would misplace
+// c by up to ~1e-7, hundreds of pixels at these zooms. With margin > 0 only
+// points inside by at least that much pass, for a c that is itself rounded.
+int MainComponentPeriodFF(vec2 cx, vec2 cy, float margin)
+{
+	vec2 y2 = FFMul(cy, cy);
+	vec2 x = FFAdd(cx, vec2(-0.25, 0.0));
+	vec2 q = FFAdd(FFMul(x, x), y2);
+	if (FFAdd(FFMul(q, FFAdd(q, x)), -0.25 * y2).x < -margin)
+		return 1;
+	vec2 x1 = FFAdd(cx, vec2(1.0, 0.0));
+	return FFAdd(FFAdd(FFMul(x1, x1), y2), vec2(-0.0625, 0.0)).x < -margin ? 2 : 0;
+}
+
+vec2 MandelbrotDoubleFloat(vec2 pixelOffset)
+{
+	vec2 d = pixelOffset / u_Zoom;
+	vec2 cx = FFAdd(vec2(d.x, 0.0), -vec2(u_Offset.x, u_OffsetLo.x));
+	vec2 cy = FFAdd(vec2(d.y, 0.0), -vec2(u_Offset.y, u_OffsetLo.y));
+
+	// Distances are taken on hi - hi plus lo - lo; the tolerance (~1e-3
+	// pixels) is far above what the lo parts can change.
+	float tolerance = PeriodTolerance / u_Zoom;
+	tolerance *= tolerance;
+
+	int n = 0;
+	vec2 zx = vec2(0.0);
+	vec2 zy = vec2(0.0);
+	vec2 savedX = zx;
+	vec2 savedY = zy;
+	int savedAt = 0;
+	if (u_ResumeFrom > 0)
+	{
+		vec4 orbit = texelFetch(u_PreviousOrbit, ivec2(gl_FragCoord.xy), 0);
+		vec4 orbitLo = texelFetch(u_PreviousOrbitLo, ivec2(gl_FragCoord.xy), 0);
+		zx = vec2(orbit.x, orbitLo.x);
+		zy = vec2(orbit.y, orbitLo.y);
+		savedX = vec2(orbit.z, orbitLo.z);
+		savedY = vec2(orbit.w, orbitLo.w);
+		savedAt = u_ResumeSavedAt;
+		n = u_ResumeFrom;
+	}
+	else
+	{
+		int period = MainComponentPeriodFF(cx, cy, 0.0);
+		if (period > 0)
+			return vec2(1.0, float(period));
+	}
+
+	for (; n < u_MaxIterations; n++)
+	{
+		vec2 x = FFAdd(FFAdd(FFMul(zx, zx), -FFMul(zy, zy)), cx);
+		vec2 y = FFAdd(FFMul(2.0 * zx, zy), cy);
+		zx = x;
+		zy = y;
+		if ((zx.x * zx.x) + (zy.x * zy.x) > 16.0)
+			break;
+
+		int k = n + 1;
+		if (k - savedAt <= (savedAt >> PeriodCheckShift))
+		{
+			float dx = (zx.x - savedX.x) + (zx.y - savedX.y);
+			float dy = (zy.x - savedY.x) + (zy.y - savedY.y);
+			if ((dx * dx) + (dy * dy) < tolerance)
+				return vec2(1.0, float(k - savedAt));
+		}
+		if ((k & (k - 1)) == 0)
+		{
+			savedX = zx;
+			savedY = zy;
+			savedAt = k;
+		}
+	}
+	if (n == u_MaxIterations)
+	{
+		o_Orbit = vec4(zx.x, zy.x, savedX.x, savedY.x);
+		o_OrbitLo = vec4(zx.y, zy.y, savedX.y, savedY.y);
+	}
+	return vec2(n / float(u_MaxIterations), 0.0);
+}
+
+vec2 ReferencePoint(int n)
+{
+	return texelFetch(u_ReferenceOrbit, ivec2(n & 1023, n >> 10), 0).rg;
+}
+
+// d_{n+1} = 2 Z_n d_n + d_n^2 + dc. Past ~1e38 zoom d no longer fits in fp32,
+// so it is carried as d = w * 2^e with w kept near 1 and e an int:
+//
+//     w' = 2 Z_n w + w^2 2^e + wc 2^(e0 - e)
+//
+// The last two terms underflow to 0 exactly when they are negligible next to
+// the first, so no precision is lost by letting exp2() flush them.
+//
+// No cycle detection here: at these zooms the tolerance is far below what
+// the fp32 deltas resolve. Only the closed-form test reports a period. Its
+// orbits are not kept: a raised cap redraws the frame. Pixels that trip the
+// glitch test, or outlive a reference that escaped before u_MaxIterations,
+// set o_Glitched.
+vec2 MandelbrotPerturbed(vec2 pixelOffset)
+{
+	// u_Offset + u_OffsetLo only carries the centre to ~48 bits, so the
+	// interior test needs a margin (Perturbation::InteriorMargin on the CPU).
+	vec2 d = (pixelOffset + u_ReferencePixel) * u_PixelScale * exp2(float(u_PixelScaleExp));
+	vec2 cx = FFAdd(vec2(d.x, 0.0), -vec2(u_Offset.x, u_OffsetLo.x));
+	vec2 cy = FFAdd(vec2(d.y, 0.0), -vec2(u_Offset.y, u_OffsetLo.y));
+	int period = MainComponentPeriodFF(cx, cy, 1.0e-12);
+	if (period > 0)
+		return vec2(1.0, float(period));
+
+	vec2 wc = pixelOffset * u_PixelScale;
+	vec2 w = vec2(0.0);
+	int e = u_PixelScaleExp;
+
+	if (u_SeriesSkip > 0)
+	{
+		vec2 u = pixelOffset / u_SeriesRadius;
+		vec2 uk = u;
+		for (int k = 0; k < u_SeriesTerms; k++)
+		{
+			vec2 b = u_SeriesCoefficients[k];
+			w += vec2(b.x * uk.x - b.y * uk.y, b.x * uk.y + b.y * uk.x);
+			uk = vec2(uk.x * u.x - uk.y * u.y, uk.x * u.y + uk.y * u.x);
+		}
+		e = u_SeriesExp;
+	}
+
+	int last = min(u_MaxIterations, u_ReferenceLength - 1);
+	int n = 0;
+	for (n = u_SeriesSkip; n < last; n++)
+	{
+		vec2 Z = ReferencePoint(n);
+		vec2 zw = vec2(Z.x * w.x - Z.y * w.y, Z.x * w.y + Z.y * w.x);
+		vec2 ww = vec2(w.x * w.x - w.y * w.y, 2.0 * w.x * w.y);
+		w = 2.0 * zw + ww * exp2(float(e)) + wc * exp2(float(u_PixelScaleExp - e));
+
+		// Renormalize in steps of 2^20 so w neither overflows nor drifts
+		// into denormals.
+		float m = max(abs(w.x), abs(w.y));
+		if (m > 1048576.0)
+		{
+			w *= 1.0 / 1048576.0;
+			e += 20;
+		}
+		else if (m < 1.0 / 1048576.0 && m > 0.0 && e - 20 >= u_PixelScaleExp)
+		{
+			w *= 1048576.0;
+			e -= 20;
+		}
+
+		vec2 next = ReferencePoint(n + 1);
+		vec2 z = next + w * exp2(float(e));
+		float norm = (z.x * z.x) + (z.y * z.y);
+		if (norm > 16.0)
+			break;
+		if (norm < GlitchTolerance * ((next.x * next.x) + (next.y * next.y)))
+		{
+			o_Glitched = 1.0;
+			break;
+		}
+	}
+	if (n == last && last < u_MaxIterations)
+		o_Glitched = 1.0;
+	return vec2(n / float(u_MaxIterations), 0.0);
+}
 
 void main()
 {
-	float pixelValue = Mandelbrot(((gl_FragCoord.xy - u_ScreenSize / 2.0) / u_Zoom) - u_Offset);
-	vec3 color = MapToColor(pixelValue);
-	o_Color = vec4(color, 1.0);
+	o_Orbit = vec4(0.0, 0.0, Settled, 0.0);
+	o_OrbitLo = vec4(0.0);
+	o_Glitched = 0.0;
+	if (u_ResumeFrom > 0)
+	{
+		// The count of a settled pixel, n / u_ResumeFrom, carried over to
+		// the new cap.
+		vec4 orbit = texelFetch(u_PreviousOrbit, ivec2(gl_FragCoord.xy), 0);
+		if (orbit.z == Settled)
+		{
+			float previous = texelFetch(u_PreviousIterations, ivec2(gl_FragCoord.xy), 0).r;
+			o_Iterations = previous < 1.0 ? round(previous * float(u_ResumeFrom)) / float(u_MaxIterations) : 1.0;
+			o_Period = texelFetch(u_PreviousPeriods, ivec2(gl_FragCoord.xy), 0).r;
+			return;
+		}
+	}
+
+	vec2 pixelValue;
+	if (u_Perturbation)
+		pixelValue = MandelbrotPerturbed(gl_FragCoord.xy - u_ScreenSize / 2.0 - u_ReferencePixel);
+	else if (u_DoubleFloat)
+		pixelValue = MandelbrotDoubleFloat(gl_FragCoord.xy - u_ScreenSize / 2.0);
+	else
+		pixelValue = Mandelbrot(((gl_FragCoord.xy - u_ScreenSize / 2.0) / u_Zoom) - u_Offset);
+	o_Iterations = pixelValue.x;
+	o_Period = uint(pixelValue.y);
 }
@@ -1,6 +1,9 @@
 #include "Application.h"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
@@ -20,6 +23,37 @@ namespace
 		std::fprintf(stderr, "[FATAL] %s\n", what);
 		std::exit(EXIT_FAILURE);
 	}
+
+	// Creates `texture` on first use and uploads a single-channel image to
+	// it, reallocating when the size changed. The colorize pass reads it
+	// with texelFetch, but a texture without NEAREST filtering and no
+	// mipmaps is incomplete and samples as black.
+	void UploadRedTexture(u32 &texture, u32 &textureWidth, u32 &textureHeight, u32 width, u32 height,
+		GLint internalFormat, GLenum type, const void *pixels, GLenum format = GL_RED)
+	{
+		if (texture == 0)
+		{
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (width != textureWidth || height != textureHeight)
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, (int) width, (int) height, 0, format, type, pixels);
+			textureWidth = width;
+			textureHeight = height;
+		}
+		else
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (int) width, (int) height, format, type, pixels);
+		}
+	}
 }
 
 Application *Application::s_Instance = nullptr;
@@ -61,9 +95,19 @@ Application::Application()
 
     m_MandelbrotShader.Load("Shaders/Mandelbrot.glsl");
     m_JuliaSetShader.Load("Shaders/JuliaSet.glsl");
+    m_ColorizeShader.Load("Shaders/Colorize.glsl");
 
     ImGuiUtil::CreateContext();
 
+    // Solid guessing renders one pass per frame, so a new view shows up
+    // coarse right away and sharpens over the next few frames.
+    m_CpuRenderer.SetProgressive(true);
+    m_CpuRenderer.SetRefineBudget(RefineBudget);
+    // Raising the iteration cap, by hand or automatically, then only costs
+    // the extra iterations of the pixels that ran out.
+    m_CpuRenderer.SetResumable(true);
+    m_CpuRenderer.GetTileCache().SetBudget((size_t) m_TileCacheMegabytes << 20);
+
 #ifdef _WIN32
     HWND window = GetConsoleWindow();
 #ifdef _DEBUG
@@ -76,6 +120,16 @@ Application::Application()
 
 Application::~Application()
 {
+    if (m_SceneFramebuffers[0]) glDeleteFramebuffers(2, m_SceneFramebuffers);
+    if (m_SceneTextures[0]) glDeleteTextures(2, m_SceneTextures);
+    if (m_SceneOrbitTextures[0]) glDeleteTextures(2, m_SceneOrbitTextures);
+    if (m_SceneOrbitLoTextures[0]) glDeleteTextures(2, m_SceneOrbitLoTextures);
+    if (m_SceneGlitchTextures[0]) glDeleteTextures(2, m_SceneGlitchTextures);
+    if (m_ScenePeriodTextures[0]) glDeleteTextures(2, m_ScenePeriodTextures);
+    if (m_ReferenceOrbitTexture) glDeleteTextures(1, &m_ReferenceOrbitTexture);
+    if (m_IterationTexture) glDeleteTextures(1, &m_IterationTexture);
+    if (m_PeriodTexture) glDeleteTextures(1, &m_PeriodTexture);
+    if (m_GuessedTexture) glDeleteTextures(1, &m_GuessedTexture);
     if (m_QuadEBO) glDeleteBuffers(1, &m_QuadEBO);
     if (m_QuadVBO) glDeleteBuffers(1, &m_QuadVBO);
     if (m_QuadVAO) glDeleteVertexArrays(1, &m_QuadVAO);
@@ -95,48 +149,198 @@ void Application::Run()
         // 1. Pump events first so the per-frame state is fresh before anything
         //    reads from it. Capture flags are sampled here too, so the GLFW
         //    callbacks dispatched inside glfwPollEvents see the up-to-date
-        //    values rather than the previous frame's.
-        glfwPollEvents();
+        //    values rather than the previous frame's. Once there is nothing
+        //    left to draw, wait for the next event instead of spinning.
+        const bool waited = m_IdleFrames >= IdleFramesBeforeWait;
+        if (waited)
+        {
+            glfwWaitEvents();
+            m_IdleFrames = 0;
+        }
+        else
+        {
+            glfwPollEvents();
+        }
         m_BlockMouseEvents = ImGui::GetIO().WantCaptureMouse;
 
         ImGuiUtil::BeginNewFrame();
-        ProcessKeyboardInput(ImGui::GetIO().DeltaTime);
+        // The time spent waiting is not time a held key was panning for.
+        ProcessKeyboardInput(waited ? 0.0 : ImGui::GetIO().DeltaTime);
 
         // 2. Render the fractal.
         glClearColor(0.7f, 0.7f, 0.7f, 0.7f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        auto &shader = currentItem == 0 ? m_MandelbrotShader : m_JuliaSetShader;
+        // While c is being dragged the Julia set is only outlined, which
+        // keeps up with the slider; the full render follows on release.
+        // Both renderers skip the fractal pass for a view they already
+        // finished, so an unchanged frame only reruns the colorize pass.
+        AlignCamera();
+        m_FrameView = GetFractalView();
+        m_FrameColor = m_Color;
+        m_FrameInteriorByPeriod = m_InteriorByPeriod;
+        m_FrameBackend = m_RenderBackend;
+        m_FramePreview = currentItem == (int) FractalType::JuliaSet && m_JuliaSliderActive;
+        if (m_FramePreview)
+            RenderJuliaPreview();
+        else if (m_RenderBackend == (int) RenderBackend::Cpu)
+            RenderFractalCpu();
+        else
+            RenderFractalGpu();
 
-        const dvec2 viewport = GetFramebufferSize();
-
-        shader.Bind();
-        shader.SetInt("u_MaxIterations", m_MaxIterations);
-        shader.SetFloat2("u_ScreenSize", { (float) viewport.x, (float) viewport.y });
-        shader.SetFloat ("u_Zoom",       (float) m_ZoomLevel);
-        shader.SetFloat2("u_Offset",     { (float) m_CameraPosition.x, (float) m_CameraPosition.y });
-        shader.SetFloat4("u_Color",      m_Color);
-        if (currentItem == 1)   // Julia Set
-        {
-            shader.SetFloat("u_RealComponent", m_RealComponent);
-            shader.SetFloat("u_ImaginaryComponent", m_ImaginaryComponent);
-        }
-        RenderFullscreenQuad();
+        if (m_AutoIterations)
+            UpdateAutoIterations();
 
         // 3. ImGui UI on top.
         ImGui::Begin("Settings");
         ImGui::Text("FPS: %.2f", ImGui::GetIO().Framerate);
 
         ImGui::SetNextItemWidth(-1.0f);
-        ImGui::Combo("##Current Fractal", &currentItem, items);
+        if (ImGui::Combo("##Current Fractal", &currentItem, items))
+            SetZoomStep(m_ZoomStep);
 
-        ImGui::Text("Max Iterations");
+        char zoomText[32];
+        m_ZoomLevel.Format(zoomText, sizeof(zoomText));
+        ImGui::Text("Zoom: %s", zoomText);
+        if (IsDeepZoom(GetFractalView()))
+        {
+            ImGui::Text("Perturbation: %d ref. iterations", m_Perturbation.GetReferenceLength() - 1);
+            ImGui::Text("Orbit: %.2f ms (%u bits)",
+                m_Perturbation.GetOrbitMilliseconds(), BigFixed::LimbsForZoom(m_ZoomLevel) * 32);
+
+            bool series = m_Perturbation.IsSeriesEnabled();
+            if (ImGui::Checkbox("Series approximation", &series))
+                m_Perturbation.SetSeriesEnabled(series);
+            if (series)
+                ImGui::Text("Series: skipped %d iterations", m_Perturbation.GetSeriesSkip());
+
+            // The CPU backend lists its own with the rest of its stats.
+            if (m_RenderBackend == (int) RenderBackend::Gpu)
+            {
+                const CpuRenderStats &stats = m_SceneGlitchStats;
+                ImGui::Text("Glitches: %llu px, %llu left", (unsigned long long) stats.GlitchedPixels,
+                    (unsigned long long) stats.UnfixedPixels);
+                ImGui::Text("%u passes, %u references, %.1f ms", stats.GlitchPasses, stats.References,
+                    stats.GlitchMilliseconds);
+            }
+
+            if (m_RenderBackend == (int) RenderBackend::Cpu)
+            {
+                bool bla = m_Perturbation.IsBlaEnabled();
+                if (ImGui::Checkbox("Bilinear approximation", &bla))
+                    m_Perturbation.SetBlaEnabled(bla);
+                if (bla)
+                {
+                    const BlaTable &table = m_Perturbation.GetBlaTable();
+                    ImGui::Text("BLA: %d levels, %zu steps, %.2f ms",
+                        table.GetLevelCount(), table.GetStepCount(), table.GetBuildMilliseconds());
+                }
+            }
+        }
+
+        ImGui::Text("Renderer");
         ImGui::SetNextItemWidth(-1.0f);
-        ImGui::SliderInt("##maxIterations", &m_MaxIterations, 0, 500);
+        if (ImGui::Combo("##Renderer", &m_RenderBackend, m_RenderBackendItems))
+            SetZoomStep(m_ZoomStep);
+        if (m_RenderBackend == (int) RenderBackend::Cpu)
+        {
+            ImGui::SetNextItemWidth(-1.0f);
+            ImGui::Combo("##CpuPrecision", &m_CpuPrecision, m_CpuPrecisionItems);
+            if ((int) GetCpuPrecision() != m_CpuPrecision && !IsDeepZoom(GetFractalView()))
+                ImGui::Text("Zoom requires %s", GetCpuPrecision() == Precision::Double ? "Double" : "Double-double");
+
+            ImGui::SetNextItemWidth(-1.0f);
+            if (ImGui::BeginCombo("##CpuKernel", m_CpuRenderer.GetKernel().Name))
+            {
+                for (const EscapeKernel *kernel : EscapeKernels::Available())
+                {
+                    if (ImGui::Selectable(kernel->Name, kernel == &m_CpuRenderer.GetKernel()))
+                        m_CpuRenderer.SetKernel(*kernel);
+                }
+                ImGui::EndCombo();
+            }
+
+            int strategy = (int) m_CpuRenderer.GetStrategy();
+            ImGui::SetNextItemWidth(-1.0f);
+            if (ImGui::Combo("##CpuStrategy", &strategy, m_CpuStrategyItems))
+                m_CpuRenderer.SetStrategy((CpuStrategy) strategy);
+            if (m_CpuRenderer.GetStrategy() != CpuStrategy::Full)
+                ImGui::Checkbox("Show guessed pixels", &m_ShowGuessedPixels);
+
+            const CpuRenderStats &stats = m_CpuRenderer.GetStats();
+            ImGui::Text("%s, %u threads", stats.Kernel, m_CpuRenderer.GetThreadCount());
+            ImGui::Text("%.1f ms, %.1f Mpix/s", stats.Milliseconds, stats.MegapixelsPerSecond);
+            if (stats.ReusedPixels > stats.CachedPixels)
+                ImGui::Text("Reused: %llu px", (unsigned long long) (stats.ReusedPixels - stats.CachedPixels));
+
+            ImGui::SetNextItemWidth(-1.0f);
+            if (ImGui::SliderInt("##TileCache", &m_TileCacheMegabytes, 0, 4096, "Tile cache: %d MB"))
+                m_CpuRenderer.GetTileCache().SetBudget((size_t) m_TileCacheMegabytes << 20);
+            const TileCache &cache = m_CpuRenderer.GetTileCache();
+            if (m_TileCacheMegabytes > 0)
+            {
+                ImGui::Text("Cache: %zu tiles, %.1f MB, %.1f%% hits", cache.GetTileCount(),
+                    (double) cache.GetBytes() / (1024.0 * 1024.0), 100.0 * cache.GetHitRate());
+                ImGui::Text("From cache: %llu px", (unsigned long long) stats.CachedPixels);
+            }
+            if (ImGui::Checkbox("Disk tile store", &m_UseTileStore))
+            {
+                if (m_UseTileStore && m_TileStore.Open(TileStoreDirectory))
+                    m_CpuRenderer.GetTileCache().SetStore(&m_TileStore);
+                else
+                {
+                    m_UseTileStore = false;
+                    m_CpuRenderer.GetTileCache().SetStore(nullptr);
+                    m_TileStore.Close();
+                }
+            }
+            if (m_UseTileStore)
+            {
+                ImGui::SetNextItemWidth(-1.0f);
+                if (ImGui::SliderInt("##TileStore", &m_TileStoreMegabytes, 256, 65536, "Store cap: %d MB"))
+                    m_TileStore.SetCapacity((size_t) m_TileStoreMegabytes << 20);
+                ImGui::Text("Store: %zu tiles, %.1f MB, %.1f%% hits", m_TileStore.GetTileCount(),
+                    (double) m_TileStore.GetBytes() / (1024.0 * 1024.0), 100.0 * m_TileStore.GetHitRate());
+                if (ImGui::Button("Compact store"))
+                    m_TileStore.Compact((size_t) m_TileStoreMegabytes << 20);
+            }
+            if (GetFractalView().Type == FractalType::Mandelbrot)
+                ImGui::Text("Interior skipped: %llu px", (unsigned long long) stats.InteriorPixels);
+            if (!IsDeepZoom(GetFractalView()))
+                ImGui::Text("Cycles detected: %llu px", (unsigned long long) stats.PeriodicPixels);
+            if (m_CpuRenderer.GetStrategy() != CpuStrategy::Full)
+                ImGui::Text("Guessed: %llu px (%.1f%%)", (unsigned long long) stats.GuessedPixels,
+                    stats.Pixels ? 100.0 * (double) stats.GuessedPixels / (double) stats.Pixels : 0.0);
+            if (!m_CpuRenderer.IsComplete())
+                ImGui::TextUnformatted("Refining...");
+            if (IsDeepZoom(GetFractalView()))
+            {
+                ImGui::Text("Glitches: %llu px, %llu left", (unsigned long long) stats.GlitchedPixels,
+                    (unsigned long long) stats.UnfixedPixels);
+                ImGui::Text("%u passes, %u references, %.1f ms", stats.GlitchPasses, stats.References,
+                    stats.GlitchMilliseconds);
+            }
+        }
+
+        ImGui::Text("Max Iterations");
+        ImGui::SameLine();
+        ImGui::Checkbox("Auto##maxIterations", &m_AutoIterations);
+        if (m_AutoIterations)
+        {
+            ImGui::Text("%d (floor %d)", m_MaxIterations, IterationTuner::GetZoomFloor(m_ZoomLevel));
+            ImGui::Text("Capped: %.1f%% of px, %.0f%% of work",
+                100.0 * m_IterationTuner.GetCappedShare(), 100.0 * m_IterationTuner.GetCappedWorkShare());
+        }
+        else
+        {
+            ImGui::SetNextItemWidth(-1.0f);
+            ImGui::SliderInt("##maxIterations", &m_MaxIterations, 0, 500);
+        }
 
         ImGui::Text("Color");
         ImGui::SetNextItemWidth(-1.0f);
         ImGui::ColorEdit3("##color", &m_Color.x);
+        ImGui::Checkbox("Color interior by period", &m_InteriorByPeriod);
 
         if (currentItem == 1)
         {
@@ -144,10 +348,17 @@ void Application::Run()
             ImGui::Text("RealComponent");
             ImGui::SetNextItemWidth(-1.0f);
             ImGui::SliderFloat("##RealComponent", &m_RealComponent, 0.0f, 1.0f);
+            bool sliderActive = ImGui::IsItemActive();
 
             ImGui::Text("ImaginaryComponent");
             ImGui::SetNextItemWidth(-1.0f);
             ImGui::SliderFloat("##ImaginaryComponent", &m_ImaginaryComponent, 0.0f, 1.0f);
+            sliderActive |= ImGui::IsItemActive();
+            m_JuliaSliderActive = sliderActive;
+        }
+        else
+        {
+            m_JuliaSliderActive = false;
         }
 
         ImGui::Spacing();
@@ -161,6 +372,7 @@ void Application::Run()
         ImGui::End();
 
         ImGuiUtil::EndFrame();
+        m_IdleFrames = IsIdle() ? m_IdleFrames + 1 : 0;
 
         // 4. Present. Last call in the loop, conventional ordering: rendering
         //    is no longer one frame behind events and the very first swap is
@@ -171,13 +383,35 @@ void Application::Run()
 
 void Application::OnMouseScrolled(double xOffset, double yOffset)
 {
-    if(!m_BlockMouseEvents)
-        m_ZoomLevel += yOffset * ZoomSpeed * m_ZoomLevel / 10.0f;
-  
-    if (m_ZoomLevel < MinZoomLevel)
-        m_ZoomLevel = MinZoomLevel;
-    if (m_ZoomLevel > MaxZoomLevel)
-        m_ZoomLevel = MaxZoomLevel;
+    if (m_BlockMouseEvents)
+        return;
+
+    // Whole steps only; smooth scrolling carries the fraction over.
+    m_ZoomRemainder += yOffset * ZoomSpeed;
+    const double steps = std::trunc(m_ZoomRemainder);
+    m_ZoomRemainder -= steps;
+    if (steps != 0.0)
+        SetZoomStep(m_ZoomStep + (int) steps);
+}
+
+void Application::SetZoomStep(int step)
+{
+    const int minStep = (int) std::ceil(ZoomStepsPerOctave * std::log2(MinZoomLevel / InitialZoomLevel));
+    const int maxStep = (int) std::floor(ZoomStepsPerOctave * (GetMaxZoomLevel().Log2() - std::log2(InitialZoomLevel)));
+    m_ZoomStep = std::clamp(step, minStep, maxStep);
+    m_ZoomLevel = GetZoomForStep(m_ZoomStep);
+    if (m_ZoomLevel > GetMaxZoomLevel())
+        m_ZoomLevel = GetMaxZoomLevel();
+
+    m_CameraPosition.SetFractionLimbs(BigFixed::LimbsForZoom(m_ZoomLevel));
+}
+
+FloatExp Application::GetZoomForStep(int step)
+{
+    // Computed from the step alone, so the same step is always the same zoom.
+    const int octave = step >= 0 ? step / ZoomStepsPerOctave : -((-step + ZoomStepsPerOctave - 1) / ZoomStepsPerOctave);
+    const int rest = step - octave * ZoomStepsPerOctave;
+    return FloatExp::FromParts(InitialZoomLevel * std::exp2((double) rest / ZoomStepsPerOctave), octave);
 }
 void Application::OnMouseMoved(double xPosition, double yPosition)
 {
@@ -198,8 +432,7 @@ void Application::OnMouseMoved(double xPosition, double yPosition)
     if (glfwGetMouseButton(m_Window, GLFW_MOUSE_BUTTON_1) == GLFW_PRESS &&
         !m_BlockMouseEvents)
     {
-        m_CameraPosition.x -= offset.x / m_ZoomLevel;
-        m_CameraPosition.y -= offset.y / m_ZoomLevel;
+        MoveCameraPixels(-offset.x, -offset.y);
     }
 }
 void Application::OnResize(u32 width, u32 height)
@@ -217,19 +450,114 @@ void Application::ProcessKeyboardInput(double dt)
     // MovementSpeed is interpreted as "screens per second" of pan, so the
     // perceived speed stays constant at every zoom level.
     const dvec2 viewport = GetFramebufferSize();
-    const double pan = MovementSpeed * dt / m_ZoomLevel;
+    const double pan = MovementSpeed * dt;
 
     // m_CameraPosition is subtracted from the per-pixel world coord in the
     // shader, so to move the *view* in a direction we move m_CameraPosition
     // the opposite way.
     if (glfwGetKey(m_Window, GLFW_KEY_W) == GLFW_PRESS)
-        m_CameraPosition.y -= pan * viewport.y;
+        MoveCameraPixels(0.0, -pan * viewport.y);
     if (glfwGetKey(m_Window, GLFW_KEY_S) == GLFW_PRESS)
-        m_CameraPosition.y += pan * viewport.y;
+        MoveCameraPixels(0.0, pan * viewport.y);
     if (glfwGetKey(m_Window, GLFW_KEY_A) == GLFW_PRESS)
-        m_CameraPosition.x += pan * viewport.x;
+        MoveCameraPixels(pan * viewport.x, 0.0);
     if (glfwGetKey(m_Window, GLFW_KEY_D) == GLFW_PRESS)
-        m_CameraPosition.x -= pan * viewport.x;
+        MoveCameraPixels(-pan * viewport.x, 0.0);
+}
+
+bool Application::IsIdle()
+{
+    // Anything the UI or the callbacks changed since the frame was rendered.
+    const FractalView view = GetFractalView();
+    if (!(view == m_FrameView) || m_RenderBackend != m_FrameBackend ||
+        m_Color.x != m_FrameColor.x || m_Color.y != m_FrameColor.y || m_Color.z != m_FrameColor.z ||
+        m_InteriorByPeriod != m_FrameInteriorByPeriod ||
+        m_FramePreview != (currentItem == (int) FractalType::JuliaSet && m_JuliaSliderActive))
+        return false;
+
+    // Progressive passes and refinement tiles still to go.
+    if (!m_FramePreview && m_RenderBackend == (int) RenderBackend::Cpu && !m_CpuRenderer.IsComplete())
+        return false;
+    if (!m_FramePreview && m_RenderBackend == (int) RenderBackend::Gpu && m_SceneRefineNext < m_SceneRefine.size())
+        return false;
+
+    // Held keys pan every frame without sending events.
+    if (!ImGui::GetIO().WantCaptureKeyboard)
+    {
+        for (int key : { GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D })
+        {
+            if (glfwGetKey(m_Window, key) == GLFW_PRESS)
+                return false;
+        }
+    }
+    return true;
+}
+
+void Application::MoveCameraPixels(double dx, double dy)
+{
+    // Whole pixels only, so both renderers can shift the last frame instead
+    // of redrawing it; the fraction carries over to the next move.
+    m_PanRemainder.x += dx;
+    m_PanRemainder.y += dy;
+    const double wholeX = std::trunc(m_PanRemainder.x);
+    const double wholeY = std::trunc(m_PanRemainder.y);
+    if (wholeX == 0.0 && wholeY == 0.0)
+        return;
+    m_PanRemainder.x -= wholeX;
+    m_PanRemainder.y -= wholeY;
+    ShiftCamera(wholeX, wholeY);
+}
+
+void Application::ShiftCamera(double dx, double dy)
+{
+    MoveCamera(dx / m_ZoomLevel, dy / m_ZoomLevel);
+    m_CpuRenderer.Pan(dx, dy, m_ZoomLevel);
+    if (m_SceneValid)
+    {
+        // In pixels of the scene, which may be at another zoom.
+        const double scale = m_SceneView.Zoom == m_ZoomLevel ? 1.0 : (m_SceneView.Zoom / m_ZoomLevel).ToDouble();
+        m_SceneShiftX += dx * scale;
+        m_SceneShiftY += dy * scale;
+    }
+}
+
+void Application::AlignCamera()
+{
+    // A zoom or a resize leaves the pixels up to one off the grid. Moving
+    // the camera by +k pixels takes k off the grid origin; once on it,
+    // whole-pixel pans keep it there.
+    double gridX, gridY;
+    if (!TileCache::GetGridOrigin(GetFractalView(), gridX, gridY))
+        return;
+    const double dx = gridX - std::round(gridX), dy = gridY - std::round(gridY);
+    if (std::fabs(dx) > TileCache::GridTolerance / 4.0 || std::fabs(dy) > TileCache::GridTolerance / 4.0)
+        ShiftCamera(dx, dy);
+}
+
+void Application::MoveCamera(const FloatExp &dx, const FloatExp &dy)
+{
+    const u32 limbs = BigFixed::LimbsForZoom(m_ZoomLevel);
+    m_CameraPosition.x += BigFixed(dx, limbs);
+    m_CameraPosition.y += BigFixed(dy, limbs);
+}
+
+FloatExp Application::GetMaxZoomLevel() const
+{
+    // Only the Mandelbrot set has a perturbation path; the Julia set stops
+    // where the backend's widest arithmetic does.
+    if (currentItem == (int) FractalType::Mandelbrot)
+        return MaxDeepZoomLevel;
+    return m_RenderBackend == (int) RenderBackend::Cpu ? MaxDoubleDoubleZoomLevel : MaxFloatFloatZoomLevel;
+}
+
+bool Application::IsDeepZoom(const FractalView &view) const
+{
+    return Perturbation::IsRequired(view);
+}
+
+Precision Application::GetCpuPrecision() const
+{
+    return std::max((Precision) m_CpuPrecision, RequiredPrecision(m_ZoomLevel));
 }
 
 dvec2 Application::GetMousePosition()
@@ -239,6 +567,15 @@ dvec2 Application::GetMousePosition()
 
     return dvec2 { xPos, yPos };
 }
+dvec2 Application::GetCursorPixel()
+{
+    const dvec2 mouse = GetMousePosition();
+    const dvec2 window = GetMainViewportSize();
+    const dvec2 framebuffer = GetFramebufferSize();
+    if (window.x <= 0.0 || window.y <= 0.0)
+        return dvec2 { 0.0, 0.0 };
+    return dvec2 { mouse.x * framebuffer.x / window.x, (window.y - mouse.y) * framebuffer.y / window.y };
+}
 dvec2 Application::GetMainViewportSize()
 {
     int width, height;
@@ -258,6 +595,560 @@ dvec2 Application::GetFramebufferSize()
     return dvec2 { (double) width, (double) height };
 }
 
+FractalView Application::GetFractalView()
+{
+    const dvec2 viewport = GetFramebufferSize();
+
+    FractalView view;
+    view.Type = (FractalType) currentItem;
+    view.MaxIterations = m_MaxIterations;
+    view.Width = (u32) viewport.x;
+    view.Height = (u32) viewport.y;
+    view.Zoom = m_ZoomLevel;
+    view.Offset = m_CameraPosition.ToDouble();
+    view.OffsetLo = m_CameraPosition.ToDoubleRemainder();
+    view.JuliaC = dvec2 { m_RealComponent, m_ImaginaryComponent };
+    return view;
+}
+
+void Application::RenderFractalGpu()
+{
+    const FractalView view = GetFractalView();
+    if (view.Width == 0 || view.Height == 0)
+        return;
+    auto &shader = view.Type == FractalType::Mandelbrot ? m_MandelbrotShader : m_JuliaSetShader;
+
+    const bool deepZoom = IsDeepZoom(view);
+    if (deepZoom)
+    {
+        m_Perturbation.Update(view, m_CameraPosition);
+        UploadReferenceOrbit();
+    }
+
+    shader.Bind();
+    shader.SetInt("u_MaxIterations", view.MaxIterations);
+    shader.SetFloat2("u_ScreenSize", { (float) view.Width, (float) view.Height });
+    shader.SetFloat ("u_Zoom",       (float) view.Zoom.ToDouble());
+    shader.SetFloat2("u_Offset",     { (float) view.Offset.x, (float) view.Offset.y });
+
+    // Past fp32's reach both shaders switch to float-float, with u_Offset as
+    // the high half of each pair and u_OffsetLo holding what it rounded away.
+    // Perturbation needs the pair too, for its interior test.
+    const bool doubleFloat = !deepZoom && view.Zoom > MaxZoomLevel;
+    shader.SetInt("u_DoubleFloat", doubleFloat ? 1 : 0);
+    if (doubleFloat || deepZoom)
+    {
+        const double lowX = (view.Offset.x - (double) (float) view.Offset.x) + view.OffsetLo.x;
+        const double lowY = (view.Offset.y - (double) (float) view.Offset.y) + view.OffsetLo.y;
+        shader.SetFloat2("u_OffsetLo", { (float) lowX, (float) lowY });
+    }
+    if (view.Type == FractalType::JuliaSet)
+    {
+        shader.SetFloat("u_RealComponent", (float) view.JuliaC.x);
+        shader.SetFloat("u_ImaginaryComponent", (float) view.JuliaC.y);
+    }
+    if (view.Type == FractalType::Mandelbrot)
+    {
+        shader.SetInt("u_Perturbation", deepZoom ? 1 : 0);
+        if (deepZoom)
+        {
+            // frexp's convention, mantissa in [0.5, 1).
+            const FloatExp scale = FloatExp(1.0) / view.Zoom;
+            const double scaleMantissa = 0.5 * scale.GetMantissa();
+            const int scaleExponent = scale.GetExponent() + 1;
+            const dvec2 referencePixel = m_Perturbation.GetReferencePixel();
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, m_ReferenceOrbitTexture);
+            shader.SetInt("u_ReferenceOrbit", 0);
+            shader.SetInt("u_ReferenceLength", m_Perturbation.GetReferenceLength());
+            shader.SetFloat2("u_ReferencePixel", { (float) referencePixel.x, (float) referencePixel.y });
+            shader.SetFloat("u_PixelScale", (float) scaleMantissa);
+            shader.SetInt("u_PixelScaleExp", scaleExponent);
+
+            // The b_k share one exponent (the largest) so the shader can add
+            // the terms straight into w; terms too small to register in fp32
+            // next to the largest one flush to 0.
+            const auto &series = m_Perturbation.GetSeriesCoefficients();
+            int seriesExponent = INT_MIN;
+            for (const FloatExpVec2 &b : series)
+            {
+                for (const FloatExp &component : { b.x, b.y })
+                {
+                    if (!component.IsZero())
+                        seriesExponent = std::max(seriesExponent, component.GetExponent() + 1);
+                }
+            }
+            const int seriesSkip = seriesExponent == INT_MIN ? 0 : m_Perturbation.GetSeriesSkip();
+
+            vec2 coefficients[Perturbation::SeriesTerms];
+            for (int k = 0; k < Perturbation::SeriesTerms; k++)
+            {
+                coefficients[k].x = seriesSkip ? (float) std::ldexp(series[k].x.GetMantissa(), series[k].x.GetExponent() - seriesExponent) : 0.0f;
+                coefficients[k].y = seriesSkip ? (float) std::ldexp(series[k].y.GetMantissa(), series[k].y.GetExponent() - seriesExponent) : 0.0f;
+            }
+            shader.SetInt("u_SeriesSkip", seriesSkip);
+            shader.SetInt("u_SeriesTerms", Perturbation::SeriesTerms);
+            shader.SetFloat("u_SeriesRadius", (float) m_Perturbation.GetSeriesRadius());
+            shader.SetFloat2Array("u_SeriesCoefficients", coefficients, Perturbation::SeriesTerms);
+            shader.SetInt("u_SeriesExp", seriesSkip ? seriesExponent : 0);
+        }
+    }
+    DrawScene(view, shader, !deepZoom);
+}
+
+void Application::DrawScene(const FractalView &view, Shader &shader, bool resumable)
+{
+    const int width = (int) view.Width, height = (int) view.Height;
+    if (m_SceneFramebuffers[0] == 0)
+    {
+        glGenFramebuffers(2, m_SceneFramebuffers);
+        glGenTextures(2, m_SceneTextures);
+        glGenTextures(2, m_SceneOrbitTextures);
+        glGenTextures(2, m_SceneOrbitLoTextures);
+        glGenTextures(2, m_SceneGlitchTextures);
+        glGenTextures(2, m_ScenePeriodTextures);
+    }
+    if (view.Width != m_SceneWidth || view.Height != m_SceneHeight)
+    {
+        auto createTarget = [&](u32 texture, GLenum format, GLenum components, GLenum type = GL_FLOAT)
+        {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, components, type, nullptr);
+        };
+        for (int i = 0; i < 2; i++)
+        {
+            createTarget(m_SceneTextures[i], GL_R32F, GL_RED);
+            createTarget(m_SceneOrbitTextures[i], GL_RGBA32F, GL_RGBA);
+            createTarget(m_SceneOrbitLoTextures[i], GL_RGBA32F, GL_RGBA);
+            createTarget(m_SceneGlitchTextures[i], GL_R8, GL_RED);
+            createTarget(m_ScenePeriodTextures[i], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_SceneFramebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_SceneTextures[i], 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_SceneOrbitTextures[i], 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, m_SceneOrbitLoTextures[i], 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, m_SceneGlitchTextures[i], 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, m_ScenePeriodTextures[i], 0);
+            // Only full frames write the orbits and only perturbation passes
+            // the glitch flags; blits and clears leave them alone, and the
+            // periods are blitted on their own (nearest, integer).
+            glDrawBuffer(GL_COLOR_ATTACHMENT0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::fprintf(stderr, "[ERROR] Scene framebuffer %d is incomplete\n", i);
+        }
+        m_SceneWidth = view.Width;
+        m_SceneHeight = view.Height;
+        m_SceneValid = false;
+    }
+
+    // The targets hold iterations, which only depend on the view: a frame
+    // of the view they already hold skips the fractal pass, so a colour
+    // change only reruns the colorize pass. After a whole-pixel pan of a
+    // finished frame, what stays on screen is blitted over from the last
+    // frame's target and only the exposed strips run the shader. After a
+    // zoom, or a move the pan can't take, the last frame is stretched into
+    // place as a preview and redrawn tile by tile, nearest the cursor
+    // first, within RefineBudget per frame. A higher iteration cap on a
+    // full frame continues the orbits that ran out, from the last frame's
+    // orbit targets; every other pixel only has its count rescaled. Under
+    // perturbation, the pixels a pass flags as glitched are then fixed on
+    // the CPU.
+    const double shiftX = m_SceneShiftX, shiftY = m_SceneShiftY;
+    m_SceneShiftX = m_SceneShiftY = 0.0;
+    const bool moved = shiftX != 0.0 || shiftY != 0.0;
+    const bool complete = m_SceneRefineNext >= m_SceneRefine.size();
+    const bool unchanged = m_SceneValid && !moved && complete && view == m_SceneView;
+    const bool pan = m_SceneValid && moved && complete && IsTranslationOf(view, m_SceneView) &&
+        shiftX == std::trunc(shiftX) && shiftY == std::trunc(shiftY) &&
+        std::fabs(shiftX) < (double) width && std::fabs(shiftY) < (double) height;
+    const bool refine = m_SceneValid && !moved && !complete && view == m_SceneView;
+    const bool reproject = !pan && !refine && m_SceneValid && (moved || !(view.Zoom == m_SceneView.Zoom)) &&
+        view.Type == m_SceneView.Type && view.MaxIterations == m_SceneView.MaxIterations &&
+        view.JuliaC.x == m_SceneView.JuliaC.x && view.JuliaC.y == m_SceneView.JuliaC.y;
+    FractalView uncapped = view;
+    uncapped.MaxIterations = m_SceneView.MaxIterations;
+    const int previousCap = m_SceneView.MaxIterations;
+    const bool raise = m_SceneValid && m_SceneOrbitsValid && resumable && !moved && complete &&
+        previousCap > 0 && view.MaxIterations > previousCap && uncapped == m_SceneView;
+    const bool perturbed = IsDeepZoom(view);
+    // Around the shader's quads only, which write the periods, the orbits
+    // if asked and the glitch flags under perturbation. The flags start
+    // cleared, so afterwards they hold exactly this frame's glitches. Called
+    // with scissoring off, which would limit the clear too.
+    auto beginPass = [&](bool orbits)
+    {
+        GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_NONE, GL_NONE, GL_NONE, GL_COLOR_ATTACHMENT4 };
+        if (orbits)
+        {
+            buffers[1] = GL_COLOR_ATTACHMENT1;
+            buffers[2] = GL_COLOR_ATTACHMENT2;
+        }
+        if (perturbed)
+            buffers[3] = GL_COLOR_ATTACHMENT3;
+        glDrawBuffers(5, buffers);
+        if (perturbed)
+        {
+            const float cleared[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glClearBufferfv(GL_COLOR, 3, cleared);
+        }
+    };
+    auto endPass = [&]()
+    {
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    };
+    // Follows a blit of the iterations from the source target with the same
+    // rectangles; nearest, as periods are integers. `clear` first zeroes
+    // what the blit does not cover.
+    auto blitPeriods = [&](int x0, int y0, int x1, int y1, int toX0, int toY0, int toX1, int toY1, bool clear)
+    {
+        const GLenum buffers[] = { GL_NONE, GL_NONE, GL_NONE, GL_NONE, GL_COLOR_ATTACHMENT4 };
+        glDrawBuffers(5, buffers);
+        if (clear)
+        {
+            const GLuint cleared[4] = { 0, 0, 0, 0 };
+            glClearBufferuiv(GL_COLOR, 4, cleared);
+        }
+        glReadBuffer(GL_COLOR_ATTACHMENT4);
+        glBlitFramebuffer(x0, y0, x1, y1, toX0, toY0, toX1, toY1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    };
+
+    const int source = m_SceneIndex, target = refine || unchanged ? m_SceneIndex : 1 - m_SceneIndex;
+    glBindFramebuffer(GL_FRAMEBUFFER, m_SceneFramebuffers[target]);
+    if (pan)
+    {
+        const int panX = (int) shiftX, panY = (int) shiftY;
+        const int columns = width - std::abs(panX), rows = height - std::abs(panY);
+        const int fromX = std::max(-panX, 0), fromY = std::max(-panY, 0);
+        const int toX = std::max(panX, 0), toY = std::max(panY, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_SceneFramebuffers[source]);
+        glBlitFramebuffer(fromX, fromY, fromX + columns, fromY + rows, toX, toY, toX + columns, toY + rows,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        blitPeriods(fromX, fromY, fromX + columns, fromY + rows, toX, toY, toX + columns, toY + rows, false);
+
+        Tile strips[2];
+        const u32 stripCount = CpuRenderer::GetPanStrips(view.Width, view.Height, panX, panY, strips);
+        beginPass(false);
+        glEnable(GL_SCISSOR_TEST);
+        for (u32 i = 0; i < stripCount; i++)
+        {
+            glScissor((int) strips[i].X, (int) strips[i].Y, (int) strips[i].Width, (int) strips[i].Height);
+            RenderFullscreenQuad();
+        }
+        glDisable(GL_SCISSOR_TEST);
+        endPass();
+    }
+    else if (reproject || refine)
+    {
+        if (reproject)
+        {
+            // Old pixel edge q lands on  size / 2 + (q + shift - size / 2) / scale.
+            const double scale = (m_SceneView.Zoom / view.Zoom).ToDouble();
+            const double halfWidth = width / 2.0, halfHeight = height / 2.0;
+            auto toX = [&](double q) { return (int) std::lround(halfWidth + (q + shiftX - halfWidth) / scale); };
+            auto toY = [&](double q) { return (int) std::lround(halfHeight + (q + shiftY - halfHeight) / scale); };
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_SceneFramebuffers[source]);
+            glBlitFramebuffer(0, 0, width, height, toX(0.0), toY(0.0), toX(width), toY(height),
+                GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            blitPeriods(0, 0, width, height, toX(0.0), toY(0.0), toX(width), toY(height), true);
+
+            m_SceneRefine.clear();
+            for (int y = 0; y < height; y += (int) SceneTileSize)
+            {
+                for (int x = 0; x < width; x += (int) SceneTileSize)
+                    m_SceneRefine.push_back({ (u32) x, (u32) y, std::min(SceneTileSize, (u32) (width - x)), std::min(SceneTileSize, (u32) (height - y)) });
+            }
+            const dvec2 focus = GetCursorPixel();
+            auto distance = [&](const Tile &tile)
+            {
+                const double dx = tile.X + 0.5 * tile.Width - focus.x, dy = tile.Y + 0.5 * tile.Height - focus.y;
+                return dx * dx + dy * dy;
+            };
+            std::sort(m_SceneRefine.begin(), m_SceneRefine.end(),
+                [&](const Tile &a, const Tile &b) { return distance(a) < distance(b); });
+            m_SceneRefineNext = 0;
+        }
+
+        // glFinish after each tile, so the budget measures the GPU's work.
+        const double start = glfwGetTime();
+        beginPass(false);
+        glEnable(GL_SCISSOR_TEST);
+        while (m_SceneRefineNext < m_SceneRefine.size())
+        {
+            const Tile &tile = m_SceneRefine[m_SceneRefineNext++];
+            glScissor((int) tile.X, (int) tile.Y, (int) tile.Width, (int) tile.Height);
+            RenderFullscreenQuad();
+            glFinish();
+            if ((glfwGetTime() - start) * 1000.0 >= RefineBudget)
+                break;
+        }
+        glDisable(GL_SCISSOR_TEST);
+        endPass();
+    }
+    else if (raise)
+    {
+        // Where the shader's cycle detection last saved z: the highest
+        // power of two up to the old cap.
+        int savedAt = 1;
+        while (savedAt <= previousCap / 2)
+            savedAt *= 2;
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_SceneTextures[source]);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, m_SceneOrbitTextures[source]);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, m_SceneOrbitLoTextures[source]);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, m_ScenePeriodTextures[source]);
+        shader.SetInt("u_PreviousIterations", 1);
+        shader.SetInt("u_PreviousOrbit", 2);
+        shader.SetInt("u_PreviousOrbitLo", 3);
+        shader.SetInt("u_PreviousPeriods", 4);
+        shader.SetInt("u_ResumeFrom", previousCap);
+        shader.SetInt("u_ResumeSavedAt", savedAt);
+
+        beginPass(true);
+        RenderFullscreenQuad();
+        endPass();
+        shader.SetInt("u_ResumeFrom", 0);
+
+        // Unbound again, so no later pass samples a texture it renders to.
+        for (GLenum unit : { GL_TEXTURE1, GL_TEXTURE2, GL_TEXTURE3, GL_TEXTURE4 })
+        {
+            glActiveTexture(unit);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+    else if (!unchanged)
+    {
+        beginPass(resumable);
+        RenderFullscreenQuad();
+        endPass();
+        m_SceneRefine.clear();
+        m_SceneRefineNext = 0;
+    }
+
+    // Tiles of one refinement add up; any other pass starts the count over.
+    if (perturbed && !unchanged)
+        FixSceneGlitches(view, target, refine);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ColorizeIterations(m_SceneTextures[target], m_ScenePeriodTextures[target], false);
+
+    m_SceneIndex = target;
+    m_SceneView = view;
+    m_SceneValid = true;
+    if (!unchanged)
+        m_SceneOrbitsValid = raise || (resumable && !pan && !reproject && !refine);
+}
+
+void Application::FixSceneGlitches(const FractalView &view, int target, bool accumulate)
+{
+    if (!accumulate)
+        m_SceneGlitchStats = CpuRenderStats();
+
+    const size_t pixels = (size_t) view.Width * view.Height;
+    m_SceneGlitched.resize(pixels);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_SceneFramebuffers[target]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_COLOR_ATTACHMENT3);
+    glReadPixels(0, 0, (int) view.Width, (int) view.Height, GL_RED, GL_UNSIGNED_BYTE, m_SceneGlitched.data());
+
+    // 1.0 reads back as 255; the CPU side flags with 1. Only the rows
+    // between the first and last flagged pixel are read and written back.
+    size_t first = pixels, last = 0;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        m_SceneGlitched[i] = m_SceneGlitched[i] ? 1 : 0;
+        if (m_SceneGlitched[i])
+        {
+            first = std::min(first, i);
+            last = i;
+        }
+    }
+
+    if (first < pixels)
+    {
+        const int firstRow = (int) (first / view.Width), rows = (int) (last / view.Width) + 1 - firstRow;
+        m_SceneGlitchIterations.resize(pixels);
+        const size_t offset = (size_t) firstRow * view.Width;
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, firstRow, (int) view.Width, rows, GL_RED, GL_FLOAT, &m_SceneGlitchIterations[offset]);
+
+        CpuRenderStats stats;
+        m_CpuRenderer.FixGlitches(view, m_Perturbation, m_SceneGlitchIterations.data(), m_SceneGlitched.data(), stats);
+        m_SceneGlitchStats.GlitchedPixels += stats.GlitchedPixels;
+        m_SceneGlitchStats.GlitchPasses = std::max(m_SceneGlitchStats.GlitchPasses, stats.GlitchPasses);
+        m_SceneGlitchStats.References = (u32) m_Perturbation.GetReferenceCount();
+        m_SceneGlitchStats.UnfixedPixels += stats.UnfixedPixels;
+        m_SceneGlitchStats.GlitchMilliseconds += stats.GlitchMilliseconds;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_SceneTextures[target]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, (int) view.Width, rows, GL_RED, GL_FLOAT, &m_SceneGlitchIterations[offset]);
+    }
+
+    // Blits read the iterations.
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+void Application::UploadReferenceOrbit()
+{
+    if (m_ReferenceOrbitTexture != 0 && m_ReferenceOrbitVersion == m_Perturbation.GetVersion())
+        return;
+
+    if (m_ReferenceOrbitTexture == 0)
+    {
+        glGenTextures(1, &m_ReferenceOrbitTexture);
+        glBindTexture(GL_TEXTURE_2D, m_ReferenceOrbitTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // 1024 texels per row keeps the texture within GL 3.3's guaranteed
+    // minimum GL_MAX_TEXTURE_SIZE for up to a million reference points.
+    constexpr int RowLength = 1024;
+    const std::vector<dvec2> &orbit = m_Perturbation.GetReferenceOrbit();
+    const int rows = ((int) orbit.size() + RowLength - 1) / RowLength;
+
+    std::vector<float> texels((size_t) rows * RowLength * 2, 0.0f);
+    for (size_t i = 0; i < orbit.size(); i++)
+    {
+        texels[i * 2 + 0] = (float) orbit[i].x;
+        texels[i * 2 + 1] = (float) orbit[i].y;
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_ReferenceOrbitTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, RowLength, rows, 0, GL_RG, GL_FLOAT, texels.data());
+
+    m_ReferenceOrbitVersion = m_Perturbation.GetVersion();
+}
+
+void Application::RenderFractalCpu()
+{
+    const FractalView view = GetFractalView();
+    if (view.Width == 0 || view.Height == 0)
+        return;
+
+    const dvec2 focus = GetCursorPixel();
+    m_CpuRenderer.SetFocus(focus.x, focus.y);
+    if (IsDeepZoom(view))
+    {
+        m_Perturbation.Update(view, m_CameraPosition);
+        m_CpuRenderer.Render(view, Precision::Double, &m_Perturbation);
+    }
+    else
+    {
+        m_CpuRenderer.Render(view, GetCpuPrecision());
+    }
+
+    // A frame the renderer had nothing left to do for keeps the textures
+    // as they are; only the colorize pass runs again.
+    const u64 version = m_CpuRenderer.GetVersion();
+    if (version != m_IterationTextureVersion)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        UploadRedTexture(m_IterationTexture, m_IterationTextureWidth, m_IterationTextureHeight,
+            view.Width, view.Height, GL_R32F, GL_FLOAT, m_CpuRenderer.GetIterations().data());
+        UploadRedTexture(m_PeriodTexture, m_PeriodTextureWidth, m_PeriodTextureHeight,
+            view.Width, view.Height, GL_R32UI, GL_UNSIGNED_INT, m_CpuRenderer.GetPeriods().data(), GL_RED_INTEGER);
+        m_IterationTextureVersion = version;
+    }
+
+    const bool showGuessed = m_ShowGuessedPixels && !m_CpuRenderer.GetGuessed().empty();
+    if (showGuessed && version != m_GuessedTextureVersion)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        UploadRedTexture(m_GuessedTexture, m_GuessedTextureWidth, m_GuessedTextureHeight,
+            view.Width, view.Height, GL_R8, GL_UNSIGNED_BYTE, m_CpuRenderer.GetGuessed().data());
+        glActiveTexture(GL_TEXTURE0);
+        m_GuessedTextureVersion = version;
+    }
+
+    ColorizeIterations(m_IterationTexture, m_PeriodTexture, showGuessed);
+}
+
+void Application::UpdateAutoIterations()
+{
+    // Once per view: a new cap is a new view, so the cap keeps moving one
+    // step per frame until the tuner leaves it where it is.
+    const FractalView view = GetFractalView();
+    if (view.Width == 0 || view.Height == 0 || view == m_TunedView)
+        return;
+    if (view.Type == FractalType::JuliaSet && m_JuliaSliderActive)
+        return;
+
+    IterationSample sample;
+    if (m_RenderBackend == (int) RenderBackend::Cpu)
+    {
+        // A progressive render is judged once it is complete.
+        if (!m_CpuRenderer.IsComplete())
+            return;
+        sample = IterationTuner::SampleBuffer(m_CpuRenderer.GetIterations(), m_CpuRenderer.GetPeriods(),
+            m_CpuRenderer.GetWidth(), m_CpuRenderer.GetHeight(), 4);
+    }
+    else
+    {
+        sample = IterationTuner::Probe(view, IsDeepZoom(view) ? &m_Perturbation : nullptr);
+    }
+
+    m_TunedView = view;
+    m_MaxIterations = m_IterationTuner.Choose(view.Zoom, view.MaxIterations, sample);
+}
+
+void Application::RenderJuliaPreview()
+{
+    const FractalView view = GetFractalView();
+    if (view.Width == 0 || view.Height == 0)
+        return;
+
+    m_JuliaPreview.Render(view);
+
+    glActiveTexture(GL_TEXTURE0);
+    UploadRedTexture(m_IterationTexture, m_IterationTextureWidth, m_IterationTextureHeight,
+        view.Width, view.Height, GL_R32F, GL_FLOAT, m_JuliaPreview.GetIterations().data());
+    m_IterationTextureVersion = 0;
+
+    ColorizeIterations(m_IterationTexture, 0, false);
+}
+
+void Application::ColorizeIterations(u32 iterations, u32 periods, bool showGuessed)
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, iterations);
+    if (showGuessed)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_GuessedTexture);
+    }
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, periods);
+    glActiveTexture(GL_TEXTURE0);
+
+    m_ColorizeShader.Bind();
+    m_ColorizeShader.SetInt("u_Iterations", 0);
+    m_ColorizeShader.SetInt("u_Guessed", 1);
+    m_ColorizeShader.SetInt("u_ShowGuessed", showGuessed ? 1 : 0);
+    m_ColorizeShader.SetInt("u_Periods", 2);
+    m_ColorizeShader.SetInt("u_InteriorByPeriod", m_InteriorByPeriod && periods != 0 ? 1 : 0);
+    m_ColorizeShader.SetFloat4("u_Color", m_Color);
+    RenderFullscreenQuad();
+}
+
 void Application::RenderFullscreenQuad()
 {
     if (m_QuadVAO == 0)
@@ -1,24 +1,46 @@
 #pragma once
 
+#include "BigFixed.h"
 #include "Core.h"
+#include "CpuRenderer.h"
+#include "Fractal.h"
 #include "ImGuiUtil.h"
+#include "IterationTuner.h"
+#include "JuliaPreview.h"
+#include "Perturbation.h"
 #include "Shader.h"
+#include "TileStore.h"
 
 
-// fp32 precision floor: pixel spacing 1/Z must stay above the smallest
-// representable delta at |c| ~ 2, i.e. FLT_EPSILON * 2 ~= 2.4e-7. That gives
-// Z <= ~4.2e6 as the strict ceiling; we sit slightly past it (mirroring the
-// original `dvec2` value's 1.5x stretch over the fp64 floor) and accept some
-// visible pixelation at maximum zoom. Switch to perturbation theory for
-// deeper zoom — see README.
-static const double MaxZoomLevel = 5.0e6;
 static const double MinZoomLevel = 100;
+static const double InitialZoomLevel = 400;
+// The zoom moves in steps of 2^(1 / ZoomStepsPerOctave), ZoomSpeed of them
+// per scroll wheel notch, so zooming back out lands on exactly the zooms
+// zoomed in through and the tile cache finds their tiles again.
+static const int ZoomStepsPerOctave = 8;
 
 static const double ZoomSpeed = 1.0f;
 static const double MovementSpeed = 0.5f;
+// Milliseconds per frame either renderer spends redrawing a zoomed or moved
+// frame over its resampled preview.
+static const double RefineBudget = 12.0;
+// Frames in a row with nothing to draw before Run() blocks on the next
+// event, so ImGui still settles after the last input.
+static const int IdleFramesBeforeWait = 3;
+static const int DefaultTileCacheMegabytes = 256;
+// Relative to the working directory, like Shaders/; point `--headless
+// --tile-store` at the same directory to share tiles with it.
+static const char *const TileStoreDirectory = "TileStore";
 
 struct GLFWwindow;
 
+// Order matches the "Renderer" combo box in the Settings window.
+enum class RenderBackend : int
+{
+	Gpu = 0,
+	Cpu = 1
+};
+
 class Application
 {
 public:
@@ -36,11 +58,61 @@ private:
 	void OnResize(u32 width, u32 height);
 
 	void ProcessKeyboardInput(double dt);
+	// True once the last frame showed the current view and colour
+	// completely and no held key is moving the camera: nothing would
+	// change by drawing another one.
+	bool IsIdle();
+
+	// Moves m_CameraPosition by a world-space delta without rounding it
+	// through a double first.
+	void MoveCamera(const FloatExp &dx, const FloatExp &dy);
+	// Moves it by framebuffer pixels, in whole steps, and tells both
+	// renderers how far the last frame moved.
+	void MoveCameraPixels(double dx, double dy);
+	// Moves it by any number of pixels and tells both renderers.
+	void ShiftCamera(double dx, double dy);
+	// Moves the camera under a pixel, if need be, so the view's pixels lie
+	// on the tile cache's grid.
+	void AlignCamera();
+	// Clamps `step` to the fractal's zoom range and sets the zoom to it.
+	void SetZoomStep(int step);
+	static FloatExp GetZoomForStep(int step);
+	FloatExp GetMaxZoomLevel() const;
+	bool IsDeepZoom(const FractalView &view) const;
+	// The CPU precision combo's choice, raised to what the zoom requires.
+	Precision GetCpuPrecision() const;
 
 	dvec2 GetMousePosition();
+	// Framebuffer pixel under the cursor, bottom row 0 like gl_FragCoord.
+	dvec2 GetCursorPixel();
 	dvec2 GetMainViewportSize();   // logical points (for ImGui)
 	dvec2 GetFramebufferSize();    // physical pixels (for GL / gl_FragCoord)
 
+	FractalView GetFractalView();
+
+	void RenderFractalGpu();
+	// Runs the bound fractal shader into the next scene target, over only
+	// the strips a pan exposed when it can (not at all when the view is the
+	// one it already holds), and presents the result.
+	// `resumable`: the shader can continue its orbits when only the
+	// iteration cap went up (not under perturbation).
+	void DrawScene(const FractalView &view, Shader &shader, bool resumable);
+	// Reads back the glitch flags of what the last pass drew into scene
+	// target `target` and, if any are set, lets the CPU renderer's glitch
+	// correction re-render those pixels into it.
+	void FixSceneGlitches(const FractalView &view, int target, bool accumulate);
+	void RenderFractalCpu();
+	// Inverse iteration outline of the Julia set, drawn through the
+	// colorize pass like a CPU render.
+	void RenderJuliaPreview();
+	void UploadReferenceOrbit();
+	// Auto mode: sets m_MaxIterations from the frame just rendered.
+	void UpdateAutoIterations();
+	// The colorize pass: maps the R32F iterations in `iterations` to
+	// m_Color into the bound framebuffer, tinting guessed pixels if asked.
+	// `periods` (R32UI, 0 for none) colours the interior while
+	// m_InteriorByPeriod is set.
+	void ColorizeIterations(u32 iterations, u32 periods, bool showGuessed);
 	void RenderFullscreenQuad();
 
 	void TakeScreenShot();
@@ -53,33 +125,134 @@ private:
 	GLFWwindow *m_Window;
 	Shader m_MandelbrotShader;
 	Shader m_JuliaSetShader;
+	Shader m_ColorizeShader;
+
+	// Behind the CPU renderer's tile cache while m_UseTileStore is set.
+	TileStore m_TileStore;
+	bool m_UseTileStore = false;
+	int m_TileStoreMegabytes = (int) (TileStore::DefaultCapacity >> 20);
+	CpuRenderer m_CpuRenderer;
+	Perturbation m_Perturbation;
+	JuliaPreview m_JuliaPreview;
 
 	dvec2 m_LastMousePosition = { 0.0, 0.0 };
 	bool m_HasLastMousePosition = false;
 	bool m_BlockMouseEvents = false;
 
 	int m_MaxIterations = 100;
+	bool m_AutoIterations = false;
+	IterationTuner m_IterationTuner;
+	// View the tuner last judged, cap included.
+	FractalView m_TunedView;
 	// Initial zoom is in framebuffer pixels per world unit. 400 produces a
 	// "fits the window" view at the default 1280x720 logical size on both
 	// 1x and 2x DPI displays (since u_ScreenSize is now framebuffer-pixel
 	// based, raising it from 200 keeps Retina users from getting a
 	// half-zoomed default).
-	double m_ZoomLevel = 400.0;
-	dvec2 m_CameraPosition = { 0.0, 0.0 };
+	//
+	// The zoom only needs exponent range (FloatExp, as deep zooms pass a
+	// double's 1e308); it is the camera position that needs more than 53
+	// bits, so only that one is arbitrary precision (resized to the zoom by
+	// MoveCamera and OnMouseScrolled).
+	FloatExp m_ZoomLevel = InitialZoomLevel;
+	BigVec2 m_CameraPosition;
+	// m_ZoomLevel == GetZoomForStep(m_ZoomStep), except when clamped to the
+	// maximum; the remainder is scrolling not yet a whole step.
+	int m_ZoomStep = 0;
+	double m_ZoomRemainder = 0.0;
+	// Pan not yet applied to the camera, under a pixel.
+	dvec2 m_PanRemainder = { 0.0, 0.0 };
 	// Alpha is unused by the shader but kept = 1 so the uniform value is
 	// always sane if any future shader does sample u_Color.w.
 	vec4 m_Color = { 0.5f, 1.0f, 0.7f, 1.0f };
+	// Interior pixels with a known period get a hue per period.
+	bool m_InteriorByPeriod = false;
 	float m_RealComponent = 0.0f;
 	float m_ImaginaryComponent = 0.0f;
+	// Set by the UI while either Julia c slider is held; read by the next
+	// frame's render.
+	bool m_JuliaSliderActive = false;
+
+	// What the last frame rendered, for IsIdle(), and how many frames in a
+	// row it found nothing to do.
+	FractalView m_FrameView;
+	vec4 m_FrameColor = { 0.0f, 0.0f, 0.0f, 0.0f };
+	bool m_FrameInteriorByPeriod = false;
+	int m_FrameBackend = -1;
+	bool m_FramePreview = false;
+	int m_IdleFrames = 0;
 
 	int currentItem = 0;
 	const char *items = "Mandelbrot set\0Julia set";
 
+	int m_RenderBackend = (int) RenderBackend::Gpu;
+	const char *m_RenderBackendItems = "GPU (GLSL)\0CPU";
+	int m_CpuPrecision = (int) Precision::Float;
+	const char *m_CpuPrecisionItems = "Float (matches GPU)\0Double\0Double-double\0";
+	const char *m_CpuStrategyItems = "Iterate every pixel\0Subdivision (Mariani-Silver)\0Boundary tracing\0Solid guessing (progressive)\0";
+
 	// Fullscreen quad GL state (created lazily on first draw, deleted in dtor).
 	u32 m_QuadVAO = 0;
 	u32 m_QuadVBO = 0;
 	u32 m_QuadEBO = 0;
 
+	// R32F texture the CPU renderer's iteration buffer is uploaded into,
+	// and the renderer version it holds (0 after a Julia preview).
+	u32 m_IterationTexture = 0;
+	u32 m_IterationTextureWidth = 0;
+	u32 m_IterationTextureHeight = 0;
+	u64 m_IterationTextureVersion = 0;
+	// R32UI texture of its periods, uploaded with the iterations.
+	u32 m_PeriodTexture = 0;
+	u32 m_PeriodTextureWidth = 0;
+	u32 m_PeriodTextureHeight = 0;
+
+	// R8 mask of the pixels the CPU strategy guessed, tinted over the image
+	// by the colorize pass while m_ShowGuessedPixels is set.
+	bool m_ShowGuessedPixels = false;
+	int m_TileCacheMegabytes = DefaultTileCacheMegabytes;
+	u32 m_GuessedTexture = 0;
+	u32 m_GuessedTextureWidth = 0;
+	u32 m_GuessedTextureHeight = 0;
+	u64 m_GuessedTextureVersion = 0;
+
+	// The GPU path's last two frames as R32F iterations, coloured on the
+	// way to the screen, ping-ponged: each frame blits what is still on
+	// screen from the other one. m_SceneShift* is how far
+	// the camera moved, in m_SceneView's pixels, since it was drawn;
+	// m_SceneRefine the tiles of a resampled frame still to redraw.
+	// Full frames also write each pixel's orbit to two RGBA32F attachments,
+	// (z, saved z) and their float-float lo parts, so that raising the
+	// iteration cap only continues the pixels that ran out. Perturbation
+	// passes flag their glitched pixels in an R8 one; m_SceneGlitchStats
+	// sums up the correction of the frame being drawn. Every pass writes the
+	// periods cycle detection found to an R32UI one, moved along with the
+	// iterations.
+	static constexpr u32 SceneTileSize = 128;
+	u32 m_SceneFramebuffers[2] = { 0, 0 };
+	u32 m_SceneTextures[2] = { 0, 0 };
+	u32 m_SceneOrbitTextures[2] = { 0, 0 };
+	u32 m_SceneOrbitLoTextures[2] = { 0, 0 };
+	u32 m_SceneGlitchTextures[2] = { 0, 0 };
+	u32 m_ScenePeriodTextures[2] = { 0, 0 };
+	std::vector<u8> m_SceneGlitched;
+	std::vector<float> m_SceneGlitchIterations;
+	CpuRenderStats m_SceneGlitchStats;
+	bool m_SceneOrbitsValid = false;
+	u32 m_SceneWidth = 0;
+	u32 m_SceneHeight = 0;
+	int m_SceneIndex = 0;
+	bool m_SceneValid = false;
+	FractalView m_SceneView;
+	double m_SceneShiftX = 0.0;
+	double m_SceneShiftY = 0.0;
+	std::vector<Tile> m_SceneRefine;
+	size_t m_SceneRefineNext = 0;
+
+	// RG32F copy of the perturbation reference orbit for Mandelbrot.glsl.
+	u32 m_ReferenceOrbitTexture = 0;
+	u64 m_ReferenceOrbitVersion = 0;
+
 private:
 	friend class ImGuiUtil;
 };
\ No newline at end of file
@@ -0,0 +1,480 @@
+#include "BigFixed.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+namespace
+{
+	// Magnitude kernels on raw little-endian limb arrays. Outputs may alias
+	// inputs limb for limb.
+
+	int CompareLimbs(const u32 *a, const u32 *b, size_t n)
+	{
+		for (size_t i = n; i-- > 0;)
+		{
+			if (a[i] != b[i])
+				return a[i] < b[i] ? -1 : 1;
+		}
+		return 0;
+	}
+
+	// out = a + b over n limbs; returns the carry out.
+	u32 AddLimbs(u32 *out, const u32 *a, const u32 *b, size_t n)
+	{
+		u64 carry = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const u64 t = (u64) a[i] + b[i] + carry;
+			out[i] = (u32) t;
+			carry = t >> 32;
+		}
+		return (u32) carry;
+	}
+	// out = a - b over n limbs; returns the borrow out.
+	u32 SubtractLimbs(u32 *out, const u32 *a, const u32 *b, size_t n)
+	{
+		u64 borrow = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const u64 t = (u64) a[i] - b[i] - borrow;
+			out[i] = (u32) t;
+			borrow = (t >> 63) & 1;
+		}
+		return (u32) borrow;
+	}
+
+	// a[0, n) += b[0, m) with m <= n, carrying through the rest of a.
+	u32 AddInto(u32 *a, size_t n, const u32 *b, size_t m)
+	{
+		u64 carry = AddLimbs(a, a, b, m);
+		for (size_t i = m; i < n && carry; i++)
+		{
+			const u64 t = (u64) a[i] + carry;
+			a[i] = (u32) t;
+			carry = t >> 32;
+		}
+		return (u32) carry;
+	}
+	// a[0, n) -= b[0, m) with m <= n, borrowing through the rest of a.
+	u32 SubtractInto(u32 *a, size_t n, const u32 *b, size_t m)
+	{
+		u32 borrow = SubtractLimbs(a, a, b, m);
+		for (size_t i = m; i < n && borrow; i++)
+			borrow = a[i]-- == 0;
+		return borrow;
+	}
+
+	// out[0, 2n) = a * b.
+	void MultiplySchoolbook(u32 *out, const u32 *a, const u32 *b, size_t n)
+	{
+		std::fill(out, out + 2 * n, 0u);
+		for (size_t i = 0; i < n; i++)
+		{
+			u64 carry = 0;
+			for (size_t j = 0; j < n; j++)
+			{
+				const u64 t = (u64) a[i] * b[j] + out[i + j] + carry;
+				out[i + j] = (u32) t;
+				carry = t >> 32;
+			}
+			out[i + n] = (u32) carry;
+		}
+	}
+
+	// out[0, 2n) = a * a: every a_i a_j (i < j) once, doubled, plus the
+	// squares on the diagonal.
+	void SquareSchoolbook(u32 *out, const u32 *a, size_t n)
+	{
+		std::fill(out, out + 2 * n, 0u);
+		for (size_t i = 0; i < n; i++)
+		{
+			u64 carry = 0;
+			for (size_t j = i + 1; j < n; j++)
+			{
+				const u64 t = (u64) a[i] * a[j] + out[i + j] + carry;
+				out[i + j] = (u32) t;
+				carry = t >> 32;
+			}
+			out[i + n] = (u32) carry;
+		}
+
+		// The cross terms are at most half the square, so doubling them
+		// can't carry out of the top limb.
+		u32 shifted = 0;
+		for (size_t i = 0; i < 2 * n; i++)
+		{
+			const u32 limb = out[i];
+			out[i] = (limb << 1) | shifted;
+			shifted = limb >> 31;
+		}
+
+		u64 carry = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			u64 t = (u64) a[i] * a[i] + out[2 * i] + carry;
+			out[2 * i] = (u32) t;
+			t = (t >> 32) + out[2 * i + 1];
+			out[2 * i + 1] = (u32) t;
+			carry = t >> 32;
+		}
+	}
+
+	// Limbs of scratch one Karatsuba level at n needs, including the levels
+	// below it: the two half sums, their product, and the next level's.
+	size_t KaratsubaScratch(size_t n)
+	{
+		if (n < BigFixed::KaratsubaCutoff)
+			return 0;
+		const size_t half = n - n / 2 + 1;
+		return 4 * half + KaratsubaScratch(half);
+	}
+
+	// a = a0 + a1 B^low, b likewise: a b = z0 + z1 B^low + z2 B^2low with
+	// z1 = (a0 + a1)(b0 + b1) - z0 - z2, three half-size products.
+	void MultiplyLimbs(u32 *out, const u32 *a, const u32 *b, size_t n, u32 *scratch)
+	{
+		if (n < BigFixed::KaratsubaCutoff)
+		{
+			MultiplySchoolbook(out, a, b, n);
+			return;
+		}
+
+		const size_t low = n / 2;
+		const size_t high = n - low;
+		MultiplyLimbs(out, a, b, low, scratch);
+		MultiplyLimbs(out + 2 * low, a + low, b + low, high, scratch);
+
+		// The sums get one extra limb for their carry.
+		u32 *sumA = scratch;
+		u32 *sumB = sumA + high + 1;
+		u32 *middle = sumB + high + 1;
+		std::copy(a + low, a + n, sumA);
+		sumA[high] = AddInto(sumA, high, a, low);
+		std::copy(b + low, b + n, sumB);
+		sumB[high] = AddInto(sumB, high, b, low);
+
+		const size_t middleSize = 2 * (high + 1);
+		MultiplyLimbs(middle, sumA, sumB, high + 1, middle + middleSize);
+		SubtractInto(middle, middleSize, out, 2 * low);
+		SubtractInto(middle, middleSize, out + 2 * low, 2 * high);
+		// z1 < 2 B^n, so whatever of it lies past the end of out is zero.
+		AddInto(out + low, 2 * n - low, middle, std::min(middleSize, 2 * n - low));
+	}
+
+	// MultiplyLimbs(out, a, a, n) with squares all the way down.
+	void SquareLimbs(u32 *out, const u32 *a, size_t n, u32 *scratch)
+	{
+		if (n < BigFixed::KaratsubaCutoff)
+		{
+			SquareSchoolbook(out, a, n);
+			return;
+		}
+
+		const size_t low = n / 2;
+		const size_t high = n - low;
+		SquareLimbs(out, a, low, scratch);
+		SquareLimbs(out + 2 * low, a + low, high, scratch);
+
+		u32 *sum = scratch;
+		u32 *middle = sum + 2 * (high + 1);
+		std::copy(a + low, a + n, sum);
+		sum[high] = AddInto(sum, high, a, low);
+
+		const size_t middleSize = 2 * (high + 1);
+		SquareLimbs(middle, sum, high + 1, middle + middleSize);
+		SubtractInto(middle, middleSize, out, 2 * low);
+		SubtractInto(middle, middleSize, out + 2 * low, 2 * high);
+		AddInto(out + low, 2 * n - low, middle, std::min(middleSize, 2 * n - low));
+	}
+}
+
+BigFixed::BigFixed(double value, u32 fractionLimbs)
+{
+	m_Limbs.assign(fractionLimbs + 1, 0u);
+	m_Negative = value < 0.0;
+
+	double magnitude = std::fabs(value);
+	if (!(magnitude < 4294967296.0))
+		magnitude = 4294967295.0;
+
+	// Peeling 32 bits at a time is exact: scaling by 2^32 and subtracting the
+	// integer part never rounds, so every bit of the double survives.
+	const double integer = std::floor(magnitude);
+	m_Limbs[fractionLimbs] = (u32) integer;
+
+	double fraction = magnitude - integer;
+	for (u32 i = fractionLimbs; i-- > 0 && fraction != 0.0;)
+	{
+		fraction *= 4294967296.0;
+		const double limb = std::floor(fraction);
+		m_Limbs[i] = (u32) limb;
+		fraction -= limb;
+	}
+}
+
+BigFixed::BigFixed(const FloatExp &value, u32 fractionLimbs)
+{
+	m_Limbs.assign(fractionLimbs + 1, 0u);
+	m_Negative = value.GetMantissa() < 0.0;
+	if (value.IsZero())
+		return;
+
+	// value = m 2^(32 q + r) with 0 <= r < 32, so m 2^r < 2^32 is the part
+	// landing in limb fractionLimbs + q; lower limbs are peeled as above.
+	const int exponent = value.GetExponent();
+	const int q = exponent >= 0 ? exponent / 32 : -((31 - exponent) / 32);
+	const int r = exponent - 32 * q;
+	const int top = (int) fractionLimbs + q;
+	if (q > 0)
+	{
+		m_Limbs[fractionLimbs] = 4294967295u;
+		return;
+	}
+	if (top < 0)
+		return;
+
+	double part = std::ldexp(std::fabs(value.GetMantissa()), r);
+	for (int i = top; i >= 0 && part != 0.0; i--)
+	{
+		const double limb = std::floor(part);
+		m_Limbs[i] = (u32) limb;
+		part = (part - limb) * 4294967296.0;
+	}
+}
+
+BigFixed BigFixed::FromString(const char *text, u32 fractionLimbs)
+{
+	BigFixed result(0.0, fractionLimbs);
+	BigFixed fraction(0.0, fractionLimbs);
+
+	const char *p = text;
+	bool negative = false;
+	if (*p == '-' || *p == '+')
+		negative = *p++ == '-';
+
+	bool anyDigits = false;
+	for (; *p >= '0' && *p <= '9'; p++)
+	{
+		result.MultiplySmall(10);
+		result.m_Limbs[fractionLimbs] += (u32) (*p - '0');
+		anyDigits = true;
+	}
+
+	if (*p == '.')
+	{
+		const char *first = ++p;
+		while (*p >= '0' && *p <= '9')
+			p++;
+
+		// Horner from the last digit backwards: f = (d_i + f) / 10.
+		for (const char *digit = p; digit-- != first;)
+		{
+			fraction.m_Limbs[fractionLimbs] += (u32) (*digit - '0');
+			fraction.DivideSmall(10);
+		}
+		anyDigits |= p != first;
+	}
+	AddLimbs(result.m_Limbs.data(), result.m_Limbs.data(), fraction.m_Limbs.data(), result.m_Limbs.size());
+
+	if (*p == 'e' || *p == 'E')
+	{
+		const int exponent = std::atoi(p + 1);
+		for (int i = 0; i < std::abs(exponent); i++)
+		{
+			if (exponent > 0)
+				result.MultiplySmall(10);
+			else
+				result.DivideSmall(10);
+		}
+	}
+
+	if (!anyDigits)
+		return BigFixed(0.0, fractionLimbs);
+
+	result.m_Negative = negative;
+	return result;
+}
+
+u32 BigFixed::LimbsForZoom(const FloatExp &zoom)
+{
+	const double bits = std::max(0.0, zoom.Log2()) + 64.0;
+	return (u32) std::ceil(bits / 32.0);
+}
+
+void BigFixed::SetFractionLimbs(u32 fractionLimbs)
+{
+	const u32 current = GetFractionLimbs();
+	if (fractionLimbs > current)
+		m_Limbs.insert(m_Limbs.begin(), fractionLimbs - current, 0u);
+	else if (fractionLimbs < current)
+		m_Limbs.erase(m_Limbs.begin(), m_Limbs.begin() + (current - fractionLimbs));
+}
+
+double BigFixed::ToDouble() const
+{
+	const int fractionLimbs = (int) GetFractionLimbs();
+
+	int top = (int) m_Limbs.size() - 1;
+	while (top > 0 && m_Limbs[top] == 0)
+		top--;
+
+	// Three limbs cover the 53-bit mantissa wherever the leading bit falls.
+	double result = 0.0;
+	for (int i = top; i >= 0 && i > top - 3; i--)
+		result += std::ldexp((double) m_Limbs[i], 32 * (i - fractionLimbs));
+
+	return m_Negative ? -result : result;
+}
+
+bool BigFixed::IsZero() const
+{
+	for (u32 limb : m_Limbs)
+	{
+		if (limb != 0)
+			return false;
+	}
+	return true;
+}
+
+BigFixed BigFixed::operator-() const
+{
+	BigFixed result = *this;
+	result.m_Negative = !m_Negative;
+	return result;
+}
+
+BigFixed BigFixed::operator+(const BigFixed &other) const
+{
+	const u32 fractionLimbs = std::max(GetFractionLimbs(), other.GetFractionLimbs());
+
+	BigFixed a = *this;
+	BigFixed b = other;
+	a.SetFractionLimbs(fractionLimbs);
+	b.SetFractionLimbs(fractionLimbs);
+	Add(a, b, a);
+	return a;
+}
+BigFixed BigFixed::operator-(const BigFixed &other) const
+{
+	return *this + (-other);
+}
+
+BigFixed BigFixed::operator*(const BigFixed &other) const
+{
+	const u32 fractionLimbs = std::max(GetFractionLimbs(), other.GetFractionLimbs());
+
+	BigFixed a = *this;
+	BigFixed b = other;
+	a.SetFractionLimbs(fractionLimbs);
+	b.SetFractionLimbs(fractionLimbs);
+
+	std::vector<u32> scratch = MakeScratch(fractionLimbs);
+	Multiply(a, b, a, scratch);
+	return a;
+}
+
+bool BigFixed::operator==(const BigFixed &other) const
+{
+	if (IsZero() && other.IsZero())
+		return true;
+	if (m_Negative != other.m_Negative)
+		return false;
+
+	if (GetFractionLimbs() == other.GetFractionLimbs())
+		return m_Limbs == other.m_Limbs;
+
+	const u32 fractionLimbs = std::max(GetFractionLimbs(), other.GetFractionLimbs());
+	BigFixed a = *this;
+	BigFixed b = other;
+	a.SetFractionLimbs(fractionLimbs);
+	b.SetFractionLimbs(fractionLimbs);
+	return a.m_Limbs == b.m_Limbs;
+}
+
+void BigFixed::MultiplySmall(u32 factor)
+{
+	u64 carry = 0;
+	for (u32 &limb : m_Limbs)
+	{
+		const u64 t = (u64) limb * factor + carry;
+		limb = (u32) t;
+		carry = t >> 32;
+	}
+}
+void BigFixed::DivideSmall(u32 divisor)
+{
+	u64 remainder = 0;
+	for (size_t i = m_Limbs.size(); i-- > 0;)
+	{
+		const u64 t = (remainder << 32) | m_Limbs[i];
+		m_Limbs[i] = (u32) (t / divisor);
+		remainder = t % divisor;
+	}
+}
+
+std::vector<u32> BigFixed::MakeScratch(u32 fractionLimbs)
+{
+	// The full double-width product, then the Karatsuba temporaries.
+	const size_t n = (size_t) fractionLimbs + 1;
+	return std::vector<u32>(2 * n + KaratsubaScratch(n), 0u);
+}
+
+void BigFixed::Add(const BigFixed &a, const BigFixed &b, BigFixed &result)
+{
+	AddSigned(a, b, false, result);
+}
+void BigFixed::Subtract(const BigFixed &a, const BigFixed &b, BigFixed &result)
+{
+	AddSigned(a, b, true, result);
+}
+
+void BigFixed::AddSigned(const BigFixed &a, const BigFixed &b, bool subtract, BigFixed &result)
+{
+	const size_t n = a.m_Limbs.size();
+	const bool negativeA = a.m_Negative;
+	const bool negativeB = b.m_Negative != subtract;
+	result.m_Limbs.resize(n);
+
+	u32 *out = result.m_Limbs.data();
+	const u32 *x = a.m_Limbs.data();
+	const u32 *y = b.m_Limbs.data();
+	if (negativeA == negativeB)
+	{
+		AddLimbs(out, x, y, n);
+		result.m_Negative = negativeA;
+	}
+	else if (CompareLimbs(x, y, n) >= 0)
+	{
+		SubtractLimbs(out, x, y, n);
+		result.m_Negative = negativeA;
+	}
+	else
+	{
+		SubtractLimbs(out, y, x, n);
+		result.m_Negative = negativeB;
+	}
+}
+
+void BigFixed::Multiply(const BigFixed &a, const BigFixed &b, BigFixed &result, std::vector<u32> &scratch)
+{
+	const size_t n = a.m_Limbs.size();
+	u32 *product = scratch.data();
+	MultiplyLimbs(product, a.m_Limbs.data(), b.m_Limbs.data(), n, product + 2 * n);
+
+	// Both operands carry a 2^(32 * fractionLimbs) scale, so the product
+	// carries it twice; dropping the lowest fractionLimbs limbs removes one.
+	result.m_Negative = a.m_Negative != b.m_Negative;
+	result.m_Limbs.assign(product + (n - 1), product + (2 * n - 1));
+}
+
+void BigFixed::Square(const BigFixed &a, BigFixed &result, std::vector<u32> &scratch)
+{
+	const size_t n = a.m_Limbs.size();
+	u32 *product = scratch.data();
+	SquareLimbs(product, a.m_Limbs.data(), n, product + 2 * n);
+
+	result.m_Negative = false;
+	result.m_Limbs.assign(product + (n - 1), product + (2 * n - 1));
+}
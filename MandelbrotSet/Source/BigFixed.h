@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Core.h"
+#include "FloatExp.h"
+
+#include <vector>
+
+
+// Signed fixed-point number with one 32-bit integer limb and a configurable
+// number of 32-bit fraction limbs, used for coordinates that have to stay
+// exact far below double precision (camera position, reference orbits).
+// Limbs are stored least significant first; the integer part is the last
+// limb, so magnitudes must stay below 2^32.
+//
+// Results of binary operations take the larger of the two precisions;
+// multiplication truncates toward zero. Products are computed exactly first
+// (schoolbook below KaratsubaCutoff limbs, Karatsuba above), so every
+// multiplication routine returns the same bits.
+class BigFixed
+{
+public:
+	static constexpr u32 KaratsubaCutoff = 32;
+
+	BigFixed() = default;
+	BigFixed(double value, u32 fractionLimbs);
+	// Bits below the last fraction limb are truncated.
+	BigFixed(const FloatExp &value, u32 fractionLimbs);
+
+	// Parses "[-]digits[.digits][e[-]digits]". Returns zero on malformed input.
+	static BigFixed FromString(const char *text, u32 fractionLimbs);
+
+	// Fraction limbs needed to resolve one pixel at `zoom` pixels per unit
+	// with ~64 bits to spare for the iteration itself.
+	static u32 LimbsForZoom(const FloatExp &zoom);
+
+	u32 GetFractionLimbs() const { return m_Limbs.empty() ? 0 : (u32) m_Limbs.size() - 1; }
+	void SetFractionLimbs(u32 fractionLimbs);
+
+	double ToDouble() const;
+	bool IsZero() const;
+	bool IsNegative() const { return m_Negative && !IsZero(); }
+
+	BigFixed operator-() const;
+	BigFixed operator+(const BigFixed &other) const;
+	BigFixed operator-(const BigFixed &other) const;
+	BigFixed operator*(const BigFixed &other) const;
+	BigFixed &operator+=(const BigFixed &other) { return *this = *this + other; }
+	BigFixed &operator-=(const BigFixed &other) { return *this = *this - other; }
+
+	bool operator==(const BigFixed &other) const;
+	bool operator!=(const BigFixed &other) const { return !(*this == other); }
+
+	// Allocation-free forms of the operators for hot loops such as the
+	// reference orbit. Operands must share one precision; `result` takes it
+	// and may alias an operand. `scratch` comes from MakeScratch() for that
+	// precision (or larger), after which these never touch the heap.
+	static std::vector<u32> MakeScratch(u32 fractionLimbs);
+	static void Add(const BigFixed &a, const BigFixed &b, BigFixed &result);
+	static void Subtract(const BigFixed &a, const BigFixed &b, BigFixed &result);
+	static void Multiply(const BigFixed &a, const BigFixed &b, BigFixed &result, std::vector<u32> &scratch);
+	// a * a, with each cross product computed once: about half the limb
+	// multiplications of Multiply(a, a).
+	static void Square(const BigFixed &a, BigFixed &result, std::vector<u32> &scratch);
+
+private:
+	void MultiplySmall(u32 factor);
+	void DivideSmall(u32 divisor);
+
+	// Adds b, or subtracts it when `subtract` is set, with the signs of a
+	// and b taken into account.
+	static void AddSigned(const BigFixed &a, const BigFixed &b, bool subtract, BigFixed &result);
+
+private:
+	std::vector<u32> m_Limbs = std::vector<u32>(1, 0u);
+	bool m_Negative = false;
+};
+
+// Arbitrary-precision counterpart of dvec2.
+struct BigVec2
+{
+	BigFixed x, y;
+
+	dvec2 ToDouble() const { return dvec2 { x.ToDouble(), y.ToDouble() }; }
+	// What ToDouble() rounded away: ToDouble() + ToDoubleRemainder() carries
+	// ~106 bits, the hi/lo pair the double-double and float-float paths use.
+	dvec2 ToDoubleRemainder() const
+	{
+		const dvec2 hi = ToDouble();
+		return dvec2 {
+			(x - BigFixed(hi.x, x.GetFractionLimbs())).ToDouble(),
+			(y - BigFixed(hi.y, y.GetFractionLimbs())).ToDouble()
+		};
+	}
+	void SetFractionLimbs(u32 fractionLimbs)
+	{
+		x.SetFractionLimbs(fractionLimbs);
+		y.SetFractionLimbs(fractionLimbs);
+	}
+};
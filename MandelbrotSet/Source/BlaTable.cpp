@@ -0,0 +1,136 @@
+#include "BlaTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+
+namespace
+{
+	inline dvec2 Mul(dvec2 a, dvec2 b)
+	{
+		return dvec2 { a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x };
+	}
+	inline double Magnitude(dvec2 a)
+	{
+		return std::hypot(a.x, a.y);
+	}
+
+	// Step x followed by step y:
+	//     A = Ay Ax,  B = Ay Bx + By,
+	// valid while both |d| < Rx and |Ax d + Bx dc| < Ry.
+	BlaStep Merge(const BlaStep &x, const BlaStep &y, const FloatExp &maxDc)
+	{
+		BlaStep step;
+		step.A = Mul(y.A, x.A);
+		const dvec2 yBx = Mul(y.A, x.B);
+		step.B = dvec2 { yBx.x + y.B.x, yBx.y + y.B.y };
+
+		// std::max(0.0, NaN) is 0.0, which also covers Ax == 0 at Z_0.
+		const double ry = std::max(0.0, (y.R - (maxDc * Magnitude(x.B)).ToDouble()) / Magnitude(x.A));
+		step.R = std::min(x.R, ry);
+		return step;
+	}
+
+	BlaStep Single(const dvec2 &Z)
+	{
+		// |d| < eps |Z|  =>  |d^2| < eps/2 |2 Z d|
+		BlaStep step;
+		step.A = dvec2 { 2.0 * Z.x, 2.0 * Z.y };
+		step.B = dvec2 { 1.0, 0.0 };
+		step.R = BlaTable::Epsilon * Magnitude(Z);
+		return step;
+	}
+
+	// Splits [0, count) into one contiguous range per thread; small ranges
+	// run inline since spawning costs more than the merges themselves.
+	template<typename Func>
+	void ParallelFor(size_t count, u32 threadCount, const Func &func)
+	{
+		constexpr size_t MinimumPerThread = 4096;
+
+		const size_t threads = std::min<size_t>(threadCount, (count + MinimumPerThread - 1) / MinimumPerThread);
+		if (threads <= 1)
+		{
+			func(0, count);
+			return;
+		}
+
+		std::vector<std::thread> workers;
+		workers.reserve(threads);
+		for (size_t t = 0; t < threads; t++)
+			workers.emplace_back(func, count * t / threads, count * (t + 1) / threads);
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+}
+
+
+void BlaTable::Build(const std::vector<dvec2> &orbit, const FloatExp &maxDc, u32 threadCount)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// Steps 0 .. count-1 may be covered; a block may end on the first Z
+	// outside the bailout (that landing point gets the escape test) but
+	// never pass it.
+	size_t count = orbit.empty() ? 0 : orbit.size() - 1;
+	for (size_t n = 1; n < count; n++)
+	{
+		if (orbit[n].x * orbit[n].x + orbit[n].y * orbit[n].y > 16.0)
+		{
+			count = n;
+			break;
+		}
+	}
+
+	m_Levels.clear();
+	std::vector<BlaStep> shorter;
+	for (int level = 1; (count >> level) > 0; level++)
+	{
+		std::vector<BlaStep> steps(count >> level);
+		const std::vector<BlaStep> *previous = level > MinLevel ? &m_Levels.back() : level > 1 ? &shorter : nullptr;
+
+		ParallelFor(steps.size(), threadCount, [&](size_t begin, size_t end)
+		{
+			for (size_t j = begin; j < end; j++)
+			{
+				steps[j] = previous ?
+					Merge((*previous)[2 * j], (*previous)[2 * j + 1], maxDc) :
+					Merge(Single(orbit[2 * j]), Single(orbit[2 * j + 1]), maxDc);
+			}
+		});
+		if (level < MinLevel)
+			shorter = std::move(steps);
+		else
+			m_Levels.push_back(std::move(steps));
+	}
+
+	m_MaxNorm = 0.0;
+	if (!m_Levels.empty())
+	{
+		for (const BlaStep &step : m_Levels.front())
+			m_MaxNorm = std::max(m_MaxNorm, step.R * step.R);
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	m_BuildMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void BlaTable::Clear()
+{
+	m_Levels.clear();
+	m_MaxNorm = 0.0;
+	m_BuildMilliseconds = 0.0;
+}
+
+size_t BlaTable::GetStepCount() const
+{
+	size_t count = 0;
+	for (const std::vector<BlaStep> &steps : m_Levels)
+		count += steps.size();
+	return count;
+}
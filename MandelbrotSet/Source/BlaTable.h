@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Core.h"
+#include "FloatExp.h"
+
+#include <vector>
+
+
+// One bilinear approximation: while |d_n| < R, `Length` perturbation steps
+// starting at n collapse into
+//
+//     d_{n+Length} = A d_n + B dc
+//
+// because every d^2 term they would add is negligible next to 2 Z d.
+struct BlaStep
+{
+	dvec2 A = { 0.0, 0.0 };
+	dvec2 B = { 0.0, 0.0 };
+	double R = 0.0;
+};
+
+// Hierarchy of bilinear approximations along a reference orbit. Level k
+// holds one step per aligned block [j 2^k, (j + 1) 2^k), built by merging the
+// two halves from level k - 1, so the pixel loop can jump over up to 2^k
+// iterations wherever the orbit happens to be instead of only at the start
+// like the series approximation.
+//
+// Steps shorter than 2^MinLevel are only built to merge from, never stored:
+// applying one costs about as much as the exact perturbation steps it
+// replaces, and looking them up on every other iteration cost more than
+// they saved (1e17 rendered no faster with two-iteration steps than
+// without BLA, and 20% faster from four up).
+class BlaTable
+{
+public:
+	static constexpr int MinLevel = 2;
+
+	// Largest |d| / |Z| a single step accepts, so the dropped d^2 stays
+	// below Epsilon / 2 of 2 Z d. Double rounding (2^-53) is almost never
+	// met by real deltas; checked against exactly iterated BigFixed orbits
+	// at 1e17 and 1e30, jumps up to 2^-43 leave as many pixels off by more
+	// than 2 iterations as the exact double steps do, 1e-12 twice as many.
+	// At 2^-24 a few percent of the pixels at 1e14 were off by up to 1000.
+	static constexpr double Epsilon = 0x1p-43;
+
+	// Builds the table for `orbit` (Z_0 .. Z_{length-1}) and pixels no more
+	// than `maxDc` away from the reference. Blocks are only formed across
+	// iterations where |Z| stays inside the pixel bailout, so a jump can never
+	// step over an escape. Levels are built on `threadCount` threads
+	// (0 = one per hardware thread). `maxDc` is extended since it underflows
+	// a double past ~1e308 of zoom while |B| maxDc still matters.
+	void Build(const std::vector<dvec2> &orbit, const FloatExp &maxDc, u32 threadCount = 0);
+	void Clear();
+
+	// Longest step starting at iteration n that is valid for a delta with
+	// |d|^2 == deltaNorm and ends no later than iteration `limit`; nullptr if
+	// none. `length` receives the number of iterations it covers. `Real` is
+	// double, or FloatExp for deltas too small for one.
+	template<typename Real>
+	const BlaStep *Lookup(int n, const Real &deltaNorm, int limit, int &length) const
+	{
+		// A merged step is never valid for a larger |d| than its first half,
+		// so the search climbs from the shortest step and stops at the first
+		// one that fails. Deltas past every step's radius, the common case
+		// once a pixel has left the start of the orbit, cost one comparison.
+		const BlaStep *best = nullptr;
+		if (!(deltaNorm < Real(m_MaxNorm)))
+			return best;
+		const int top = MinLevel - 1 + (int) m_Levels.size();
+		for (int level = MinLevel; level <= top && n > 0 && (n & ((1 << level) - 1)) == 0; level++)
+		{
+			const std::vector<BlaStep> &steps = m_Levels[level - MinLevel];
+			const size_t index = (size_t) (n >> level);
+			if (index >= steps.size() || n + (1 << level) > limit || !(deltaNorm < Real(steps[index].R) * Real(steps[index].R)))
+				break;
+
+			best = &steps[index];
+			length = 1 << level;
+		}
+		return best;
+	}
+
+	// Stored levels only.
+	int GetLevelCount() const { return (int) m_Levels.size(); }
+	size_t GetStepCount() const;
+	double GetBuildMilliseconds() const { return m_BuildMilliseconds; }
+
+private:
+	// m_Levels[k - MinLevel] holds the steps of length 2^k.
+	std::vector<std::vector<BlaStep>> m_Levels;
+	// Largest R^2 of level MinLevel, which bounds every longer step's too.
+	double m_MaxNorm = 0.0;
+	double m_BuildMilliseconds = 0.0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Core.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// CPU copy of MapToColor() from Colorize.glsl, used wherever iteration values
+// are turned into pixels without a GL context (headless renders).
+inline vec3 MapToColor(float v, const vec4 &color)
+{
+	const float r = 10.0f * color.x * (1.0f - v) * v * v * v;
+	const float g = 10.0f * color.y * (1.0f - v) * (1.0f - v) * v * v;
+	const float b = 10.0f * color.z * (1.0f - v) * (1.0f - v) * (1.0f - v) * v;
+
+	return vec3 { std::clamp(r, 0.0f, 1.0f), std::clamp(g, 0.0f, 1.0f), std::clamp(b, 0.0f, 1.0f) };
+}
+
+// CPU copy of PeriodToColor() from Colorize.glsl: the colour of an interior
+// pixel cycle detection found `period` for.
+inline vec3 PeriodToColor(u32 period)
+{
+	const float hue = (float) period * 0.618034f - std::floor((float) period * 0.618034f);
+	auto channel = [&](float shift)
+	{
+		const float h = hue + shift - std::floor(hue + shift);
+		return 0.35f * std::clamp(std::fabs(h * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+	};
+	return vec3 { channel(0.0f), channel(2.0f / 3.0f), channel(1.0f / 3.0f) };
+}
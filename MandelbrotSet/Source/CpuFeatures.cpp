@@ -0,0 +1,77 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define MANDELBROT_X86 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <cpuid.h>
+	#define MANDELBROT_X86 1
+#endif
+
+
+#if defined(MANDELBROT_X86)
+namespace
+{
+	void CpuId(u32 leaf, u32 subLeaf, u32 registers[4])
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, (int) leaf, (int) subLeaf);
+		for (int i = 0; i < 4; i++)
+			registers[i] = (u32) info[i];
+#else
+		__cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	u64 ReadXcr0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		// xgetbv by opcode, so this file needs no -mxsave.
+		u32 eax, edx;
+		__asm__ volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((u64) edx << 32) | eax;
+#endif
+	}
+
+	CpuFeatures Detect()
+	{
+		CpuFeatures features;
+
+		u32 regs[4];
+		CpuId(0, 0, regs);
+		const u32 maxLeaf = regs[0];
+
+		CpuId(1, 0, regs);
+		features.Sse2 = (regs[3] & (1u << 26)) != 0;
+
+		// AVX state is only usable once the OS has enabled XSAVE (OSXSAVE)
+		// and saves the YMM halves (XCR0 bits 1-2) -- and, for AVX-512, the
+		// opmask and ZMM registers (XCR0 bits 5-7) on context switches.
+		const bool osxsave = (regs[2] & (1u << 27)) != 0;
+		const u64 xcr0 = osxsave ? ReadXcr0() : 0;
+		const bool osYmm = (xcr0 & 0x06) == 0x06;
+		const bool osZmm = (xcr0 & 0xe6) == 0xe6;
+
+		if (maxLeaf >= 7)
+		{
+			CpuId(7, 0, regs);
+			features.Avx2 = osYmm && (regs[1] & (1u << 5)) != 0;
+			features.Avx512 = osZmm && (regs[1] & (1u << 16)) != 0;
+		}
+		return features;
+	}
+}
+#endif
+
+const CpuFeatures &CpuFeatures::Host()
+{
+#if defined(MANDELBROT_X86)
+	static const CpuFeatures features = Detect();
+#else
+	static const CpuFeatures features;
+#endif
+	return features;
+}
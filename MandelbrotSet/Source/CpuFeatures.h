@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Core.h"
+
+
+// Instruction set extensions the escape kernels care about, detected once via
+// cpuid. Each flag also requires the OS to save the matching register state,
+// so a set flag means the kernel for it can actually run.
+struct CpuFeatures
+{
+	bool Sse2 = false;
+	bool Avx2 = false;
+	bool Avx512 = false;    // AVX-512F
+
+	static const CpuFeatures &Host();
+};
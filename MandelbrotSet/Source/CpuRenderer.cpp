@@ -0,0 +1,1413 @@
+#include "CpuRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+
+
+namespace
+{
+	// Boundary tracing progress of a tile block.
+	enum TraceState : u8
+	{
+		TraceUnknown = 0,
+		TraceQueued  = 1,
+		TraceOutside = 2,   // frame around the tile
+		TraceDone    = 3,   // iterated, all one value and period
+		TraceMixed   = 4    // iterated, not all the same; neighbours queued
+	};
+
+	// Where the first tile boundary falls for a grid origin of `origin`,
+	// in [0, size).
+	u32 GridPhase(i64 origin, u32 size)
+	{
+		const i64 phase = -origin % (i64) size;
+		return (u32) (phase < 0 ? phase + size : phase);
+	}
+
+	// Moves every pixel of a width x height image dx, dy pixels; what is
+	// moved in from outside keeps its old contents.
+	template<typename T>
+	void ShiftImage(std::vector<T> &image, u32 width, u32 height, int dx, int dy)
+	{
+		if (image.empty())
+			return;
+		const u32 columns = width - (u32) std::abs(dx);
+		const u32 rows = height - (u32) std::abs(dy);
+		const u32 fromX = dx < 0 ? (u32) -dx : 0, toX = dx > 0 ? (u32) dx : 0;
+		for (u32 i = 0; i < rows; i++)
+		{
+			// Rows move away from the side they are read from first.
+			const u32 row = dy > 0 ? rows - 1 - i : i;
+			const u32 fromY = dy < 0 ? row + (u32) -dy : row, toY = dy > 0 ? row + (u32) dy : row;
+			std::memmove(&image[(size_t) toY * width + toX], &image[(size_t) fromY * width + fromX], columns * sizeof(T));
+		}
+	}
+}
+
+CpuRenderer::CpuRenderer(u32 threadCount)
+	: m_Scheduler(threadCount), m_Kernel(&EscapeKernels::Default())
+{
+}
+
+void CpuRenderer::Render(const FractalView &view, Precision precision, Perturbation *perturbation)
+{
+	const bool sameSetup = m_HasLastView && precision == m_LastPrecision &&
+		(perturbation != nullptr) == m_LastPerturbed && m_Strategy == m_LastStrategy;
+	const bool moved = m_PanX != 0.0 || m_PanY != 0.0;
+	const double panX = m_PanX, panY = m_PanY;
+	m_PanX = m_PanY = 0.0;
+
+	// A progressive render of the view it is already on runs its next pass,
+	// or nothing at all once it is complete, whatever the strategy; a
+	// refinement a few more of its tiles.
+	const bool progressive = m_Progressive && m_Strategy == CpuStrategy::SolidGuess;
+	const bool unchanged = sameSetup && !moved && view == m_LastView;
+	const u64 perturbationVersion = perturbation ? perturbation->GetVersion() : 0;
+	if (m_Progressive && unchanged && IsComplete() && m_Kernel == m_LastKernel &&
+		perturbationVersion == m_LastPerturbationVersion)
+		return;
+	const bool refine = unchanged && m_RefineNext < m_RefineQueue.size();
+	const bool resume = progressive && unchanged && !refine;
+
+	// A complete render moved by Pan() keeps what is still on screen.
+	const bool pan = moved && sameSetup && IsComplete() && IsTranslationOf(view, m_LastView) &&
+		panX == std::trunc(panX) && panY == std::trunc(panY) &&
+		std::fabs(panX) < (double) view.Width && std::fabs(panY) < (double) view.Height;
+	// Any other move or zoom of the same fractal resamples the last image as a
+	// preview and refines it tile by tile, if there is a budget for that.
+	const bool reproject = !pan && !refine && m_RefineBudget > 0.0 && sameSetup && (moved || !(view.Zoom == m_LastView.Zoom)) &&
+		view.Type == m_LastView.Type && view.MaxIterations == m_LastView.MaxIterations &&
+		view.Width == m_LastView.Width && view.Height == m_LastView.Height &&
+		view.JuliaC.x == m_LastView.JuliaC.x && view.JuliaC.y == m_LastView.JuliaC.y;
+	const double scale = reproject ? (m_LastView.Zoom / view.Zoom).ToDouble() : 1.0;
+	// A raised iteration cap on a complete full render only continues the
+	// orbits that ran out; every other pixel is final already.
+	FractalView uncapped = view;
+	uncapped.MaxIterations = m_LastView.MaxIterations;
+	const int previousCap = m_LastView.MaxIterations;
+	const bool raise = m_Resumable && !m_Orbits.empty() && sameSetup && !moved && !perturbation &&
+		m_Strategy == CpuStrategy::Full && IsComplete() && previousCap > 0 && view.MaxIterations > previousCap &&
+		uncapped == m_LastView;
+
+	m_HasLastView = true;
+	m_LastView = view;
+	m_LastPrecision = precision;
+	m_LastPerturbed = perturbation != nullptr;
+	m_LastStrategy = m_Strategy;
+	m_LastKernel = m_Kernel;
+	m_LastPerturbationVersion = perturbationVersion;
+	m_Version++;
+
+	// With the tile cache on and the view on its grid, the strategy tiles
+	// line up with the cache's, so a cached tile stands in for whole ones.
+	double gridX = 0.0, gridY = 0.0;
+	const bool cached = m_TileCache.IsEnabled() && !perturbation &&
+		TileCache::GetGridOrigin(view, gridX, gridY) &&
+		std::fabs(gridX - std::round(gridX)) < TileCache::GridTolerance &&
+		std::fabs(gridY - std::round(gridY)) < TileCache::GridTolerance;
+	const i64 originX = cached ? (i64) std::llround(gridX) : 0;
+	const i64 originY = cached ? (i64) std::llround(gridY) : 0;
+	TileKey key;
+	key.Type = view.Type;
+	key.MaxIterations = view.MaxIterations;
+	key.Zoom = view.Zoom;
+	key.JuliaC = view.Type == FractalType::JuliaSet ? view.JuliaC : dvec2 { 0.0, 0.0 };
+	key.Precision = (int) precision;
+	key.Strategy = (int) m_Strategy;
+
+	Resize(view.Width, view.Height, GridPhase(originX, TileCache::TileSize), GridPhase(originY, TileCache::TileSize));
+	if (perturbation)
+		m_Glitched.resize(m_Iterations.size());
+	else
+		m_Glitched.clear();
+
+	const EscapeKernelFn kernelFn = m_Kernel->Get(precision);
+	const EscapeResumeFn resumeFn = m_Kernel->GetResume(precision);
+	const bool keepOrbits = m_Resumable && !perturbation && m_Strategy == CpuStrategy::Full &&
+		!pan && !reproject && !refine;
+	// Resize() drops the orbits if it moved the tiles; a raise then starts
+	// the pixels that ran out over.
+	if (!keepOrbits)
+		m_Orbits.clear();
+	else if (!raise || m_Orbits.size() != m_Tiles.size())
+		m_Orbits.assign(m_Tiles.size(), TileOrbits());
+
+	if (pan)
+	{
+		ShiftImage(m_Iterations, m_Width, m_Height, (int) panX, (int) panY);
+		ShiftImage(m_Periods, m_Width, m_Height, (int) panX, (int) panY);
+		ShiftImage(m_Guessed, m_Width, m_Height, (int) panX, (int) panY);
+		ShiftImage(m_Glitched, m_Width, m_Height, (int) panX, (int) panY);
+	}
+	else if (reproject)
+	{
+		Reproject(scale, panX, panY);
+		m_PendingStep = 0;
+	}
+	else if (!resume && !refine && !raise)
+	{
+		if (m_Strategy != CpuStrategy::Full)
+			m_Guessed.assign(m_Iterations.size(), 0);
+		else
+			m_Guessed.clear();
+		m_PendingStep = m_Strategy == CpuStrategy::SolidGuess ? SolidGuessStep : 0;
+		m_RefineQueue.clear();
+		m_RefineNext = 0;
+	}
+
+	// A new image, fresh or resampled, starts from the cached tiles it shows
+	// and works on the other strategy tiles only.
+	if (pan || raise)
+	{
+		m_CachedPixels = 0;
+	}
+	else if (!resume && !refine)
+	{
+		m_WorkTiles = m_Strategy == CpuStrategy::Subdivision ? m_SubdivisionTiles :
+			m_Strategy == CpuStrategy::BoundaryTrace ? m_TraceTiles :
+			m_Strategy == CpuStrategy::SolidGuess ? m_SolidGuessTiles : m_Tiles;
+		m_CachedPixels = 0;
+		if (cached)
+			FetchCachedTiles(key, originX, originY);
+		if (reproject)
+			QueueRefinement();
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	m_WorkerInterior.assign(m_Scheduler.GetWorkerCount(), 0);
+	m_WorkerPeriodic.assign(m_Scheduler.GetWorkerCount(), 0);
+	m_WorkerGuessed.assign(m_Scheduler.GetWorkerCount(), 0);
+	m_WorkerResumed.assign(m_Scheduler.GetWorkerCount(), 0);
+	const EscapeGatherFn gatherFn = m_Kernel->GetGather(precision);
+	m_GuessScratch.resize(m_Scheduler.GetWorkerCount());
+	u64 iterated = (u64) m_Width * m_Height - m_CachedPixels;
+	u32 tileCount = 0;
+	if (pan)
+	{
+		// Whatever the strategy, the strips are iterated in full.
+		Tile strips[2];
+		const u32 stripCount = GetPanStrips(m_Width, m_Height, (int) panX, (int) panY, strips);
+		m_PanTiles.clear();
+		for (u32 i = 0; i < stripCount; i++)
+		{
+			const Tile &strip = strips[i];
+			for (u32 y = strip.Y; y < strip.Y + strip.Height; y += TileSize)
+			{
+				for (u32 x = strip.X; x < strip.X + strip.Width; x += TileSize)
+					m_PanTiles.push_back({ x, y, std::min(TileSize, strip.X + strip.Width - x), std::min(TileSize, strip.Y + strip.Height - y) });
+			}
+		}
+		m_Scheduler.Run(m_PanTiles, [&](const Tile &tile, u32 worker)
+		{
+			IterateTile(tile, worker, view, kernelFn, perturbation);
+			if (!m_Guessed.empty())
+			{
+				for (u32 y = tile.Y; y < tile.Y + tile.Height; y++)
+					std::fill_n(&m_Guessed[(size_t) y * m_Width + tile.X], tile.Width, (u8) 0);
+			}
+		});
+		iterated = 0;
+		for (const Tile &tile : m_PanTiles)
+			iterated += (u64) tile.Width * tile.Height;
+		tileCount = (u32) m_PanTiles.size();
+	}
+	else if (raise)
+	{
+		m_Scheduler.Run(m_Tiles, [&](const Tile &tile, u32 worker)
+		{
+			ResumeTile(tile, worker, view, previousCap, resumeFn);
+		});
+		iterated = std::accumulate(m_WorkerResumed.begin(), m_WorkerResumed.end(), (u64) 0);
+		tileCount = (u32) m_Tiles.size();
+	}
+	else if (reproject || refine)
+	{
+		// Batches of one tile per worker, until the budget is spent. Each
+		// tile runs the strategy on its own, solid guessing included.
+		iterated = 0;
+		while (m_RefineNext < m_RefineQueue.size())
+		{
+			const size_t count = std::min((size_t) m_Scheduler.GetWorkerCount(), m_RefineQueue.size() - m_RefineNext);
+			m_RefineBatch.assign(m_RefineQueue.begin() + m_RefineNext, m_RefineQueue.begin() + m_RefineNext + count);
+			m_Scheduler.Run(m_RefineBatch, [&](const Tile &tile, u32 worker)
+			{
+				for (u32 y = tile.Y; y < tile.Y + tile.Height; y++)
+				{
+					const size_t offset = (size_t) y * m_Width + tile.X;
+					if (!m_Guessed.empty())
+						std::fill_n(&m_Guessed[offset], tile.Width, (u8) 0);
+					if (!m_Glitched.empty())
+						std::fill_n(&m_Glitched[offset], tile.Width, (u8) 0);
+				}
+				if (m_Strategy == CpuStrategy::Subdivision)
+					SubdivideTile(tile, worker, view, gatherFn, perturbation);
+				else if (m_Strategy == CpuStrategy::BoundaryTrace)
+					TraceTile(tile, worker, view, gatherFn, perturbation);
+				else if (m_Strategy == CpuStrategy::SolidGuess)
+				{
+					for (u32 step = SolidGuessStep; step >= MinSolidGuessStep; step /= 2)
+						GuessTile(tile, worker, view, step, gatherFn, perturbation, true);
+				}
+				else
+					IterateTile(tile, worker, view, kernelFn, perturbation);
+			});
+			m_RefineNext += count;
+			tileCount += (u32) count;
+			for (const Tile &tile : m_RefineBatch)
+				iterated += (u64) tile.Width * tile.Height;
+
+			const auto now = std::chrono::steady_clock::now();
+			if (std::chrono::duration<double, std::milli>(now - start).count() >= m_RefineBudget)
+				break;
+		}
+	}
+	else if (m_Strategy == CpuStrategy::Subdivision)
+	{
+		m_Scheduler.Run(m_WorkTiles, [&](const Tile &tile, u32 worker)
+		{
+			SubdivideTile(tile, worker, view, gatherFn, perturbation);
+		});
+		tileCount = (u32) m_WorkTiles.size();
+	}
+	else if (m_Strategy == CpuStrategy::BoundaryTrace)
+	{
+		m_Scheduler.Run(m_WorkTiles, [&](const Tile &tile, u32 worker)
+		{
+			TraceTile(tile, worker, view, gatherFn, perturbation);
+		});
+		tileCount = (u32) m_WorkTiles.size();
+	}
+	else if (m_Strategy == CpuStrategy::SolidGuess)
+	{
+		do
+		{
+			const u32 step = m_PendingStep;
+			m_Scheduler.Run(m_WorkTiles, [&](const Tile &tile, u32 worker)
+			{
+				GuessTile(tile, worker, view, step, gatherFn, perturbation);
+			});
+			m_PendingStep = step > MinSolidGuessStep ? step / 2 : 0;
+		}
+		while (!progressive && m_PendingStep > 0);
+		tileCount = (u32) m_WorkTiles.size();
+	}
+	else
+	{
+		m_Scheduler.Run(m_WorkTiles, [&](const Tile &tile, u32 worker)
+		{
+			if (keepOrbits)
+				ResumeTile(tile, worker, view, 0, resumeFn);
+			else
+				IterateTile(tile, worker, view, kernelFn, perturbation);
+		});
+		tileCount = (u32) m_WorkTiles.size();
+	}
+	// A resumed render or refinement adds to the calls before it. A raised
+	// cap keeps the interior the last one found.
+	const bool accumulate = resume || refine;
+	if (!accumulate && !raise)
+	{
+		m_Stats.InteriorPixels = 0;
+		m_Stats.PeriodicPixels = 0;
+	}
+	if (!accumulate)
+	{
+		m_Stats.GuessedPixels = 0;
+		m_Stats.Milliseconds = 0.0;
+		m_Stats.Pixels = 0;
+	}
+	m_Stats.Steals = m_Scheduler.GetLastStealCount();
+	m_Stats.InteriorPixels += std::accumulate(m_WorkerInterior.begin(), m_WorkerInterior.end(), (u64) 0);
+	m_Stats.PeriodicPixels += std::accumulate(m_WorkerPeriodic.begin(), m_WorkerPeriodic.end(), (u64) 0);
+	m_Stats.GuessedPixels += std::accumulate(m_WorkerGuessed.begin(), m_WorkerGuessed.end(), (u64) 0);
+
+	m_Stats.GlitchedPixels = 0;
+	m_Stats.GlitchPasses = 0;
+	m_Stats.References = 0;
+	m_Stats.UnfixedPixels = 0;
+	m_Stats.GlitchMilliseconds = 0.0;
+	if (perturbation && IsComplete())
+		FixGlitches(view, *perturbation, m_Iterations.data(), m_Glitched.data(), m_Stats);
+	if (cached && IsComplete())
+		StoreCachedTiles(key, originX, originY);
+
+	const auto end = std::chrono::steady_clock::now();
+
+	// Passes of a progressive render each cover the whole image.
+	m_Stats.Pixels = resume ? iterated : m_Stats.Pixels + iterated;
+	m_Stats.ReusedPixels = (u64) m_Width * m_Height - m_Stats.Pixels;
+	m_Stats.CachedPixels = m_CachedPixels;
+	m_Stats.Tiles = accumulate ? m_Stats.Tiles + tileCount : tileCount;
+	m_Stats.Milliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+	m_Stats.MegapixelsPerSecond = m_Stats.Milliseconds > 0.0 ?
+		(double) m_Stats.Pixels / (m_Stats.Milliseconds * 1000.0) : 0.0;
+	m_Stats.Kernel = perturbation ? "Perturbation" : m_Kernel->Name;
+}
+
+void CpuRenderer::Pan(double dx, double dy, const FloatExp &zoom)
+{
+	if (!m_HasLastView)
+		return;
+	const double scale = m_LastView.Zoom == zoom ? 1.0 : (m_LastView.Zoom / zoom).ToDouble();
+	m_PanX += dx * scale;
+	m_PanY += dy * scale;
+}
+
+void CpuRenderer::Reproject(double scale, double panX, double panY)
+{
+	// Pixel (x, y) shows what the last image had at
+	//   q + 0.5 = size / 2 + (p + 0.5 - size / 2) * scale - pan
+	// with scale the old zoom over the new one; outside it is 0.
+	m_PreviousIterations.swap(m_Iterations);
+	m_PreviousPeriods.swap(m_Periods);
+	m_Iterations.assign(m_PreviousIterations.size(), 0.0f);
+	m_Periods.assign(m_PreviousPeriods.size(), 0);
+
+	const double halfWidth = (double) m_Width / 2.0, halfHeight = (double) m_Height / 2.0;
+	for (u32 y = 0; y < m_Height; y++)
+	{
+		const double fromY = std::floor(halfHeight + ((double) y + 0.5 - halfHeight) * scale - panY);
+		if (fromY < 0.0 || fromY >= (double) m_Height)
+			continue;
+		const size_t fromRow = (size_t) fromY * m_Width;
+		const size_t row = (size_t) y * m_Width;
+		for (u32 x = 0; x < m_Width; x++)
+		{
+			const double fromX = std::floor(halfWidth + ((double) x + 0.5 - halfWidth) * scale - panX);
+			if (fromX < 0.0 || fromX >= (double) m_Width)
+				continue;
+			m_Iterations[row + x] = m_PreviousIterations[fromRow + (size_t) fromX];
+			m_Periods[row + x] = m_PreviousPeriods[fromRow + (size_t) fromX];
+		}
+	}
+
+	if (m_Strategy != CpuStrategy::Full)
+		m_Guessed.assign(m_Iterations.size(), 0);
+	else
+		m_Guessed.clear();
+	std::fill(m_Glitched.begin(), m_Glitched.end(), (u8) 0);
+}
+
+void CpuRenderer::QueueRefinement()
+{
+	m_RefineQueue = m_WorkTiles;
+	m_RefineNext = 0;
+
+	auto distance = [&](const Tile &tile)
+	{
+		const double dx = (double) tile.X + 0.5 * (double) tile.Width - m_FocusX;
+		const double dy = (double) tile.Y + 0.5 * (double) tile.Height - m_FocusY;
+		return dx * dx + dy * dy;
+	};
+	std::sort(m_RefineQueue.begin(), m_RefineQueue.end(), [&](const Tile &a, const Tile &b)
+	{
+		return distance(a) < distance(b);
+	});
+}
+
+u32 CpuRenderer::GetPanStrips(u32 width, u32 height, int dx, int dy, Tile strips[2])
+{
+	const u32 rows = (u32) std::abs(dy), columns = (u32) std::abs(dx);
+	u32 count = 0;
+	if (rows > 0)
+		strips[count++] = { 0, dy > 0 ? 0 : height - rows, width, rows };
+	if (columns > 0 && rows < height)
+		strips[count++] = { dx > 0 ? 0 : width - columns, dy > 0 ? rows : 0, columns, height - rows };
+	return count;
+}
+
+void CpuRenderer::FetchCachedTiles(TileKey key, i64 originX, i64 originY)
+{
+	constexpr u32 size = TileCache::TileSize;
+	m_CacheHits.clear();
+	for (u32 y = m_TileOriginY; y + size <= m_Height; y += size)
+	{
+		for (u32 x = m_TileOriginX; x + size <= m_Width; x += size)
+		{
+			key.X = originX + x;
+			key.Y = originY + y;
+			const size_t offset = (size_t) y * m_Width + x;
+			if (!m_TileCache.Find(key, &m_Iterations[offset], &m_Periods[offset], m_Width))
+				continue;
+			if (!m_Guessed.empty())
+			{
+				for (u32 row = 0; row < size; row++)
+					std::fill_n(&m_Guessed[offset + (size_t) row * m_Width], size, (u8) 0);
+			}
+			m_CacheHits.push_back({ x, y, size, size });
+			m_CachedPixels += (u64) size * size;
+		}
+	}
+
+	// Strategy tiles never straddle a cache tile's edge, so a cached tile
+	// either holds one whole or none of it.
+	m_WorkTiles.erase(std::remove_if(m_WorkTiles.begin(), m_WorkTiles.end(), [&](const Tile &tile)
+	{
+		return std::any_of(m_CacheHits.begin(), m_CacheHits.end(), [&](const Tile &hit)
+		{
+			return tile.X >= hit.X && tile.X < hit.X + hit.Width && tile.Y >= hit.Y && tile.Y < hit.Y + hit.Height;
+		});
+	}), m_WorkTiles.end());
+}
+
+void CpuRenderer::StoreCachedTiles(TileKey key, i64 originX, i64 originY)
+{
+	constexpr u32 size = TileCache::TileSize;
+	for (u32 y = m_TileOriginY; y + size <= m_Height; y += size)
+	{
+		for (u32 x = m_TileOriginX; x + size <= m_Width; x += size)
+		{
+			key.X = originX + x;
+			key.Y = originY + y;
+			const size_t offset = (size_t) y * m_Width + x;
+			m_TileCache.Insert(key, &m_Iterations[offset], &m_Periods[offset], m_Width);
+		}
+	}
+}
+
+void CpuRenderer::Resize(u32 width, u32 height, u32 originX, u32 originY)
+{
+	if (width != m_Width || height != m_Height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_Iterations.assign((size_t) width * height, 0.0f);
+		m_Periods.assign((size_t) width * height, 0);
+	}
+	else if (originX == m_TileOriginX && originY == m_TileOriginY && !m_Tiles.empty())
+	{
+		return;
+	}
+	m_TileOriginX = originX;
+	m_TileOriginY = originY;
+
+	// Boundaries fall on multiples of `size` from the origin; the first row
+	// and column may be narrower.
+	auto buildTiles = [&](std::vector<Tile> &tiles, u32 size)
+	{
+		tiles.clear();
+		const u32 firstX = originX % size, firstY = originY % size;
+		for (u32 y = 0; y < height; y = y == 0 && firstY > 0 ? firstY : y + size)
+		{
+			const u32 tileHeight = std::min(y == 0 && firstY > 0 ? firstY : size, height - y);
+			for (u32 x = 0; x < width; x = x == 0 && firstX > 0 ? firstX : x + size)
+			{
+				Tile tile;
+				tile.X = x;
+				tile.Y = y;
+				tile.Width = std::min(x == 0 && firstX > 0 ? firstX : size, width - x);
+				tile.Height = tileHeight;
+				tiles.push_back(tile);
+			}
+		}
+	};
+	buildTiles(m_Tiles, TileSize);
+	buildTiles(m_SubdivisionTiles, SubdivisionTileSize);
+	buildTiles(m_TraceTiles, TraceTileSize);
+	buildTiles(m_SolidGuessTiles, SolidGuessTileSize);
+	m_Orbits.clear();
+}
+
+void CpuRenderer::SubdivideTile(const Tile &tile, u32 worker, const FractalView &view, EscapeGatherFn gatherFn, Perturbation *perturbation)
+{
+	GuessScratch &scratch = m_GuessScratch[worker];
+	auto queue = [&](u32 x, u32 y)
+	{
+		scratch.Xs.push_back(x);
+		scratch.Ys.push_back(y);
+	};
+	auto queueRow = [&](u32 x, u32 y, u32 count)
+	{
+		for (u32 i = 0; i < count; i++)
+			queue(x + i, y);
+	};
+	auto queueColumn = [&](u32 x, u32 y, u32 count)
+	{
+		for (u32 i = 0; i < count; i++)
+			queue(x, y + i);
+	};
+
+	scratch.Xs.clear();
+	scratch.Ys.clear();
+	queueRow(tile.X, tile.Y, tile.Width);
+	if (tile.Height > 1)
+		queueRow(tile.X, tile.Y + tile.Height - 1, tile.Width);
+	if (tile.Height > 2)
+	{
+		queueColumn(tile.X, tile.Y + 1, tile.Height - 2);
+		if (tile.Width > 1)
+			queueColumn(tile.X + tile.Width - 1, tile.Y + 1, tile.Height - 2);
+	}
+	IteratePixels(scratch, worker, view, gatherFn, perturbation);
+
+	// Every rectangle in Rects has its border iterated and its inside not.
+	scratch.Rects.assign(1, tile);
+	while (!scratch.Rects.empty())
+	{
+		scratch.Xs.clear();
+		scratch.Ys.clear();
+		scratch.Next.clear();
+
+		for (const Tile &rect : scratch.Rects)
+		{
+			if (rect.Width <= 2 || rect.Height <= 2)
+				continue;
+
+			const u32 insideX = rect.X + 1, insideY = rect.Y + 1;
+			const u32 insideWidth = rect.Width - 2, insideHeight = rect.Height - 2;
+
+			if (IsBorderUniform(rect))
+			{
+				const size_t corner = (size_t) rect.Y * m_Width + rect.X;
+				const float value = m_Iterations[corner];
+				const u32 period = m_Periods[corner];
+				for (u32 y = insideY; y < insideY + insideHeight; y++)
+				{
+					const size_t offset = (size_t) y * m_Width + insideX;
+					std::fill_n(&m_Iterations[offset], insideWidth, value);
+					std::fill_n(&m_Periods[offset], insideWidth, period);
+					std::fill_n(&m_Guessed[offset], insideWidth, (u8) 1);
+					if (!m_Glitched.empty())
+						std::fill_n(&m_Glitched[offset], insideWidth, (u8) 0);
+				}
+				m_WorkerGuessed[worker] += (u64) insideWidth * insideHeight;
+			}
+			else if (rect.Width < MinSubdivisionSize || rect.Height < MinSubdivisionSize)
+			{
+				for (u32 y = insideY; y < insideY + insideHeight; y++)
+					queueRow(insideX, y, insideWidth);
+			}
+			else
+			{
+				// The dividing line becomes part of both halves' borders.
+				Tile first = rect, second = rect;
+				if (rect.Width >= rect.Height)
+				{
+					const u32 split = rect.X + rect.Width / 2;
+					queueColumn(split, insideY, insideHeight);
+					first.Width = split - rect.X + 1;
+					second.X = split;
+					second.Width = rect.X + rect.Width - split;
+				}
+				else
+				{
+					const u32 split = rect.Y + rect.Height / 2;
+					queueRow(insideX, split, insideWidth);
+					first.Height = split - rect.Y + 1;
+					second.Y = split;
+					second.Height = rect.Y + rect.Height - split;
+				}
+				scratch.Next.push_back(first);
+				scratch.Next.push_back(second);
+			}
+		}
+
+		IteratePixels(scratch, worker, view, gatherFn, perturbation);
+		std::swap(scratch.Rects, scratch.Next);
+	}
+}
+
+void CpuRenderer::TraceTile(const Tile &tile, u32 worker, const FractalView &view, EscapeGatherFn gatherFn, Perturbation *perturbation)
+{
+	// Outlines are followed from block to block on a grid of the tile's
+	// TraceBlockSize blocks with a one block frame around it: neighbours in
+	// the frame buffers are a row stride apart, and the frame saves bounds
+	// checks on every neighbour lookup. Blocks are iterated whole, so the
+	// bookkeeping is per block rather than per pixel.
+	GuessScratch &scratch = m_GuessScratch[worker];
+	constexpr u32 pitch = TraceTileSize / TraceBlockSize + 2;
+	const u32 blocksX = (tile.Width + TraceBlockSize - 1) / TraceBlockSize;
+	const u32 blocksY = (tile.Height + TraceBlockSize - 1) / TraceBlockSize;
+	const size_t framedBlocks = (size_t) pitch * (blocksY + 2);
+	scratch.State.assign(framedBlocks, TraceOutside);
+	scratch.TileValues.resize(framedBlocks);
+	scratch.TilePeriods.resize(framedBlocks);
+	for (u32 y = 1; y <= blocksY; y++)
+		std::fill_n(&scratch.State[(size_t) y * pitch + 1], blocksX, (u8) TraceUnknown);
+
+	// The pixels of the block with local index b, (y + 1) * pitch + x + 1
+	// for block (x, y) of the tile; blocks on its far edges are cut short.
+	auto blockPixels = [&](size_t b) -> Tile
+	{
+		const u32 x = (u32) (b % pitch - 1) * TraceBlockSize, y = (u32) (b / pitch - 1) * TraceBlockSize;
+		return { tile.X + x, tile.Y + y, std::min(TraceBlockSize, tile.Width - x), std::min(TraceBlockSize, tile.Height - y) };
+	};
+	auto queuePixels = [&](const Tile &pixels)
+	{
+		size_t i = scratch.Xs.size();
+		scratch.Xs.resize(i + (size_t) pixels.Width * pixels.Height);
+		scratch.Ys.resize(scratch.Xs.size());
+		for (u32 y = pixels.Y; y < pixels.Y + pixels.Height; y++)
+		{
+			for (u32 x = pixels.X; x < pixels.X + pixels.Width; x++, i++)
+			{
+				scratch.Xs[i] = x;
+				scratch.Ys[i] = y;
+			}
+		}
+	};
+
+	scratch.Local.clear();
+	auto queue = [&](size_t b)
+	{
+		if (scratch.State[b] != TraceUnknown)
+			return;
+		scratch.State[b] = TraceQueued;
+		scratch.Local.push_back((u32) b);
+	};
+	for (u32 x = 0; x < blocksX; x++)
+	{
+		queue(pitch + x + 1);
+		queue((size_t) blocksY * pitch + x + 1);
+	}
+	for (u32 y = 0; y < blocksY; y++)
+	{
+		queue((size_t) (y + 1) * pitch + 1);
+		queue((size_t) (y + 1) * pitch + blocksX);
+	}
+
+	// A block whose pixels are not all one value and period (glitched
+	// pixels match nothing) has an outline through it, and all 8 of its
+	// neighbours are queued. One that is has its value and period kept; two
+	// such 4-neighbours that differ have an outline along their shared
+	// edge, and the blocks on either side of both are queued.
+	while (!scratch.Local.empty())
+	{
+		std::swap(scratch.Local, scratch.Wave);
+		scratch.Local.clear();
+		scratch.Xs.clear();
+		scratch.Ys.clear();
+		for (const u32 b : scratch.Wave)
+			queuePixels(blockPixels(b));
+		IteratePixels(scratch, worker, view, gatherFn, perturbation);
+
+		for (const u32 b : scratch.Wave)
+		{
+			const Tile pixels = blockPixels(b);
+			const size_t corner = (size_t) pixels.Y * m_Width + pixels.X;
+			const float value = m_Iterations[corner];
+			bool uniform = true;
+			for (u32 y = 0; y < pixels.Height && uniform; y++)
+			{
+				const size_t row = corner + (size_t) y * m_Width;
+				for (u32 x = 0; x < pixels.Width; x++)
+					uniform &= m_Iterations[row + x] == value;
+				if (!m_Glitched.empty())
+					uniform &= std::find(&m_Glitched[row], &m_Glitched[row + pixels.Width], (u8) 1) == &m_Glitched[row + pixels.Width];
+			}
+			// Cycle detection reports a multiple of the period where the
+			// orbit had not converged by the first repeat, so the block's
+			// period is the shortest one and the others must be multiples
+			// of it.
+			u32 period = m_Periods[corner];
+			for (u32 y = 0; y < pixels.Height && uniform; y++)
+			{
+				const size_t row = corner + (size_t) y * m_Width;
+				period = std::min(period, *std::min_element(&m_Periods[row], &m_Periods[row + pixels.Width]));
+			}
+			if (period == 0)
+				uniform &= m_Periods[corner] == 0;
+			for (u32 y = 0; y < pixels.Height && uniform && period != 0; y++)
+			{
+				const size_t row = corner + (size_t) y * m_Width;
+				for (u32 x = 0; x < pixels.Width; x++)
+					uniform &= m_Periods[row + x] % period == 0;
+			}
+			scratch.State[b] = uniform ? TraceDone : TraceMixed;
+			scratch.TileValues[b] = value;
+			scratch.TilePeriods[b] = period;
+		}
+
+		for (const size_t b : scratch.Wave)
+		{
+			if (scratch.State[b] == TraceMixed)
+			{
+				for (const size_t n : { b - pitch - 1, b - pitch, b - pitch + 1, b - 1, b + 1, b + pitch - 1, b + pitch, b + pitch + 1 })
+					queue(n);
+				continue;
+			}
+			auto differs = [&](size_t n)
+			{
+				return scratch.State[n] == TraceDone && (scratch.TileValues[n] != scratch.TileValues[b] || scratch.TilePeriods[n] != scratch.TilePeriods[b]);
+			};
+			for (const size_t n : { b - 1, b + 1 })
+			{
+				if (!differs(n))
+					continue;
+				queue(b - pitch);
+				queue(b + pitch);
+				queue(n - pitch);
+				queue(n + pitch);
+			}
+			for (const size_t n : { b - pitch, b + pitch })
+			{
+				if (!differs(n))
+					continue;
+				queue(b - 1);
+				queue(b + 1);
+				queue(n - 1);
+				queue(n + 1);
+			}
+		}
+	}
+
+	// What no wave reached are areas of blocks enclosed by uniform ones,
+	// but not necessarily by a single outline of equal ones: two outlines
+	// that touch diagonally enclose an area between them, and a feature
+	// smaller than the pixel spacing leaves no outline at all. So each area
+	// (4-connected, found as runs of blocks along the rows) is checked
+	// first. One whose border is not all the same value and period, or is
+	// all pixels that ran out of iterations without a cycle (where isolated
+	// escaping pixels are common), is iterated. Any other one is sampled
+	// every TraceSampleStep pixels and filled only if every sample agrees
+	// with its border; otherwise it is iterated too.
+	static_assert(TraceBlockSize % TraceSampleStep == 0, "every block's corner is a sample");
+	scratch.Rects.clear();
+	scratch.Areas.clear();
+	scratch.Xs.clear();
+	scratch.Ys.clear();
+	auto pushRun = [&](u32 x, u32 y)
+	{
+		const size_t row = (size_t) (y + 1) * pitch + 1;
+		u32 left = x, right = x + 1;
+		while (left > 0 && scratch.State[row + left - 1] == TraceUnknown)
+			left--;
+		while (right < blocksX && scratch.State[row + right] == TraceUnknown)
+			right++;
+		std::fill(&scratch.State[row + left], &scratch.State[row + right], (u8) TraceQueued);
+		scratch.Rects.push_back({ left, y, right - left, 1 });
+	};
+	// The pixels of a run of blocks.
+	auto runPixels = [&](const Tile &run) -> Tile
+	{
+		const u32 x = run.X * TraceBlockSize, y = run.Y * TraceBlockSize;
+		return { tile.X + x, tile.Y + y, std::min(run.Width * TraceBlockSize, tile.Width - x), std::min(TraceBlockSize, tile.Height - y) };
+	};
+	for (u32 y = 0; y < blocksY; y++)
+	{
+		for (u32 x = 0; x < blocksX; x++)
+		{
+			if (scratch.State[(size_t) (y + 1) * pitch + x + 1] != TraceUnknown)
+				continue;
+
+			TraceArea area = { (u32) scratch.Rects.size(), 0, 0, 0.0f, 0, true, false, 0, 0 };
+			bool bordered = false;
+			auto border = [&](size_t n)
+			{
+				if (scratch.State[n] < TraceDone)
+					return;
+				if (!bordered)
+				{
+					area.Value = scratch.TileValues[n];
+					area.Period = scratch.TilePeriods[n];
+					bordered = true;
+				}
+				else if (scratch.TileValues[n] != area.Value || scratch.TilePeriods[n] != area.Period)
+					area.Fill = false;
+			};
+			pushRun(x, y);
+			for (size_t next = area.Begin; next < scratch.Rects.size(); next++)
+			{
+				const Tile run = scratch.Rects[next];
+				const size_t row = (size_t) (run.Y + 1) * pitch + 1;
+				const Tile pixels = runPixels(run);
+				area.Pixels += pixels.Width * pixels.Height;
+				border(row + run.X - 1);
+				border(row + run.X + run.Width);
+				for (const u32 ny : { run.Y - 1, run.Y + 1 })
+				{
+					const size_t neighbourRow = (size_t) (ny + 1) * pitch + 1;
+					for (u32 nx = run.X; nx < run.X + run.Width; nx++)
+					{
+						if (scratch.State[neighbourRow + nx] == TraceUnknown)
+						{
+							pushRun(nx, ny);
+							nx = scratch.Rects.back().X + scratch.Rects.back().Width;
+						}
+						else
+							border(neighbourRow + nx);
+					}
+				}
+			}
+			area.End = (u32) scratch.Rects.size();
+			if (area.Value >= 1.0f && area.Period == 0)
+				area.Fill = false;
+
+			area.Sampled = area.Fill;
+			area.SampleBegin = (u32) scratch.Xs.size();
+			for (u32 r = area.Begin; r < area.End; r++)
+			{
+				const Tile pixels = runPixels(scratch.Rects[r]);
+				if (!area.Fill)
+				{
+					queuePixels(pixels);
+					continue;
+				}
+				for (u32 sy = 0; sy < pixels.Height; sy += TraceSampleStep)
+				{
+					for (u32 sx = 0; sx < pixels.Width; sx += TraceSampleStep)
+					{
+						scratch.Xs.push_back(pixels.X + sx);
+						scratch.Ys.push_back(pixels.Y + sy);
+					}
+				}
+			}
+			area.SampleEnd = (u32) scratch.Xs.size();
+			scratch.Areas.push_back(area);
+		}
+	}
+	IteratePixels(scratch, worker, view, gatherFn, perturbation);
+
+	// Sampled areas that all agree are filled, their samples keeping what
+	// they were iterated to.
+	u64 filled = 0;
+	for (TraceArea &area : scratch.Areas)
+	{
+		if (!area.Sampled)
+			continue;
+		for (u32 i = area.SampleBegin; area.Fill && i < area.SampleEnd; i++)
+		{
+			// Cycle detection reports a multiple of the period where the
+			// orbit had not converged by the first repeat; such a sample
+			// is still the same cycle as its border.
+			const size_t pixel = (size_t) scratch.Ys[i] * m_Width + scratch.Xs[i];
+			const u32 period = m_Periods[pixel];
+			const bool sameCycle = area.Period == 0 ? period == 0 : period != 0 && period % area.Period == 0;
+			if (m_Iterations[pixel] != area.Value || !sameCycle || (!m_Glitched.empty() && m_Glitched[pixel]))
+				area.Fill = false;
+		}
+		if (!area.Fill)
+			continue;
+
+		for (u32 r = area.Begin; r < area.End; r++)
+		{
+			const Tile pixels = runPixels(scratch.Rects[r]);
+			for (u32 y = pixels.Y; y < pixels.Y + pixels.Height; y++)
+			{
+				const size_t pixel = (size_t) y * m_Width + pixels.X;
+				std::fill_n(&m_Iterations[pixel], pixels.Width, area.Value);
+				std::fill_n(&m_Periods[pixel], pixels.Width, area.Period);
+				std::fill_n(&m_Guessed[pixel], pixels.Width, (u8) 1);
+				if (!m_Glitched.empty())
+					std::fill_n(&m_Glitched[pixel], pixels.Width, (u8) 0);
+			}
+		}
+		for (u32 i = area.SampleBegin; i < area.SampleEnd; i++)
+		{
+			const size_t pixel = (size_t) scratch.Ys[i] * m_Width + scratch.Xs[i];
+			m_Periods[pixel] = perturbation ? 0 : scratch.Periods[i];
+			m_Guessed[pixel] = 0;
+		}
+		filled += area.Pixels - (area.SampleEnd - area.SampleBegin);
+	}
+
+	// The others are iterated after all.
+	scratch.Xs.clear();
+	scratch.Ys.clear();
+	for (const TraceArea &area : scratch.Areas)
+	{
+		if (!area.Sampled || area.Fill)
+			continue;
+		for (u32 r = area.Begin; r < area.End; r++)
+		{
+			const Tile pixels = runPixels(scratch.Rects[r]);
+			for (u32 y = 0; y < pixels.Height; y++)
+			{
+				for (u32 x = 0; x < pixels.Width; x++)
+				{
+					if (y % TraceSampleStep == 0 && x % TraceSampleStep == 0)
+						continue;
+					scratch.Xs.push_back(pixels.X + x);
+					scratch.Ys.push_back(pixels.Y + y);
+				}
+			}
+		}
+	}
+	IteratePixels(scratch, worker, view, gatherFn, perturbation);
+	m_WorkerGuessed[worker] += filled;
+}
+
+void CpuRenderer::IterateTile(const Tile &tile, u32 worker, const FractalView &view, EscapeKernelFn kernelFn, Perturbation *perturbation)
+{
+	for (u32 y = tile.Y; y < tile.Y + tile.Height; y++)
+		IterateSpan(worker, view, tile.X, y, tile.Width, kernelFn, perturbation);
+}
+
+void CpuRenderer::IterateSpan(u32 worker, const FractalView &view, u32 x, u32 y, u32 count, EscapeKernelFn kernelFn, Perturbation *perturbation)
+{
+	const size_t offset = (size_t) y * m_Width + x;
+	float *row = &m_Iterations[offset];
+	u32 *periods = &m_Periods[offset];
+	if (perturbation)
+	{
+		m_WorkerInterior[worker] += perturbation->IterateSpan(view, x, y, count, row, &m_Glitched[offset]);
+		std::fill(periods, periods + count, 0u);
+	}
+	else
+	{
+		const u32 interior = kernelFn(view, x, y, count, row, periods);
+		m_WorkerInterior[worker] += interior;
+		m_WorkerPeriodic[worker] += (u64) (count - std::count(periods, periods + count, 0u)) - interior;
+	}
+}
+
+void CpuRenderer::ResumeTile(const Tile &tile, u32 worker, const FractalView &view, int previousCap, EscapeResumeFn resumeFn)
+{
+	GuessScratch &scratch = m_GuessScratch[worker];
+	TileOrbits &orbits = m_Orbits[GetTileIndex(tile)];
+	scratch.Xs.clear();
+	scratch.Ys.clear();
+	scratch.States.clear();
+	auto queue = [&](size_t pixel)
+	{
+		scratch.Xs.push_back((u32) (pixel % m_Width));
+		scratch.Ys.push_back((u32) (pixel / m_Width));
+	};
+
+	// Kept orbits first, then whatever starts from z0: the whole tile for a
+	// new image, the pixels that ran out of a tile without orbits for a
+	// raised cap. Pixels that escaped keep their count.
+	if (previousCap > 0 && orbits.Valid)
+	{
+		for (size_t i = 0; i < orbits.Pixels.size(); i++)
+		{
+			queue(orbits.Pixels[i]);
+			scratch.States.push_back(orbits.States[i]);
+		}
+	}
+	const u32 resumed = (u32) scratch.Xs.size();
+	for (u32 y = tile.Y; y < tile.Y + tile.Height; y++)
+	{
+		for (u32 x = tile.X; x < tile.X + tile.Width; x++)
+		{
+			const size_t pixel = (size_t) y * m_Width + x;
+			float &value = m_Iterations[pixel];
+			if (previousCap == 0)
+				queue(pixel);
+			else if (m_Periods[pixel] > 0)
+				continue;
+			else if (value < 1.0f)
+				value = (float) std::lround((double) value * previousCap) / (float) view.MaxIterations;
+			else if (!orbits.Valid)
+				queue(pixel);
+		}
+	}
+
+	const u32 count = (u32) scratch.Xs.size();
+	scratch.States.resize(count);
+	scratch.Values.resize(count);
+	scratch.Periods.resize(count);
+	u32 interior = 0;
+	if (resumed > 0)
+	{
+		resumeFn(view, scratch.Xs.data(), scratch.Ys.data(), resumed, (u32) previousCap, scratch.States.data(),
+			scratch.Values.data(), scratch.Periods.data());
+	}
+	if (count > resumed)
+	{
+		interior = resumeFn(view, scratch.Xs.data() + resumed, scratch.Ys.data() + resumed, count - resumed, 0,
+			scratch.States.data() + resumed, scratch.Values.data() + resumed, scratch.Periods.data() + resumed);
+	}
+
+	orbits.Valid = true;
+	orbits.Pixels.clear();
+	orbits.States.clear();
+	u64 periodic = 0;
+	for (u32 i = 0; i < count; i++)
+	{
+		const size_t pixel = (size_t) scratch.Ys[i] * m_Width + scratch.Xs[i];
+		m_Iterations[pixel] = scratch.Values[i];
+		m_Periods[pixel] = scratch.Periods[i];
+		periodic += scratch.Periods[i] > 0;
+		if (scratch.Values[i] >= 1.0f && scratch.Periods[i] == 0)
+		{
+			orbits.Pixels.push_back((u32) pixel);
+			orbits.States.push_back(scratch.States[i]);
+		}
+	}
+	m_WorkerInterior[worker] += interior;
+	m_WorkerPeriodic[worker] += periodic - interior;
+	m_WorkerResumed[worker] += count;
+}
+
+size_t CpuRenderer::GetTileIndex(const Tile &tile) const
+{
+	// Matches Resize(): a narrower first column and row when the grid
+	// origin is not on a tile boundary.
+	const u32 skipX = (TileSize - m_TileOriginX % TileSize) % TileSize;
+	const u32 skipY = (TileSize - m_TileOriginY % TileSize) % TileSize;
+	const u32 columns = (m_Width + skipX + TileSize - 1) / TileSize;
+	return (size_t) ((tile.Y + skipY) / TileSize) * columns + (tile.X + skipX) / TileSize;
+}
+
+void CpuRenderer::GuessTile(const Tile &tile, u32 worker, const FractalView &view, u32 step, EscapeGatherFn gatherFn, Perturbation *perturbation, bool isolated)
+{
+	GuessScratch &scratch = m_GuessScratch[worker];
+	scratch.Xs.clear();
+	scratch.Ys.clear();
+	auto queue = [&](u32 x, u32 y)
+	{
+		scratch.Xs.push_back(x);
+		scratch.Ys.push_back(y);
+	};
+
+	// A block's top and right lines are the bottom and left lines of the
+	// blocks past it, which the first pass iterates in the next tile. Each
+	// tile's grid starts at its corner, so one that is isolated or not a
+	// whole number of blocks wide or high, and one at the image's edge,
+	// iterates its own last column or row instead, and its last blocks end
+	// there.
+	const u32 endX = tile.X + tile.Width, endY = tile.Y + tile.Height;
+	const bool ownRight = isolated || tile.Width % SolidGuessStep || endX == m_Width;
+	const bool ownTop = isolated || tile.Height % SolidGuessStep || endY == m_Height;
+	const u32 lastX = ownRight ? endX - 1 : m_Width - 1;
+	const u32 lastY = ownTop ? endY - 1 : m_Height - 1;
+
+	u64 guessed = 0;
+	if (step == SolidGuessStep)
+	{
+		// Line by line, so that the gathered batches hold neighbours.
+		auto queueRow = [&](u32 y)
+		{
+			for (u32 x = tile.X; x < endX; x++)
+				queue(x, y);
+		};
+		auto queueColumn = [&](u32 x)
+		{
+			for (u32 y = tile.Y; y < endY; y++)
+			{
+				if ((y - tile.Y) % step != 0 && !(ownTop && y == lastY))
+					queue(x, y);
+			}
+		};
+		for (u32 y = tile.Y; y < endY; y += step)
+			queueRow(y);
+		if (ownTop && (lastY - tile.Y) % step != 0)
+			queueRow(lastY);
+		for (u32 x = tile.X; x < endX; x += step)
+			queueColumn(x);
+		if (ownRight && (lastX - tile.X) % step != 0)
+			queueColumn(lastX);
+	}
+	else
+	{
+		// Every block of the pass before this one, twice as wide, has its
+		// whole border iterated. One whose border is a single value and
+		// period (IsBorderUniform(), so no glitched pixels) is filled with
+		// it; any other gets its middle row and column iterated, which
+		// splits it into four blocks of this pass with known borders, or in
+		// the last pass its whole inside. A filament crossing a block
+		// therefore always shows on its border. Blocks inside one filled
+		// earlier are done already.
+		const u32 coarse = step * 2;
+		for (u32 y = tile.Y; y < endY; y += coarse)
+		{
+			for (u32 x = tile.X; x < endX; x += coarse)
+			{
+				const u32 right = std::min(x + coarse, lastX), top = std::min(y + coarse, lastY);
+				if (right < x + 2 || top < y + 2 || m_Guessed[(size_t) (y + 1) * m_Width + x + 1])
+					continue;
+				if (!IsBorderUniform({ x, y, right - x + 1, top - y + 1 }))
+				{
+					const u32 middleX = x + step, middleY = y + step;
+					for (u32 blockY = y + 1; blockY < top; blockY++)
+					{
+						for (u32 blockX = x + 1; blockX < right; blockX++)
+						{
+							if (step == MinSolidGuessStep || blockX == middleX || blockY == middleY)
+								queue(blockX, blockY);
+						}
+					}
+					continue;
+				}
+				const size_t corner = (size_t) y * m_Width + x;
+				for (u32 blockY = y + 1; blockY < top; blockY++)
+				{
+					const size_t row = (size_t) blockY * m_Width;
+					std::fill_n(&m_Iterations[row + x + 1], right - x - 1, m_Iterations[corner]);
+					std::fill_n(&m_Periods[row + x + 1], right - x - 1, m_Periods[corner]);
+					std::fill_n(&m_Guessed[row + x + 1], right - x - 1, (u8) 1);
+					if (!m_Glitched.empty())
+						std::fill_n(&m_Glitched[row + x + 1], right - x - 1, (u8) 0);
+				}
+				guessed += (u64) (right - x - 1) * (top - y - 1);
+			}
+		}
+	}
+	IteratePixels(scratch, worker, view, gatherFn, perturbation);
+	m_WorkerGuessed[worker] += guessed;
+
+	// Until the next pass, the inside of every block this pass left open
+	// shows the block's bottom left corner.
+	if (m_Progressive && !isolated && step > MinSolidGuessStep)
+	{
+		for (u32 y = tile.Y; y < endY; y += step)
+		{
+			for (u32 x = tile.X; x < endX; x += step)
+			{
+				const u32 right = std::min(x + step, lastX), top = std::min(y + step, lastY);
+				if (right < x + 2 || top < y + 2 || m_Guessed[(size_t) (y + 1) * m_Width + x + 1])
+					continue;
+				const float value = m_Iterations[(size_t) y * m_Width + x];
+				for (u32 blockY = y + 1; blockY < top; blockY++)
+					std::fill_n(&m_Iterations[(size_t) blockY * m_Width + x + 1], right - x - 1, value);
+			}
+		}
+	}
+}
+
+void CpuRenderer::IteratePixels(GuessScratch &scratch, u32 worker, const FractalView &view, EscapeGatherFn gatherFn, Perturbation *perturbation)
+{
+	const u32 count = (u32) scratch.Xs.size();
+	if (count == 0)
+		return;
+
+	// Perturbation iterates pixel by pixel anyway.
+	if (perturbation)
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			const size_t offset = (size_t) scratch.Ys[i] * m_Width + scratch.Xs[i];
+			m_WorkerInterior[worker] += perturbation->IterateSpan(view, scratch.Xs[i], scratch.Ys[i], 1,
+				&m_Iterations[offset], &m_Glitched[offset]);
+			m_Periods[offset] = 0;
+		}
+		return;
+	}
+
+	scratch.Values.resize(count);
+	scratch.Periods.resize(count);
+	const u32 interior = gatherFn(view, scratch.Xs.data(), scratch.Ys.data(), count, scratch.Values.data(), scratch.Periods.data());
+	m_WorkerInterior[worker] += interior;
+	m_WorkerPeriodic[worker] += (u64) (count - std::count(scratch.Periods.begin(), scratch.Periods.end(), 0u)) - interior;
+	for (u32 i = 0; i < count; i++)
+	{
+		const size_t offset = (size_t) scratch.Ys[i] * m_Width + scratch.Xs[i];
+		m_Iterations[offset] = scratch.Values[i];
+		m_Periods[offset] = scratch.Periods[i];
+	}
+}
+
+bool CpuRenderer::IsBorderUniform(const Tile &rect) const
+{
+	const size_t corner = (size_t) rect.Y * m_Width + rect.X;
+	const float value = m_Iterations[corner];
+	const u32 period = m_Periods[corner];
+
+	// Glitched pixels hold garbage; their rectangle keeps splitting so that
+	// FixGlitches() only ever sees iterated pixels.
+	auto matches = [&](size_t i)
+	{
+		return m_Iterations[i] == value && m_Periods[i] == period && (m_Glitched.empty() || !m_Glitched[i]);
+	};
+
+	const size_t top = corner + (size_t) (rect.Height - 1) * m_Width;
+	for (u32 x = 0; x < rect.Width; x++)
+	{
+		if (!matches(corner + x) || !matches(top + x))
+			return false;
+	}
+	for (u32 y = 1; y + 1 < rect.Height; y++)
+	{
+		const size_t left = corner + (size_t) y * m_Width;
+		if (!matches(left) || !matches(left + rect.Width - 1))
+			return false;
+	}
+	return true;
+}
+
+void CpuRenderer::FixGlitches(const FractalView &view, Perturbation &perturbation, float *iterations, u8 *glitched,
+	CpuRenderStats &stats)
+{
+	const u32 width = view.Width, height = view.Height;
+	const size_t pixels = (size_t) width * height;
+	const auto start = std::chrono::steady_clock::now();
+
+	stats.GlitchedPixels = (u64) std::count(glitched, glitched + pixels, (u8) 1);
+	stats.UnfixedPixels = stats.GlitchedPixels;
+	stats.References = 1;
+
+	// A region that a reference failed to fix would get the same pixel (and
+	// the same cached reference) again; it is skipped so smaller regions
+	// still get their turn.
+	std::vector<int> usedReferences;
+
+	for (u32 pass = 0; pass < m_GlitchPasses && stats.UnfixedPixels > 0; pass++)
+	{
+		const std::vector<u32> sizes = LabelGlitchRegions(glitched, width, height);
+
+		// New references go to the region pixel nearest its centroid; a
+		// glitch is centred on the feature the main reference can't resolve.
+		std::vector<dvec2> centroids(sizes.size(), dvec2 { 0.0, 0.0 });
+		for (size_t i = 0; i < m_RegionLabels.size(); i++)
+		{
+			if (m_RegionLabels[i] < 0)
+				continue;
+			dvec2 &centroid = centroids[m_RegionLabels[i]];
+			centroid.x += (double) (i % width);
+			centroid.y += (double) (i / width);
+		}
+		for (size_t r = 0; r < sizes.size(); r++)
+		{
+			centroids[r].x /= (double) sizes[r];
+			centroids[r].y /= (double) sizes[r];
+		}
+
+		std::vector<size_t> nearest(sizes.size(), 0);
+		std::vector<double> nearestDistance(sizes.size(), -1.0);
+		for (size_t i = 0; i < m_RegionLabels.size(); i++)
+		{
+			const int r = m_RegionLabels[i];
+			if (r < 0)
+				continue;
+			const double dx = (double) (i % width) - centroids[r].x;
+			const double dy = (double) (i / width) - centroids[r].y;
+			const double distance = dx * dx + dy * dy;
+			if (nearestDistance[r] < 0.0 || distance < nearestDistance[r])
+			{
+				nearest[r] = i;
+				nearestDistance[r] = distance;
+			}
+		}
+
+		std::vector<u32> order(sizes.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return sizes[a] > sizes[b]; });
+
+		std::vector<size_t> referencePixels;
+		std::vector<int> references;
+		for (u32 r : order)
+		{
+			if (references.size() == MaxReferencesPerPass)
+				break;
+
+			const dvec2 pixel = {
+				(double) (nearest[r] % width) + 0.5 - (double) width / 2.0,
+				(double) (nearest[r] / width) + 0.5 - (double) height / 2.0,
+			};
+			const int reference = perturbation.AddReference(view, pixel);
+			if (std::find(usedReferences.begin(), usedReferences.end(), reference) != usedReferences.end())
+				continue;
+
+			usedReferences.push_back(reference);
+			referencePixels.push_back(nearest[r]);
+			references.push_back(reference);
+		}
+		if (references.empty())
+			break;
+
+		// Glitches tend to break up into many small regions around the same
+		// feature, so every glitched pixel retries against its nearest new
+		// reference rather than only the pixels of the region it came from.
+		auto nearestReference = [&](u32 x, u32 y)
+		{
+			size_t best = 0;
+			double bestDistance = -1.0;
+			for (size_t k = 0; k < referencePixels.size(); k++)
+			{
+				const double dx = (double) x - (double) (referencePixels[k] % width);
+				const double dy = (double) y - (double) (referencePixels[k] / width);
+				const double distance = dx * dx + dy * dy;
+				if (bestDistance < 0.0 || distance < bestDistance)
+				{
+					best = k;
+					bestDistance = distance;
+				}
+			}
+			return references[best];
+		};
+
+		// One span per horizontal run of glitched pixels sharing a reference.
+		m_GlitchSpans.clear();
+		m_GlitchSpanReferences.clear();
+		for (u32 y = 0; y < height; y++)
+		{
+			const u8 *row = &glitched[(size_t) y * width];
+			for (u32 x = 0; x < width;)
+			{
+				if (!row[x])
+				{
+					x++;
+					continue;
+				}
+
+				const int reference = nearestReference(x, y);
+				Tile span;
+				span.X = x;
+				span.Y = y;
+				span.Height = 1;
+				while (x < width && row[x] && nearestReference(x, y) == reference)
+					x++;
+				span.Width = x - span.X;
+				m_GlitchSpans.push_back(span);
+				m_GlitchSpanReferences.push_back(reference);
+			}
+		}
+
+		m_Scheduler.Run(m_GlitchSpans, [&](const Tile &span, u32)
+		{
+			// Run() hands out references into m_GlitchSpans itself.
+			const size_t index = (size_t) (&span - m_GlitchSpans.data());
+			const size_t offset = (size_t) span.Y * width + span.X;
+			perturbation.IterateSpan(view, span.X, span.Y, span.Width, &iterations[offset],
+				&glitched[offset], m_GlitchSpanReferences[index]);
+		});
+
+		stats.GlitchPasses++;
+		stats.References += (u32) references.size();
+		stats.UnfixedPixels = (u64) std::count(glitched, glitched + pixels, (u8) 1);
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	stats.GlitchMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::vector<u32> CpuRenderer::LabelGlitchRegions(const u8 *glitched, u32 width, u32 height)
+{
+	const size_t pixels = (size_t) width * height;
+	m_RegionLabels.assign(pixels, -1);
+
+	std::vector<u32> sizes;
+	std::vector<size_t> stack;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		if (!glitched[i] || m_RegionLabels[i] >= 0)
+			continue;
+
+		const int label = (int) sizes.size();
+		sizes.push_back(0);
+		m_RegionLabels[i] = label;
+		stack.push_back(i);
+
+		while (!stack.empty())
+		{
+			const size_t p = stack.back();
+			stack.pop_back();
+			sizes.back()++;
+
+			auto visit = [&](size_t q)
+			{
+				if (glitched[q] && m_RegionLabels[q] < 0)
+				{
+					m_RegionLabels[q] = label;
+					stack.push_back(q);
+				}
+			};
+			const size_t x = p % width;
+			if (x > 0)
+				visit(p - 1);
+			if (x + 1 < width)
+				visit(p + 1);
+			if (p >= width)
+				visit(p - width);
+			if (p + width < pixels)
+				visit(p + width);
+		}
+	}
+	return sizes;
+}
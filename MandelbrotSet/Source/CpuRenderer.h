@@ -0,0 +1,340 @@
+#pragma once
+
+#include "EscapeKernels.h"
+#include "Fractal.h"
+#include "Perturbation.h"
+#include "TileCache.h"
+#include "TileScheduler.h"
+
+#include <vector>
+
+
+// Which pixels Render() iterates. Order matches the CPU strategy combo box.
+enum class CpuStrategy : int
+{
+	Full          = 0,
+	Subdivision   = 1,
+	BoundaryTrace = 2,
+	SolidGuess    = 3
+};
+
+struct CpuRenderStats
+{
+	// Pixels iterated or filled by the strategy; a panned frame only counts
+	// its new strips, and a raised iteration cap the pixels that had run
+	// out. The rest are ReusedPixels.
+	u64 Pixels = 0;
+	u64 ReusedPixels = 0;
+	// Part of ReusedPixels copied from the tile cache.
+	u64 CachedPixels = 0;
+	u32 Tiles = 0;
+	u64 Steals = 0;
+	double Milliseconds = 0.0;
+	double MegapixelsPerSecond = 0.0;
+	const char *Kernel = "";
+	// Mandelbrot pixels the cardioid / period-2 bulb test settled without
+	// iterating.
+	u64 InteriorPixels = 0;
+	// Pixels cycle detection settled as interior (escape kernels only).
+	u64 PeriodicPixels = 0;
+	// Subdivision, boundary tracing and solid guessing: pixels filled from
+	// the pixels around them without iterating.
+	u64 GuessedPixels = 0;
+
+	// Perturbation only: pixels the main reference glitched on, correction
+	// passes run, references used (main included), pixels still glitched
+	// afterwards and the time the passes took (orbits included).
+	u64 GlitchedPixels = 0;
+	u32 GlitchPasses = 0;
+	u32 References = 0;
+	u64 UnfixedPixels = 0;
+	double GlitchMilliseconds = 0.0;
+};
+
+// CPU counterpart of the fragment shaders. Renders a FractalView into a
+// Width x Height buffer of normalized iteration values (row 0 at the bottom,
+// same as glReadPixels), spread over a work-stealing TileScheduler.
+class CpuRenderer
+{
+public:
+	static constexpr u32 TileSize = 32;
+
+	// Subdivision (Mariani-Silver): each SubdivisionTileSize tile computes
+	// only its border; a rectangle whose whole border has the same value and
+	// period is filled without iterating, any other is split in two along its
+	// longer side and both halves are tried again. Rectangles narrower than
+	// MinSubdivisionSize are iterated outright.
+	static constexpr u32 SubdivisionTileSize = 128;
+	static constexpr u32 MinSubdivisionSize = 8;
+
+	// Boundary tracing (Fractint's, breadth first, on blocks): each
+	// TraceTileSize tile iterates its edge blocks, TraceBlockSize pixels
+	// square, then all 8 neighbours of every block whose pixels are not all
+	// one value and period and the blocks along the edge between two uniform
+	// ones that differ, until no new blocks come up. What is left are areas
+	// enclosed by uniform blocks. One whose border is a single value and
+	// period, other than pixels that ran out of iterations without a cycle,
+	// is sampled every TraceSampleStep pixels each way and filled if all
+	// samples agree with the border; any other is iterated. Ran-out areas
+	// hide isolated escaping pixels too often to be sampled, so under
+	// perturbation, where no periods are known, the interior is iterated in
+	// full.
+	static constexpr u32 TraceTileSize = 128;
+	static constexpr u32 TraceBlockSize = 8;
+	static constexpr u32 TraceSampleStep = 4;
+
+	// Solid guessing (Fractint's), in passes: every SolidGuessStep-th row
+	// and column first, which cuts each SolidGuessTileSize tile into blocks
+	// with iterated borders. Each later pass halves the blocks: one whose
+	// whole border has the same value and period is filled with it without
+	// being iterated, any other gets its middle row and column iterated.
+	// Blocks MinSolidGuessStep wide are iterated in full instead of split.
+	static constexpr u32 SolidGuessStep = 32;
+	static constexpr u32 MinSolidGuessStep = 4;
+	static constexpr u32 SolidGuessTileSize = 128;
+
+	// Glitch correction: each pass groups the glitched pixels into
+	// connected regions, places a new reference inside each of the
+	// MaxReferencesPerPass largest, and re-renders every glitched pixel
+	// against the nearest of them.
+	static constexpr u32 DefaultGlitchPasses = 8;
+	static constexpr u32 MaxReferencesPerPass = 16;
+
+	// threadCount == 0 starts one worker per hardware thread.
+	explicit CpuRenderer(u32 threadCount = 0);
+
+	CpuRenderer(const CpuRenderer &) = delete;
+	CpuRenderer &operator=(const CpuRenderer &) = delete;
+
+	// With `perturbation` set (deep Mandelbrot zoom, already Update()d for
+	// this view) pixels iterate deltas against its reference orbit instead
+	// of running the escape kernel; `precision` is then ignored. Glitched
+	// pixels are then fixed with secondary references added to it.
+	void Render(const FractalView &view, Precision precision, Perturbation *perturbation = nullptr);
+
+	// Tells the next Render() that the camera moved by dx, dy pixels of a
+	// view at `zoom` since the last one: content at pixel (x, y) of the last
+	// render moves by that much (scaled to its zoom). Accumulates until then.
+	// If nothing else about the view changed, the move is whole pixels and
+	// the last render was complete, the next one shifts the buffers and only
+	// iterates the strips the move exposed. The caller vouches for the
+	// offsets, which past double precision cannot be compared.
+	void Pan(double dx, double dy, const FloatExp &zoom);
+
+	// With a budget set (0, the default, turns this off), a render whose
+	// zoom changed, or that moved without a pan taking it, starts from the
+	// last image resampled to the new view. Strategy tiles then replace it
+	// within `milliseconds` per Render(), the ones nearest the focus first,
+	// and later Render() calls of the same view carry on until it is done.
+	void SetRefineBudget(double milliseconds) { m_RefineBudget = milliseconds; }
+	// Framebuffer pixel refinement starts from, usually the cursor.
+	void SetFocus(double x, double y) { m_FocusX = x; m_FocusY = y; }
+	// The strips of a width x height image a Pan(dx, dy) exposes: a full
+	// width one for dy, then one alongside the rest for dx. Returns how many.
+	static u32 GetPanStrips(u32 width, u32 height, int dx, int dy, Tile strips[2]);
+
+	// 0 leaves glitched pixels as the main reference rendered them.
+	void SetGlitchPasses(u32 passes) { m_GlitchPasses = passes; }
+	u32 GetGlitchPasses() const { return m_GlitchPasses; }
+	// Glitch correction as Render() runs it, for a view.Width x view.Height
+	// frame rendered elsewhere (the GPU path): re-renders the pixels flagged
+	// 1 in `glitched` into `iterations`, clears the flags of those it fixed
+	// and fills the glitch fields of `stats`. Render()'s buffers are left
+	// alone.
+	void FixGlitches(const FractalView &view, Perturbation &perturbation, float *iterations, u8 *glitched,
+		CpuRenderStats &stats);
+
+	// Full by default. The other strategies only differ from it where a
+	// feature lies inside a uniform region without touching the pixels they
+	// iterate, such as a filament thinner than a pixel.
+	void SetStrategy(CpuStrategy strategy) { m_Strategy = strategy; }
+	CpuStrategy GetStrategy() const { return m_Strategy; }
+
+	// For callers that Render() every frame. Solid guessing runs one pass
+	// and returns, leaving the pixels later passes will fill showing the
+	// coarse grid; calling it again with the same view runs the next pass.
+	// With any strategy, Render() of the view, settings and reference orbit
+	// of a complete image does nothing, so only colouring is left to redo.
+	// Any other view starts over.
+	void SetProgressive(bool progressive) { m_Progressive = progressive; }
+	bool IsProgressive() const { return m_Progressive; }
+	// False while a progressive render has passes left, or a refinement
+	// tiles.
+	bool IsComplete() const { return m_PendingStep == 0 && m_RefineNext >= m_RefineQueue.size(); }
+
+	// Off by default. A full render (CpuStrategy::Full, no perturbation)
+	// then keeps the orbit of every pixel that ran out of iterations, and
+	// when the next Render() only raises MaxIterations those pixels carry on
+	// from where they stopped: escaped and interior pixels are final, so
+	// only the extra iterations of the rest are spent. Costs an EscapeState
+	// per pixel that ran out. Any other change drops the orbits.
+	void SetResumable(bool resumable) { m_Resumable = resumable; }
+	bool IsResumable() const { return m_Resumable; }
+
+	// Defaults to EscapeKernels::Default(); overridden for benchmarking.
+	void SetKernel(const EscapeKernel &kernel) { m_Kernel = &kernel; }
+	const EscapeKernel &GetKernel() const { return *m_Kernel; }
+
+	const std::vector<float> &GetIterations() const { return m_Iterations; }
+	// Period of the attracting cycle each interior pixel was found on, same
+	// layout as GetIterations(); 0 for escaped pixels, pixels that ran out
+	// of iterations and every perturbation render.
+	const std::vector<u32> &GetPeriods() const { return m_Periods; }
+	// 1 for each pixel the strategy filled instead of iterating, same layout
+	// as GetIterations(); empty after a full render.
+	const std::vector<u8> &GetGuessed() const { return m_Guessed; }
+	u32 GetWidth() const { return m_Width; }
+	u32 GetHeight() const { return m_Height; }
+
+	// Finished tiles of earlier views, used by any Render() of a view on the
+	// cache's grid and not under perturbation. Off until given a budget or a
+	// store.
+	TileCache &GetTileCache() { return m_TileCache; }
+	const TileCache &GetTileCache() const { return m_TileCache; }
+
+	// Incremented by every Render() that touched the buffers, so callers
+	// can skip re-uploading them.
+	u64 GetVersion() const { return m_Version; }
+
+	const CpuRenderStats &GetStats() const { return m_Stats; }
+	u32 GetThreadCount() const { return m_Scheduler.GetWorkerCount(); }
+
+private:
+	// Tile boundaries fall originX, originY pixels (mod each tile size) from
+	// the bottom left corner, where the tile cache's grid puts them.
+	void Resize(u32 width, u32 height, u32 originX, u32 originY);
+	// Copies the cached tiles the view shows in full into the buffers and
+	// drops the strategy tiles they cover from m_WorkTiles. `originX`,
+	// `originY` is the grid pixel of pixel (0, 0).
+	void FetchCachedTiles(TileKey key, i64 originX, i64 originY);
+	// Caches every tile the finished view shows in full.
+	void StoreCachedTiles(TileKey key, i64 originX, i64 originY);
+	// Tracing: an area no wave reached, runs of blocks [Begin, End) of
+	// Rects holding Pixels pixels, its border's value and period, and the
+	// pixels of Xs / Ys that sample it (all of them when it is not Sampled).
+	struct TraceArea
+	{
+		u32 Begin, End, Pixels;
+		float Value;
+		u32 Period;
+		bool Fill, Sampled;
+		u32 SampleBegin, SampleEnd;
+	};
+
+	// Pixels the current subdivision level, tracing wave or probe grid of a
+	// tile still has to iterate, and what the strategy keeps between them;
+	// one per worker.
+	struct GuessScratch
+	{
+		std::vector<u32> Xs, Ys;
+		std::vector<float> Values;
+		std::vector<u32> Periods;
+		std::vector<Tile> Rects, Next;   // subdivision; tracing: runs of the unreached areas
+		std::vector<u32> Local, Wave;    // tracing: blocks of the next wave and of the one iterated
+		std::vector<TraceArea> Areas;    // tracing
+		std::vector<u8> State;           // tracing: per tile block, framed
+		std::vector<float> TileValues;   // tracing: per tile block, framed
+		std::vector<u32> TilePeriods;
+		std::vector<EscapeState> States; // resumable full renders
+	};
+
+	// Iterates the border of `tile`, then fills or splits its inside one
+	// level at a time, every pixel of a level in a single gathered batch.
+	void SubdivideTile(const Tile &tile, u32 worker, const FractalView &view, EscapeGatherFn gatherFn, Perturbation *perturbation);
+	// Iterates the edge of `tile`, then wave after wave of blocks along the
+	// outlines found so far, then checks each area no wave reached and fills
+	// or iterates it.
+	void TraceTile(const Tile &tile, u32 worker, const FractalView &view, EscapeGatherFn gatherFn, Perturbation *perturbation);
+	// Iterates every pixel of `tile` row by row.
+	void IterateTile(const Tile &tile, u32 worker, const FractalView &view, EscapeKernelFn kernelFn, Perturbation *perturbation);
+	// Iterates `count` pixels of row y from x.
+	void IterateSpan(u32 worker, const FractalView &view, u32 x, u32 y, u32 count, EscapeKernelFn kernelFn, Perturbation *perturbation);
+	// Resumable full renders: with `previousCap` 0 iterates every pixel of
+	// an m_Tiles tile and keeps the orbits that ran out. Otherwise the tile
+	// holds a complete image at that cap; escaped pixels are rescaled to
+	// the view's, and those that ran out continue from their kept orbits.
+	void ResumeTile(const Tile &tile, u32 worker, const FractalView &view, int previousCap, EscapeResumeFn resumeFn);
+	// Index of an m_Tiles tile.
+	size_t GetTileIndex(const Tile &tile) const;
+	// Runs the solid guessing pass with grid spacing `step` over `tile`. An
+	// isolated tile guesses from its own pixels only, so it can run all
+	// passes before its neighbours have run any.
+	void GuessTile(const Tile &tile, u32 worker, const FractalView &view, u32 step, EscapeGatherFn gatherFn, Perturbation *perturbation,
+		bool isolated = false);
+	// Resamples the last image into the buffers for a view `scale` times
+	// less zoomed in, whose camera moved panX, panY of the old pixels.
+	void Reproject(double scale, double panX, double panY);
+	// Queues the strategy's tiles for refinement, nearest the focus first.
+	void QueueRefinement();
+	void IteratePixels(GuessScratch &scratch, u32 worker, const FractalView &view, EscapeGatherFn gatherFn, Perturbation *perturbation);
+	bool IsBorderUniform(const Tile &rect) const;
+	// Labels 4-connected regions of `glitched` into m_RegionLabels and
+	// returns their sizes.
+	std::vector<u32> LabelGlitchRegions(const u8 *glitched, u32 width, u32 height);
+
+private:
+	TileScheduler m_Scheduler;
+	const EscapeKernel *m_Kernel = nullptr;
+
+	std::vector<float> m_Iterations;
+	std::vector<u32> m_Periods;
+	std::vector<Tile> m_Tiles;
+	std::vector<Tile> m_SubdivisionTiles;
+	std::vector<Tile> m_TraceTiles;
+	std::vector<Tile> m_SolidGuessTiles;
+	u32 m_TileOriginX = 0, m_TileOriginY = 0;
+	// Per m_Tiles tile, the pixels of the image that ran out of iterations
+	// and their orbits; empty unless the last Render() was a resumable full
+	// one. Tiles the cache filled have none.
+	struct TileOrbits
+	{
+		bool Valid = false;
+		std::vector<u32> Pixels;   // m_Iterations index
+		std::vector<EscapeState> States;
+	};
+	bool m_Resumable = false;
+	std::vector<TileOrbits> m_Orbits;
+	std::vector<u64> m_WorkerResumed;
+	// The strategy's tiles minus those the cache filled, for this image.
+	std::vector<Tile> m_WorkTiles;
+	TileCache m_TileCache;
+	std::vector<Tile> m_CacheHits;
+	u64 m_CachedPixels = 0;
+	std::vector<Tile> m_PanTiles;
+	std::vector<Tile> m_RefineQueue, m_RefineBatch;
+	size_t m_RefineNext = 0;
+	double m_RefineBudget = 0.0;
+	double m_FocusX = 0.0, m_FocusY = 0.0;
+	std::vector<float> m_PreviousIterations;
+	std::vector<u32> m_PreviousPeriods;
+	u32 m_Width = 0, m_Height = 0;
+
+	CpuStrategy m_Strategy = CpuStrategy::Full;
+	std::vector<u8> m_Guessed;
+	std::vector<u64> m_WorkerGuessed;
+	std::vector<GuessScratch> m_GuessScratch;
+
+	bool m_Progressive = false;
+	u32 m_PendingStep = 0;   // grid spacing of the next solid guessing pass, 0 when done
+	double m_PanX = 0.0, m_PanY = 0.0;   // in pixels of m_LastView
+
+	// What the buffers hold, for resuming progressive renders and panning.
+	bool m_HasLastView = false;
+	FractalView m_LastView;
+	Precision m_LastPrecision = Precision::Float;
+	bool m_LastPerturbed = false;
+	CpuStrategy m_LastStrategy = CpuStrategy::Full;
+	const EscapeKernel *m_LastKernel = nullptr;
+	u64 m_LastPerturbationVersion = 0;
+	u64 m_Version = 0;
+
+	u32 m_GlitchPasses = DefaultGlitchPasses;
+	std::vector<u8> m_Glitched;
+	std::vector<int> m_RegionLabels;
+	std::vector<Tile> m_GlitchSpans;
+	std::vector<int> m_GlitchSpanReferences;
+	std::vector<u64> m_WorkerInterior;   // per worker, summed into m_Stats
+	std::vector<u64> m_WorkerPeriodic;
+
+	CpuRenderStats m_Stats;
+};
@@ -0,0 +1,371 @@
+#include "EscapeKernels.h"
+
+#include "CpuFeatures.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+
+namespace
+{
+	// The highest power of two up to `start`: where the cycle detection of an
+	// orbit resumed after `start` iterations last saved z.
+	inline int LastSave(int start)
+	{
+		int savedAt = 0;
+		for (int k = 1; k > 0 && k <= start; k *= 2)
+			savedAt = k;
+		return savedAt;
+	}
+
+	// Mirrors the shader loop statement for statement -- including computing
+	// the new real part before the imaginary part and testing |z|^2 > 16 only
+	// after the update -- so the Float instantiation rounds exactly as the
+	// fp32 fragment shader does. `tolerance` is the squared cycle detection
+	// distance; a detected cycle counts as never escaping. `state`, if set,
+	// receives z when the orbit runs out, and with `start` > 0 the orbit
+	// continues from it instead of from (zx, zy).
+	template<typename T>
+	float Escape(T zx, T zy, T cx, T cy, int maxIterations, T tolerance, u32 &period, EscapeState *state = nullptr, int start = 0)
+	{
+		T savedX = zx, savedY = zy;
+		int savedAt = 0;
+		if (start > 0)
+		{
+			zx = (T) state->Zx;
+			zy = (T) state->Zy;
+			savedX = (T) state->SavedX;
+			savedY = (T) state->SavedY;
+			savedAt = LastSave(start);
+		}
+
+		period = 0;
+		int n = 0;
+		for (n = start; n < maxIterations; n++)
+		{
+			const T x = (zx * zx) - (zy * zy) + cx;
+			const T y = (T(2) * zx * zy) + cy;
+			zx = x;
+			zy = y;
+			if ((zx * zx) + (zy * zy) > T(16))
+				break;
+
+			// z_k against the z saved at the last power of two below k.
+			const int k = n + 1;
+			if (k - savedAt <= (savedAt >> PeriodCheckShift))
+			{
+				const T dx = zx - savedX;
+				const T dy = zy - savedY;
+				if ((dx * dx) + (dy * dy) < tolerance)
+				{
+					period = (u32) (k - savedAt);
+					return 1.0f;
+				}
+			}
+			if ((k & (k - 1)) == 0)
+			{
+				savedX = zx;
+				savedY = zy;
+				savedAt = k;
+			}
+		}
+		if (state && n == maxIterations)
+			*state = EscapeState { (double) zx, (double) zy, (double) savedX, (double) savedY, 0.0, 0.0, 0.0, 0.0 };
+		return (float) n / (float) maxIterations;
+	}
+
+	// Double-double: the unevaluated sum Hi + Lo with |Lo| <= ulp(Hi) / 2,
+	// ~106 significant bits out of plain IEEE doubles (Dekker / Knuth). No
+	// FMA anywhere, and the SIMD kernels repeat exactly this sequence of
+	// operations, so every kernel agrees bit for bit.
+	struct Dd
+	{
+		double Hi, Lo;
+	};
+
+	inline Dd TwoSum(double a, double b)
+	{
+		const double s = a + b;
+		const double v = s - a;
+		return Dd { s, (a - (s - v)) + (b - v) };
+	}
+	inline Dd QuickTwoSum(double a, double b)   // requires |a| >= |b|
+	{
+		const double s = a + b;
+		return Dd { s, b - (s - a) };
+	}
+	inline Dd TwoProduct(double a, double b)
+	{
+		constexpr double Splitter = 134217729.0;   // 2^27 + 1
+		const double p = a * b;
+		const double ta = Splitter * a;
+		const double aHi = ta - (ta - a);
+		const double aLo = a - aHi;
+		const double tb = Splitter * b;
+		const double bHi = tb - (tb - b);
+		const double bLo = b - bHi;
+		return Dd { p, (((aHi * bHi - p) + aHi * bLo) + aLo * bHi) + aLo * bLo };
+	}
+	inline Dd Add(Dd a, Dd b)
+	{
+		const Dd s = TwoSum(a.Hi, b.Hi);
+		return QuickTwoSum(s.Hi, s.Lo + (a.Lo + b.Lo));
+	}
+	inline Dd Negate(Dd a)
+	{
+		return Dd { -a.Hi, -a.Lo };
+	}
+	inline Dd Mul(Dd a, Dd b)
+	{
+		const Dd p = TwoProduct(a.Hi, b.Hi);
+		return QuickTwoSum(p.Hi, p.Lo + (a.Hi * b.Lo + a.Lo * b.Hi));
+	}
+
+	// Escape<T> in double-double. Only the bailout test looks at Hi alone.
+	float EscapeDd(Dd zx, Dd zy, Dd cx, Dd cy, int maxIterations, double tolerance, u32 &period, EscapeState *state = nullptr, int start = 0)
+	{
+		Dd savedX = zx, savedY = zy;
+		int savedAt = 0;
+		if (start > 0)
+		{
+			zx = Dd { state->Zx, state->ZxLo };
+			zy = Dd { state->Zy, state->ZyLo };
+			savedX = Dd { state->SavedX, state->SavedXLo };
+			savedY = Dd { state->SavedY, state->SavedYLo };
+			savedAt = LastSave(start);
+		}
+
+		period = 0;
+		int n = 0;
+		for (n = start; n < maxIterations; n++)
+		{
+			const Dd x = Add(Add(Mul(zx, zx), Negate(Mul(zy, zy))), cx);
+			const Dd y = Add(Mul(Dd { 2.0 * zx.Hi, 2.0 * zx.Lo }, zy), cy);
+			zx = x;
+			zy = y;
+			if ((zx.Hi * zx.Hi) + (zy.Hi * zy.Hi) > 16.0)
+				break;
+
+			const int k = n + 1;
+			if (k - savedAt <= (savedAt >> PeriodCheckShift))
+			{
+				const double dx = (zx.Hi - savedX.Hi) + (zx.Lo - savedX.Lo);
+				const double dy = (zy.Hi - savedY.Hi) + (zy.Lo - savedY.Lo);
+				if ((dx * dx) + (dy * dy) < tolerance)
+				{
+					period = (u32) (k - savedAt);
+					return 1.0f;
+				}
+			}
+			if ((k & (k - 1)) == 0)
+			{
+				savedX = zx;
+				savedY = zy;
+				savedAt = k;
+			}
+		}
+		if (state && n == maxIterations)
+			*state = EscapeState { zx.Hi, zy.Hi, savedX.Hi, savedY.Hi, zx.Lo, zy.Lo, savedX.Lo, savedY.Lo };
+		return (float) n / (float) maxIterations;
+	}
+
+	// Pixel i is (x + i, y), or (xs[i], ys[i]) when xs is set. Resumable
+	// orbits go to `states` when set (see EscapeResumeFn).
+	template<typename T>
+	u32 ScalarKernel(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods, u32 start, EscapeState *states)
+	{
+		// u_MaxIterations == 0 is a 0/0 in the shader; pin it to black instead.
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		// (gl_FragCoord.xy - u_ScreenSize / 2.0) / u_Zoom - u_Offset, with
+		// gl_FragCoord sampling pixel centres.
+		const T halfWidth  = (T) view.Width / T(2);
+		const T halfHeight = (T) view.Height / T(2);
+		const T zoom = (T) view.Zoom.ToDouble();
+		const T rowY = (((T) y + T(0.5)) - halfHeight) / zoom - (T) view.Offset.y;
+		T tolerance = T(PeriodTolerance) / zoom;
+		tolerance = tolerance * tolerance;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i++)
+		{
+			const T px = (((T) (xs ? xs[i] : x + i) + T(0.5)) - halfWidth) / zoom - (T) view.Offset.x;
+			const T py = xs ? (((T) ys[i] + T(0.5)) - halfHeight) / zoom - (T) view.Offset.y : rowY;
+
+			const bool julia = view.Type == FractalType::JuliaSet;
+			EscapeState *state = states ? &states[i] : nullptr;
+			if (!julia)
+			{
+				// Resumed orbits are past this test.
+				if (const int period = start == 0 ? MainComponentPeriod<T>(px, py) : 0)
+				{
+					out[i] = 1.0f;
+					periods[i] = (u32) period;
+					interior++;
+				}
+				else
+					out[i] = Escape<T>(T(0), T(0), px, py, view.MaxIterations, tolerance, periods[i], state, (int) start);
+			}
+			else
+				out[i] = Escape<T>(px, py, (T) view.JuliaC.x, (T) view.JuliaC.y, view.MaxIterations, tolerance, periods[i], state, (int) start);
+		}
+		return interior;
+	}
+
+	u32 ScalarKernelDoubleDouble(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods, u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		// The pixel's distance from the centre only needs fp64; the centre
+		// itself carries the full Offset + OffsetLo.
+		const double halfWidth  = (double) view.Width / 2.0;
+		const double halfHeight = (double) view.Height / 2.0;
+		const double zoom = view.Zoom.ToDouble();
+		const Dd offsetX = Negate(Dd { view.Offset.x, view.OffsetLo.x });
+		const Dd offsetY = Negate(Dd { view.Offset.y, view.OffsetLo.y });
+		const Dd rowY = Add(Dd { (((double) y + 0.5) - halfHeight) / zoom, 0.0 }, offsetY);
+		const Dd juliaX = { view.JuliaC.x, 0.0 };
+		const Dd juliaY = { view.JuliaC.y, 0.0 };
+		double tolerance = PeriodTolerance / zoom;
+		tolerance = tolerance * tolerance;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i++)
+		{
+			const Dd px = Add(Dd { (((double) (xs ? xs[i] : x + i) + 0.5) - halfWidth) / zoom, 0.0 }, offsetX);
+			const Dd py = xs ? Add(Dd { (((double) ys[i] + 0.5) - halfHeight) / zoom, 0.0 }, offsetY) : rowY;
+
+			const bool julia = view.Type == FractalType::JuliaSet;
+			EscapeState *state = states ? &states[i] : nullptr;
+			if (!julia)
+			{
+				// Hi alone places c far more finely than a pixel at any zoom
+				// this kernel serves the Mandelbrot set at.
+				if (const int period = start == 0 ? MainComponentPeriod(px.Hi, py.Hi) : 0)
+				{
+					out[i] = 1.0f;
+					periods[i] = (u32) period;
+					interior++;
+				}
+				else
+					out[i] = EscapeDd(Dd { 0.0, 0.0 }, Dd { 0.0, 0.0 }, px, py, view.MaxIterations, tolerance, periods[i], state, (int) start);
+			}
+			else
+				out[i] = EscapeDd(px, py, juliaX, juliaY, view.MaxIterations, tolerance, periods[i], state, (int) start);
+		}
+		return interior;
+	}
+
+	template<typename T>
+	u32 ScalarSpan(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return ScalarKernel<T>(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	template<typename T>
+	u32 ScalarGather(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return ScalarKernel<T>(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+	u32 ScalarSpanDoubleDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return ScalarKernelDoubleDouble(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 ScalarGatherDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return ScalarKernelDoubleDouble(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+	template<typename T>
+	u32 ScalarResume(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return ScalarKernel<T>(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 ScalarResumeDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return ScalarKernelDoubleDouble(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+}
+
+namespace EscapeKernels
+{
+	const EscapeKernel &Scalar()
+	{
+		static const EscapeKernel kernel = { "Scalar",
+			&ScalarSpan<float>, &ScalarSpan<double>, &ScalarSpanDoubleDouble,
+			&ScalarGather<float>, &ScalarGather<double>, &ScalarGatherDoubleDouble,
+			&ScalarResume<float>, &ScalarResume<double>, &ScalarResumeDoubleDouble };
+		return kernel;
+	}
+
+	const std::vector<const EscapeKernel *> &Available()
+	{
+		static const std::vector<const EscapeKernel *> kernels = []()
+		{
+			const CpuFeatures &host = CpuFeatures::Host();
+
+			std::vector<const EscapeKernel *> result;
+			if (Avx512() && host.Avx512)
+				result.push_back(Avx512());
+			if (Avx2() && host.Avx2)
+				result.push_back(Avx2());
+			if (Sse2() && host.Sse2)
+				result.push_back(Sse2());
+			result.push_back(&Scalar());
+			return result;
+		}();
+		return kernels;
+	}
+
+	const EscapeKernel *Find(const char *name)
+	{
+		for (const EscapeKernel *kernel : Available())
+		{
+			const char *a = kernel->Name;
+			const char *b = name;
+			while (*a && *b && std::tolower((unsigned char) *a) == std::tolower((unsigned char) *b))
+				a++, b++;
+			if (*a == '\0' && *b == '\0')
+				return kernel;
+		}
+		return nullptr;
+	}
+
+	const EscapeKernel &Default()
+	{
+		static const EscapeKernel &kernel = []() -> const EscapeKernel &
+		{
+			// Printed in release builds too: which kernel a fleet machine
+			// ended up on is exactly what you want to see in its logs.
+			if (const char *forced = std::getenv("MANDELBROT_KERNEL"))
+			{
+				if (const EscapeKernel *match = Find(forced))
+				{
+					std::printf("[INFO]: Escape kernel: %s (forced by MANDELBROT_KERNEL)\n", match->Name);
+					return *match;
+				}
+				std::fprintf(stderr, "[ERROR] MANDELBROT_KERNEL=%s is not available on this host\n", forced);
+			}
+
+			const EscapeKernel &widest = *Available().front();
+			std::printf("[INFO]: Escape kernel: %s\n", widest.Name);
+			return widest;
+		}();
+		return kernel;
+	}
+}
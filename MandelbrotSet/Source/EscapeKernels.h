@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Fractal.h"
+
+#include <vector>
+
+
+// Computes `count` horizontally adjacent pixels starting at framebuffer pixel
+// (x, y) -- y counted from the bottom, like gl_FragCoord -- and writes the
+// normalized iteration value n / u_MaxIterations the shaders would produce.
+// `periods` receives the period of each interior pixel whose cycle was found
+// (by MainComponentPeriod() or cycle detection, see PeriodTolerance), 0 for
+// the rest. Returns how many pixels MainComponentPeriod() settled without
+// iterating.
+using EscapeKernelFn = u32 (*)(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods);
+
+// Same for `count` arbitrary pixels, pixel i at (xs[i], ys[i]): packs the
+// scattered pixels subdivision computes into full SIMD batches.
+using EscapeGatherFn = u32 (*)(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods);
+
+// Where an orbit that ran out of iterations stopped: z after the last one and
+// the z cycle detection last saved. The Lo parts complete the double-double
+// kernels' values and are 0 from the others.
+struct EscapeState
+{
+	double Zx, Zy;
+	double SavedX, SavedY;
+	double ZxLo, ZyLo;
+	double SavedXLo, SavedYLo;
+};
+
+// Gathered, but continues each pixel's orbit from states[i], `start`
+// iterations in, so that raising MaxIterations only costs the iterations
+// past the old cap; `out` and `periods` come out as if iterated from the
+// start. The pixels must have run out of iterations at `start`, neither
+// escaping nor found periodic. With start 0 the orbits start afresh and
+// `states` is only written: every pixel that runs out (again) gets its
+// state, the others' entries are left alone.
+using EscapeResumeFn = u32 (*)(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods);
+
+struct EscapeKernel
+{
+	const char *Name;
+	EscapeKernelFn Float;
+	EscapeKernelFn Double;
+	EscapeKernelFn DoubleDouble;
+	EscapeGatherFn GatherFloat;
+	EscapeGatherFn GatherDouble;
+	EscapeGatherFn GatherDoubleDouble;
+	EscapeResumeFn ResumeFloat;
+	EscapeResumeFn ResumeDouble;
+	EscapeResumeFn ResumeDoubleDouble;
+
+	EscapeKernelFn Get(Precision precision) const
+	{
+		switch (precision)
+		{
+			case Precision::Double:       return Double;
+			case Precision::DoubleDouble: return DoubleDouble;
+			default:                      return Float;
+		}
+	}
+
+	EscapeGatherFn GetGather(Precision precision) const
+	{
+		switch (precision)
+		{
+			case Precision::Double:       return GatherDouble;
+			case Precision::DoubleDouble: return GatherDoubleDouble;
+			default:                      return GatherFloat;
+		}
+	}
+
+	EscapeResumeFn GetResume(Precision precision) const
+	{
+		switch (precision)
+		{
+			case Precision::Double:       return ResumeDouble;
+			case Precision::DoubleDouble: return ResumeDoubleDouble;
+			default:                      return ResumeFloat;
+		}
+	}
+};
+
+namespace EscapeKernels
+{
+	// Straight C++ port of Mandelbrot() / JuliaSet() from the shaders.
+	const EscapeKernel &Scalar();
+
+	// SIMD kernels with per-lane retirement, each in its own translation unit
+	// built for that ISA. nullptr when the kernel is not compiled into this
+	// build (non-x86 targets); callers must still check CpuFeatures before
+	// running one -- Available() does both.
+	const EscapeKernel *Sse2();      // 4 floats / 2 doubles / 2 double-doubles
+	const EscapeKernel *Avx2();      // 8 floats / 4 doubles / 4 double-doubles
+	const EscapeKernel *Avx512();    // 16 floats / 8 doubles / 8 double-doubles
+
+	// Every kernel that can run on this host, widest first, Scalar last.
+	const std::vector<const EscapeKernel *> &Available();
+
+	// Case-insensitive lookup among Available(); nullptr if not runnable here.
+	const EscapeKernel *Find(const char *name);
+
+	// The widest available kernel, unless the MANDELBROT_KERNEL environment
+	// variable names another available one. Logs its choice on first use.
+	const EscapeKernel &Default();
+}
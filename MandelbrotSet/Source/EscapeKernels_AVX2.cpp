@@ -0,0 +1,793 @@
+#include "EscapeKernels.h"
+
+// Built with -mavx2 (/arch:AVX2) on x86-64 only, see CMakeLists.txt. Nothing
+// in here may run before the host has been checked for AVX2 support.
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+namespace
+{
+	// One batch of 8 float or 4 double lanes. A batch retires only once every
+	// lane has escaped or hit the cap. Escaped lanes stop counting but keep
+	// iterating: escape is final and nothing reads their z again, and
+	// freezing z with a blend put the blend and the mask it waits on into
+	// every iteration's dependency chain, which cost a third of the
+	// throughput. Zx² and Zy² are kept from the escape test for the next
+	// step. The arithmetic is the same sequence of IEEE mul/add/sub as
+	// the scalar kernel -- deliberately no FMA -- so the Float variant still
+	// matches the shaders exactly.
+	struct BatchPs
+	{
+		__m256 Zx, Zy, Cx, Cy, N, Active;
+		__m256 SavedX, SavedY, Period;
+		__m256 Zx2, Zy2;   // Zx², Zy², shared by the escape test and the next Step
+
+		void Square()
+		{
+			Zx2 = _mm256_mul_ps(Zx, Zx);
+			Zy2 = _mm256_mul_ps(Zy, Zy);
+		}
+
+		void Step(__m256 two, __m256 one, __m256 bailout)
+		{
+			const __m256 newX = _mm256_add_ps(_mm256_sub_ps(Zx2, Zy2), Cx);
+			const __m256 newY = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, Zx), Zy), Cy);
+			Zx = newX;
+			Zy = newY;
+
+			Square();
+			const __m256 magnitude = _mm256_add_ps(Zx2, Zy2);
+			Active = _mm256_andnot_ps(_mm256_cmp_ps(magnitude, bailout, _CMP_GT_OQ), Active);
+
+			// The shader's `n` only advances past iterations that did not
+			// break out of the loop.
+			N = _mm256_add_ps(N, _mm256_and_ps(Active, one));
+		}
+
+		// Brent cycle detection, after Step: lanes back within `tolerance` of
+		// the saved z (squared distance below `toleranceSq`) are interior
+		// with the given period. |dx| < tolerance is implied by the full
+		// test, so lanes failing it are ruled out at half the cost; escaping
+		// orbits almost never pass it.
+		void DetectCycle(__m256 tolerance, __m256 toleranceSq, __m256 maxIter, int period)
+		{
+			const __m256 dx = _mm256_sub_ps(Zx, SavedX);
+			const __m256 near = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), dx), tolerance, _CMP_LT_OQ);
+			if (_mm256_movemask_ps(_mm256_and_ps(near, Active)) == 0)
+				return;
+
+			const __m256 dy = _mm256_sub_ps(Zy, SavedY);
+			const __m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			const __m256 cycle = _mm256_and_ps(_mm256_cmp_ps(distance, toleranceSq, _CMP_LT_OQ), Active);
+			N = _mm256_blendv_ps(N, maxIter, cycle);
+			Period = _mm256_blendv_ps(Period, _mm256_set1_ps((float) period), cycle);
+			Active = _mm256_andnot_ps(cycle, Active);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+	struct BatchPd
+	{
+		__m256d Zx, Zy, Cx, Cy, N, Active;
+		__m256d SavedX, SavedY, Period;
+		__m256d Zx2, Zy2;   // Zx², Zy², shared by the escape test and the next Step
+
+		void Square()
+		{
+			Zx2 = _mm256_mul_pd(Zx, Zx);
+			Zy2 = _mm256_mul_pd(Zy, Zy);
+		}
+
+		void Step(__m256d two, __m256d one, __m256d bailout)
+		{
+			const __m256d newX = _mm256_add_pd(_mm256_sub_pd(Zx2, Zy2), Cx);
+			const __m256d newY = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, Zx), Zy), Cy);
+			Zx = newX;
+			Zy = newY;
+
+			Square();
+			const __m256d magnitude = _mm256_add_pd(Zx2, Zy2);
+			Active = _mm256_andnot_pd(_mm256_cmp_pd(magnitude, bailout, _CMP_GT_OQ), Active);
+
+			N = _mm256_add_pd(N, _mm256_and_pd(Active, one));
+		}
+
+		void DetectCycle(__m256d tolerance, __m256d toleranceSq, __m256d maxIter, int period)
+		{
+			const __m256d dx = _mm256_sub_pd(Zx, SavedX);
+			const __m256d near = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), dx), tolerance, _CMP_LT_OQ);
+			if (_mm256_movemask_pd(_mm256_and_pd(near, Active)) == 0)
+				return;
+
+			const __m256d dy = _mm256_sub_pd(Zy, SavedY);
+			const __m256d distance = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+			const __m256d cycle = _mm256_and_pd(_mm256_cmp_pd(distance, toleranceSq, _CMP_LT_OQ), Active);
+			N = _mm256_blendv_pd(N, maxIter, cycle);
+			Period = _mm256_blendv_pd(Period, _mm256_set1_pd((double) period), cycle);
+			Active = _mm256_andnot_pd(cycle, Active);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+
+	// MainComponentPeriod() from Fractal.h, lane by lane: 1 in the main
+	// cardioid, 2 in the period-2 bulb, 0 elsewhere.
+	inline __m256 MainComponentPeriod(__m256 cx, __m256 cy)
+	{
+		const __m256 y2 = _mm256_mul_ps(cy, cy);
+		const __m256 x = _mm256_sub_ps(cx, _mm256_set1_ps(0.25f));
+		const __m256 q = _mm256_add_ps(_mm256_mul_ps(x, x), y2);
+		const __m256 cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, x)), _mm256_mul_ps(_mm256_set1_ps(0.25f), y2), _CMP_LE_OQ);
+		const __m256 x1 = _mm256_add_ps(cx, _mm256_set1_ps(1.0f));
+		const __m256 bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(x1, x1), y2), _mm256_set1_ps(0.0625f), _CMP_LE_OQ);
+		return _mm256_blendv_ps(_mm256_and_ps(bulb, _mm256_set1_ps(2.0f)), _mm256_set1_ps(1.0f), cardioid);
+	}
+	inline __m256d MainComponentPeriod(__m256d cx, __m256d cy)
+	{
+		const __m256d y2 = _mm256_mul_pd(cy, cy);
+		const __m256d x = _mm256_sub_pd(cx, _mm256_set1_pd(0.25));
+		const __m256d q = _mm256_add_pd(_mm256_mul_pd(x, x), y2);
+		const __m256d cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, x)), _mm256_mul_pd(_mm256_set1_pd(0.25), y2), _CMP_LE_OQ);
+		const __m256d x1 = _mm256_add_pd(cx, _mm256_set1_pd(1.0));
+		const __m256d bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(x1, x1), y2), _mm256_set1_pd(0.0625), _CMP_LE_OQ);
+		return _mm256_blendv_pd(_mm256_and_pd(bulb, _mm256_set1_pd(2.0)), _mm256_set1_pd(1.0), cardioid);
+	}
+
+	// The kernels below compute pixel i at (x + i, y), or at (xs[i], ys[i])
+	// when xs is set; a gathered call loads each batch's coordinates from
+	// the lists here. Lanes past `count` repeat its last
+	// pixel; they are retired before the first iteration anyway.
+	inline void GatherLanes(const u32 *xs, const u32 *ys, u32 count, u32 first, u32 lanes, int *laneX, int *laneY)
+	{
+		for (u32 lane = 0; lane < lanes; lane++)
+		{
+			const u32 index = first + lane < count ? first + lane : count - 1;
+			laneX[lane] = (int) xs[index];
+			laneY[lane] = (int) ys[index];
+		}
+	}
+
+	// Resumed calls (see EscapeResumeFn) load each batch's orbits lane by lane
+	// the same way: field f of lane l goes to fields[f * lanes + l], fields
+	// in EscapeState's order.
+	template<typename T>
+	void LoadStates(const EscapeState *states, u32 count, u32 first, u32 lanes, T *fields)
+	{
+		for (u32 lane = 0; lane < lanes; lane++)
+		{
+			const EscapeState &state = states[first + lane < count ? first + lane : count - 1];
+			const double values[] = { state.Zx, state.Zy, state.SavedX, state.SavedY, state.ZxLo, state.ZyLo, state.SavedXLo, state.SavedYLo };
+			for (u32 field = 0; field < 8; field++)
+				fields[field * lanes + lane] = (T) values[field];
+		}
+	}
+	template<typename T>
+	EscapeState LaneState(const T *fields, u32 lanes, u32 lane)
+	{
+		return EscapeState { (double) fields[lane], (double) fields[lanes + lane], (double) fields[2 * lanes + lane], (double) fields[3 * lanes + lane],
+			(double) fields[4 * lanes + lane], (double) fields[5 * lanes + lane], (double) fields[6 * lanes + lane], (double) fields[7 * lanes + lane] };
+	}
+
+	// The highest power of two up to `start`: where the cycle detection of an
+	// orbit resumed after `start` iterations last saved z.
+	inline int LastSave(u32 start)
+	{
+		int savedAt = 0;
+		for (u32 k = 1; k <= start; k *= 2)
+			savedAt = (int) k;
+		return savedAt;
+	}
+
+	// Two independent batches are iterated together: a single batch is bound
+	// by the latency of the mul -> sub -> add chain, and interleaving a
+	// second one fills those stall cycles for free. Three or four gained
+	// nothing measurable.
+	//
+	// Idle lanes (escaped, waiting for the rest of their batch) still cost a
+	// slot in every step; on the seahorse valley at zoom 2e4 only about half
+	// the lane-steps do useful work. Refilling single lanes as they escape
+	// gets occupancy to 97% but ran 2-6x slower, because every lane then
+	// needs its own save/compare schedule for cycle detection and the
+	// per-lane branches cost more than the idle slots. Refilling each batch
+	// on its own gained under 5% on 32-pixel tile rows, so it was dropped.
+	constexpr u32 BatchesInFlight = 2;
+
+	u32 Avx2Float(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const float zoom = (float) view.Zoom.ToDouble();
+		const float py = (((float) y + 0.5f) - (float) view.Height / 2.0f) / zoom - (float) view.Offset.y;
+
+		const __m256 half       = _mm256_set1_ps(0.5f);
+		const __m256 two        = _mm256_set1_ps(2.0f);
+		const __m256 one        = _mm256_set1_ps(1.0f);
+		const __m256 bailout    = _mm256_set1_ps(16.0f);
+		const __m256 halfWidth  = _mm256_set1_ps((float) view.Width / 2.0f);
+		const __m256 zoomV      = _mm256_set1_ps(zoom);
+		const __m256 offsetX    = _mm256_set1_ps((float) view.Offset.x);
+		const __m256 pyV        = _mm256_set1_ps(py);
+		const __m256 halfHeight = _mm256_set1_ps((float) view.Height / 2.0f);
+		const __m256 offsetY    = _mm256_set1_ps((float) view.Offset.y);
+		const __m256 juliaX     = _mm256_set1_ps((float) view.JuliaC.x);
+		const __m256 juliaY     = _mm256_set1_ps((float) view.JuliaC.y);
+		const __m256 maxIter    = _mm256_set1_ps((float) view.MaxIterations);
+		const __m256i laneIndex  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const float tolerance   = (float) PeriodTolerance / zoom;
+		const __m256 toleranceV = _mm256_set1_ps(tolerance);
+		const __m256 toleranceSq = _mm256_set1_ps(tolerance * tolerance);
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 8 * BatchesInFlight)
+		{
+			BatchPs batches[BatchesInFlight];
+			u32 interiorLanes = 0;
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				const u32 first = i + b * 8;
+				// Lanes past `count` start out retired.
+				const int remaining = (int) count - (int) first;
+				const __m256 valid = _mm256_cmp_ps(_mm256_cvtepi32_ps(laneIndex), _mm256_set1_ps((float) remaining), _CMP_LT_OQ);
+				__m256i pixelX = _mm256_add_epi32(_mm256_set1_epi32((int) (x + first)), laneIndex);
+				__m256 py = pyV;
+				if (xs)
+				{
+					alignas(32) int laneX[8], laneY[8];
+					GatherLanes(xs, ys, count, first, 8, laneX, laneY);
+					pixelX = _mm256_load_si256((__m256i *) laneX);
+					py = _mm256_sub_ps(
+						_mm256_div_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_load_si256((__m256i *) laneY)), half), halfHeight), zoomV),
+						offsetY);
+				}
+				const __m256 px = _mm256_sub_ps(
+					_mm256_div_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_cvtepi32_ps(pixelX), half), halfWidth), zoomV),
+					offsetX);
+
+				BatchPs &batch = batches[b];
+				batch.Zx = julia ? px  : _mm256_setzero_ps();
+				batch.Zy = julia ? py  : _mm256_setzero_ps();
+				batch.Cx = julia ? juliaX : px;
+				batch.Cy = julia ? juliaY : py;
+
+				batch.SavedX = batch.Zx;
+				batch.SavedY = batch.Zy;
+
+				// Interior lanes start out finished at the full count; resumed
+				// lanes are past that test.
+				batch.Period = julia || start > 0 ? _mm256_setzero_ps() : MainComponentPeriod(px, py);
+				const __m256 inside = _mm256_cmp_ps(batch.Period, _mm256_setzero_ps(), _CMP_GT_OQ);
+				batch.N = _mm256_and_ps(inside, maxIter);
+				batch.Active = _mm256_andnot_ps(inside, valid);
+				interiorLanes |= (u32) _mm256_movemask_ps(inside) << (b * 8);
+				// Resumed lanes carry on from where they ran out.
+				if (start > 0)
+				{
+					alignas(32) float fields[8 * 8];
+					LoadStates(states, count, first, 8, fields);
+					batch.Zx = _mm256_load_ps(fields);
+					batch.Zy = _mm256_load_ps(fields + 8);
+					batch.SavedX = _mm256_load_ps(fields + 2 * 8);
+					batch.SavedY = _mm256_load_ps(fields + 3 * 8);
+					batch.N = _mm256_set1_ps((float) start);
+				}
+				batch.Square();
+			}
+
+			// z is saved after iterations 1, 2, 4, 8, ... (the same for
+			// every lane), so the period is the distance back to savedAt
+			// and the check schedule is shared by the whole batch.
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batches[0].Step(two, one, bailout);
+				batches[1].Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+				{
+					batches[0].DetectCycle(toleranceV, toleranceSq, maxIter, k - savedAt);
+					batches[1].DetectCycle(toleranceV, toleranceSq, maxIter, k - savedAt);
+				}
+				if ((k & (k - 1)) == 0)
+				{
+					batches[0].Save();
+					batches[1].Save();
+					savedAt = k;
+				}
+
+				if (_mm256_movemask_ps(_mm256_or_ps(batches[0].Active, batches[1].Active)) == 0)
+					break;
+			}
+
+			alignas(32) float result[8 * BatchesInFlight];
+			alignas(32) float period[8 * BatchesInFlight];
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				_mm256_store_ps(result + b * 8, _mm256_div_ps(batches[b].N, maxIter));
+				_mm256_store_ps(period + b * 8, batches[b].Period);
+			}
+
+			const u32 lanes = count - i < 8 * BatchesInFlight ? count - i : 8 * BatchesInFlight;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = result[lane];
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(32) float fields[8 * 8 * BatchesInFlight] = {};
+				for (u32 b = 0; b < BatchesInFlight; b++)
+				{
+					_mm256_store_ps(fields + b * 8, batches[b].Zx);
+					_mm256_store_ps(fields + 8 * BatchesInFlight + b * 8, batches[b].Zy);
+					_mm256_store_ps(fields + 2 * 8 * BatchesInFlight + b * 8, batches[b].SavedX);
+					_mm256_store_ps(fields + 3 * 8 * BatchesInFlight + b * 8, batches[b].SavedY);
+				}
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= 1.0f && period[lane] == 0.0f)
+						states[i + lane] = LaneState(fields, 8 * BatchesInFlight, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	u32 Avx2Double(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const double py = (((double) y + 0.5) - (double) view.Height / 2.0) / view.Zoom.ToDouble() - view.Offset.y;
+
+		const __m256d half       = _mm256_set1_pd(0.5);
+		const __m256d two        = _mm256_set1_pd(2.0);
+		const __m256d one        = _mm256_set1_pd(1.0);
+		const __m256d bailout    = _mm256_set1_pd(16.0);
+		const __m256d halfWidth  = _mm256_set1_pd((double) view.Width / 2.0);
+		const __m256d zoomV      = _mm256_set1_pd(view.Zoom.ToDouble());
+		const __m256d offsetX    = _mm256_set1_pd(view.Offset.x);
+		const __m256d pyV        = _mm256_set1_pd(py);
+		const __m256d halfHeight = _mm256_set1_pd((double) view.Height / 2.0);
+		const __m256d offsetY    = _mm256_set1_pd(view.Offset.y);
+		const __m256d juliaX     = _mm256_set1_pd(view.JuliaC.x);
+		const __m256d juliaY     = _mm256_set1_pd(view.JuliaC.y);
+		const __m128i laneIndex  = _mm_setr_epi32(0, 1, 2, 3);
+		const __m256d maxIterV   = _mm256_set1_pd((double) view.MaxIterations);
+		const double tolerance   = PeriodTolerance / view.Zoom.ToDouble();
+		const __m256d toleranceV = _mm256_set1_pd(tolerance);
+		const __m256d toleranceSq = _mm256_set1_pd(tolerance * tolerance);
+		const float maxIter = (float) view.MaxIterations;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 4 * BatchesInFlight)
+		{
+			BatchPd batches[BatchesInFlight];
+			u32 interiorLanes = 0;
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				const u32 first = i + b * 4;
+				// Lanes past `count` start out retired.
+				const int remaining = (int) count - (int) first;
+				const __m256d valid = _mm256_cmp_pd(_mm256_cvtepi32_pd(laneIndex), _mm256_set1_pd((double) remaining), _CMP_LT_OQ);
+				__m128i pixelX = _mm_add_epi32(_mm_set1_epi32((int) (x + first)), laneIndex);
+				__m256d py = pyV;
+				if (xs)
+				{
+					alignas(16) int laneX[4], laneY[4];
+					GatherLanes(xs, ys, count, first, 4, laneX, laneY);
+					pixelX = _mm_load_si128((__m128i *) laneX);
+					py = _mm256_sub_pd(
+						_mm256_div_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm_load_si128((__m128i *) laneY)), half), halfHeight), zoomV),
+						offsetY);
+				}
+				const __m256d px = _mm256_sub_pd(
+					_mm256_div_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_cvtepi32_pd(pixelX), half), halfWidth), zoomV),
+					offsetX);
+
+				BatchPd &batch = batches[b];
+				batch.Zx = julia ? px  : _mm256_setzero_pd();
+				batch.Zy = julia ? py  : _mm256_setzero_pd();
+				batch.Cx = julia ? juliaX : px;
+				batch.Cy = julia ? juliaY : py;
+
+				batch.SavedX = batch.Zx;
+				batch.SavedY = batch.Zy;
+
+				batch.Period = julia || start > 0 ? _mm256_setzero_pd() : MainComponentPeriod(px, py);
+				const __m256d inside = _mm256_cmp_pd(batch.Period, _mm256_setzero_pd(), _CMP_GT_OQ);
+				batch.N = _mm256_and_pd(inside, maxIterV);
+				batch.Active = _mm256_andnot_pd(inside, valid);
+				interiorLanes |= (u32) _mm256_movemask_pd(inside) << (b * 4);
+				// Resumed lanes carry on from where they ran out.
+				if (start > 0)
+				{
+					alignas(32) double fields[8 * 4];
+					LoadStates(states, count, first, 4, fields);
+					batch.Zx = _mm256_load_pd(fields);
+					batch.Zy = _mm256_load_pd(fields + 4);
+					batch.SavedX = _mm256_load_pd(fields + 2 * 4);
+					batch.SavedY = _mm256_load_pd(fields + 3 * 4);
+					batch.N = _mm256_set1_pd((double) start);
+				}
+				batch.Square();
+			}
+
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batches[0].Step(two, one, bailout);
+				batches[1].Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+				{
+					batches[0].DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+					batches[1].DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+				}
+				if ((k & (k - 1)) == 0)
+				{
+					batches[0].Save();
+					batches[1].Save();
+					savedAt = k;
+				}
+
+				if (_mm256_movemask_pd(_mm256_or_pd(batches[0].Active, batches[1].Active)) == 0)
+					break;
+			}
+
+			alignas(32) double result[4 * BatchesInFlight];
+			alignas(32) double period[4 * BatchesInFlight];
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				_mm256_store_pd(result + b * 4, batches[b].N);
+				_mm256_store_pd(period + b * 4, batches[b].Period);
+			}
+
+			const u32 lanes = count - i < 4 * BatchesInFlight ? count - i : 4 * BatchesInFlight;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = (float) result[lane] / maxIter;
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(32) double fields[8 * 4 * BatchesInFlight] = {};
+				for (u32 b = 0; b < BatchesInFlight; b++)
+				{
+					_mm256_store_pd(fields + b * 4, batches[b].Zx);
+					_mm256_store_pd(fields + 4 * BatchesInFlight + b * 4, batches[b].Zy);
+					_mm256_store_pd(fields + 2 * 4 * BatchesInFlight + b * 4, batches[b].SavedX);
+					_mm256_store_pd(fields + 3 * 4 * BatchesInFlight + b * 4, batches[b].SavedY);
+				}
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= (double) view.MaxIterations && period[lane] == 0.0)
+						states[i + lane] = LaneState(fields, 4 * BatchesInFlight, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	// Double-double lanes: exactly the operation sequence of the scalar
+	// kernel's Dd, so results match it bit for bit.
+	struct DdPd
+	{
+		__m256d Hi, Lo;
+	};
+
+	inline DdPd TwoSum(__m256d a, __m256d b)
+	{
+		const __m256d s = _mm256_add_pd(a, b);
+		const __m256d v = _mm256_sub_pd(s, a);
+		return DdPd { s, _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(s, v)), _mm256_sub_pd(b, v)) };
+	}
+	inline DdPd QuickTwoSum(__m256d a, __m256d b)
+	{
+		const __m256d s = _mm256_add_pd(a, b);
+		return DdPd { s, _mm256_sub_pd(b, _mm256_sub_pd(s, a)) };
+	}
+	inline void Split(__m256d a, __m256d &hi, __m256d &lo)
+	{
+		const __m256d t = _mm256_mul_pd(_mm256_set1_pd(134217729.0), a);
+		hi = _mm256_sub_pd(t, _mm256_sub_pd(t, a));
+		lo = _mm256_sub_pd(a, hi);
+	}
+	inline DdPd TwoProduct(__m256d a, __m256d b)
+	{
+		__m256d aHi, aLo, bHi, bLo;
+		Split(a, aHi, aLo);
+		Split(b, bHi, bLo);
+		const __m256d p = _mm256_mul_pd(a, b);
+		__m256d e = _mm256_sub_pd(_mm256_mul_pd(aHi, bHi), p);
+		e = _mm256_add_pd(e, _mm256_mul_pd(aHi, bLo));
+		e = _mm256_add_pd(e, _mm256_mul_pd(aLo, bHi));
+		e = _mm256_add_pd(e, _mm256_mul_pd(aLo, bLo));
+		return DdPd { p, e };
+	}
+	inline DdPd Add(DdPd a, DdPd b)
+	{
+		const DdPd s = TwoSum(a.Hi, b.Hi);
+		return QuickTwoSum(s.Hi, _mm256_add_pd(s.Lo, _mm256_add_pd(a.Lo, b.Lo)));
+	}
+	inline DdPd Negate(DdPd a)
+	{
+		return DdPd { _mm256_xor_pd(a.Hi, _mm256_set1_pd(-0.0)), _mm256_xor_pd(a.Lo, _mm256_set1_pd(-0.0)) };
+	}
+	inline DdPd Mul(DdPd a, DdPd b)
+	{
+		const DdPd p = TwoProduct(a.Hi, b.Hi);
+		return QuickTwoSum(p.Hi, _mm256_add_pd(p.Lo, _mm256_add_pd(_mm256_mul_pd(a.Hi, b.Lo), _mm256_mul_pd(a.Lo, b.Hi))));
+	}
+
+	struct BatchDd
+	{
+		DdPd Zx, Zy, Cx, Cy;
+		__m256d N, Active;
+		DdPd SavedX, SavedY;
+		__m256d Period;
+
+		void Step(__m256d two, __m256d one, __m256d bailout)
+		{
+			const DdPd newX = Add(Add(Mul(Zx, Zx), Negate(Mul(Zy, Zy))), Cx);
+			const DdPd newY = Add(Mul(DdPd { _mm256_mul_pd(two, Zx.Hi), _mm256_mul_pd(two, Zx.Lo) }, Zy), Cy);
+			Zx.Hi = _mm256_blendv_pd(Zx.Hi, newX.Hi, Active);
+			Zx.Lo = _mm256_blendv_pd(Zx.Lo, newX.Lo, Active);
+			Zy.Hi = _mm256_blendv_pd(Zy.Hi, newY.Hi, Active);
+			Zy.Lo = _mm256_blendv_pd(Zy.Lo, newY.Lo, Active);
+
+			const __m256d magnitude = _mm256_add_pd(_mm256_mul_pd(Zx.Hi, Zx.Hi), _mm256_mul_pd(Zy.Hi, Zy.Hi));
+			Active = _mm256_andnot_pd(_mm256_cmp_pd(magnitude, bailout, _CMP_GT_OQ), Active);
+			N = _mm256_add_pd(N, _mm256_and_pd(Active, one));
+		}
+
+		void DetectCycle(__m256d tolerance, __m256d toleranceSq, __m256d maxIter, int period)
+		{
+			const __m256d dx = _mm256_add_pd(_mm256_sub_pd(Zx.Hi, SavedX.Hi), _mm256_sub_pd(Zx.Lo, SavedX.Lo));
+			const __m256d near = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), dx), tolerance, _CMP_LT_OQ);
+			if (_mm256_movemask_pd(_mm256_and_pd(near, Active)) == 0)
+				return;
+
+			const __m256d dy = _mm256_add_pd(_mm256_sub_pd(Zy.Hi, SavedY.Hi), _mm256_sub_pd(Zy.Lo, SavedY.Lo));
+			const __m256d distance = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+			const __m256d cycle = _mm256_and_pd(_mm256_cmp_pd(distance, toleranceSq, _CMP_LT_OQ), Active);
+			N = _mm256_blendv_pd(N, maxIter, cycle);
+			Period = _mm256_blendv_pd(Period, _mm256_set1_pd((double) period), cycle);
+			Active = _mm256_andnot_pd(cycle, Active);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+
+	// The double-double state is four times the size of a double batch, so
+	// one batch is enough to keep the ports busy.
+	u32 Avx2DoubleDouble(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const double dy = (((double) y + 0.5) - (double) view.Height / 2.0) / view.Zoom.ToDouble();
+
+		const __m256d zero       = _mm256_setzero_pd();
+		const __m256d half       = _mm256_set1_pd(0.5);
+		const __m256d two        = _mm256_set1_pd(2.0);
+		const __m256d one        = _mm256_set1_pd(1.0);
+		const __m256d bailout    = _mm256_set1_pd(16.0);
+		const __m256d halfWidth  = _mm256_set1_pd((double) view.Width / 2.0);
+		const __m256d halfHeight = _mm256_set1_pd((double) view.Height / 2.0);
+		const __m256d zoomV      = _mm256_set1_pd(view.Zoom.ToDouble());
+		const DdPd offsetX       = { _mm256_set1_pd(-view.Offset.x), _mm256_set1_pd(-view.OffsetLo.x) };
+		const DdPd offsetY       = { _mm256_set1_pd(-view.Offset.y), _mm256_set1_pd(-view.OffsetLo.y) };
+		const DdPd rowY          = Add(DdPd { _mm256_set1_pd(dy), zero }, offsetY);
+		const DdPd juliaX        = { _mm256_set1_pd(view.JuliaC.x), zero };
+		const DdPd juliaY        = { _mm256_set1_pd(view.JuliaC.y), zero };
+		const __m128i laneIndex  = _mm_setr_epi32(0, 1, 2, 3);
+		const __m256d maxIterV   = _mm256_set1_pd((double) view.MaxIterations);
+		const double tolerance   = PeriodTolerance / view.Zoom.ToDouble();
+		const __m256d toleranceV = _mm256_set1_pd(tolerance);
+		const __m256d toleranceSq = _mm256_set1_pd(tolerance * tolerance);
+		const float maxIter = (float) view.MaxIterations;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 4)
+		{
+			const u32 first = i;
+			// Lanes past `count` start out retired.
+			const int remaining = (int) count - (int) first;
+			const __m256d valid = _mm256_cmp_pd(_mm256_cvtepi32_pd(laneIndex), _mm256_set1_pd((double) remaining), _CMP_LT_OQ);
+			__m128i pixelX = _mm_add_epi32(_mm_set1_epi32((int) (x + first)), laneIndex);
+			DdPd py = rowY;
+			if (xs)
+			{
+				alignas(16) int laneX[4], laneY[4];
+				GatherLanes(xs, ys, count, first, 4, laneX, laneY);
+				pixelX = _mm_load_si128((__m128i *) laneX);
+				const __m256d dy = _mm256_div_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm_load_si128((__m128i *) laneY)), half), halfHeight), zoomV);
+				py = Add(DdPd { dy, zero }, offsetY);
+			}
+			const __m256d dx = _mm256_div_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_cvtepi32_pd(pixelX), half), halfWidth), zoomV);
+			const DdPd px = Add(DdPd { dx, zero }, offsetX);
+
+			BatchDd batch;
+			batch.Zx = julia ? px : DdPd { zero, zero };
+			batch.Zy = julia ? py : DdPd { zero, zero };
+			batch.Cx = julia ? juliaX : px;
+			batch.Cy = julia ? juliaY : py;
+
+			batch.SavedX = batch.Zx;
+			batch.SavedY = batch.Zy;
+
+			// Tested on Hi alone, like the scalar kernel.
+			batch.Period = julia || start > 0 ? zero : MainComponentPeriod(px.Hi, py.Hi);
+			const __m256d inside = _mm256_cmp_pd(batch.Period, zero, _CMP_GT_OQ);
+			batch.N = _mm256_and_pd(inside, maxIterV);
+			batch.Active = _mm256_andnot_pd(inside, valid);
+			const u32 interiorLanes = (u32) _mm256_movemask_pd(inside);
+			if (start > 0)
+			{
+				alignas(32) double fields[8 * 4];
+				LoadStates(states, count, first, 4, fields);
+				batch.Zx = DdPd { _mm256_load_pd(fields), _mm256_load_pd(fields + 4 * 4) };
+				batch.Zy = DdPd { _mm256_load_pd(fields + 4), _mm256_load_pd(fields + 5 * 4) };
+				batch.SavedX = DdPd { _mm256_load_pd(fields + 2 * 4), _mm256_load_pd(fields + 6 * 4) };
+				batch.SavedY = DdPd { _mm256_load_pd(fields + 3 * 4), _mm256_load_pd(fields + 7 * 4) };
+				batch.N = _mm256_set1_pd((double) start);
+			}
+
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batch.Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+					batch.DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+				if ((k & (k - 1)) == 0)
+				{
+					batch.Save();
+					savedAt = k;
+				}
+
+				if (_mm256_movemask_pd(batch.Active) == 0)
+					break;
+			}
+
+			alignas(32) double result[4];
+			alignas(32) double period[4];
+			_mm256_store_pd(result, batch.N);
+			_mm256_store_pd(period, batch.Period);
+
+			const u32 lanes = count - i < 4 ? count - i : 4;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = (float) result[lane] / maxIter;
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(32) double fields[8 * 4];
+				_mm256_store_pd(fields, batch.Zx.Hi);
+				_mm256_store_pd(fields + 4, batch.Zy.Hi);
+				_mm256_store_pd(fields + 2 * 4, batch.SavedX.Hi);
+				_mm256_store_pd(fields + 3 * 4, batch.SavedY.Hi);
+				_mm256_store_pd(fields + 4 * 4, batch.Zx.Lo);
+				_mm256_store_pd(fields + 5 * 4, batch.Zy.Lo);
+				_mm256_store_pd(fields + 6 * 4, batch.SavedX.Lo);
+				_mm256_store_pd(fields + 7 * 4, batch.SavedY.Lo);
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= (double) view.MaxIterations && period[lane] == 0.0)
+						states[i + lane] = LaneState(fields, 4, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	u32 Avx2KernelFloat(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Avx2Float(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Avx2GatherFloat(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Avx2Float(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Avx2KernelDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Avx2Double(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Avx2GatherDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Avx2Double(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Avx2KernelDoubleDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Avx2DoubleDouble(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Avx2GatherDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Avx2DoubleDouble(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Avx2ResumeFloat(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Avx2Float(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 Avx2ResumeDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Avx2Double(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 Avx2ResumeDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Avx2DoubleDouble(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+}
+
+namespace EscapeKernels
+{
+	const EscapeKernel *Avx2()
+	{
+		static const EscapeKernel kernel = { "AVX2",
+			&Avx2KernelFloat, &Avx2KernelDouble, &Avx2KernelDoubleDouble,
+			&Avx2GatherFloat, &Avx2GatherDouble, &Avx2GatherDoubleDouble,
+			&Avx2ResumeFloat, &Avx2ResumeDouble, &Avx2ResumeDoubleDouble };
+		return &kernel;
+	}
+}
+
+#else
+
+namespace EscapeKernels
+{
+	const EscapeKernel *Avx2()
+	{
+		return nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,776 @@
+#include "EscapeKernels.h"
+
+// Built with -mavx512f (/arch:AVX512) on x86-64 only, see CMakeLists.txt.
+// Nothing in here may run before the host has been checked for AVX-512F.
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+
+namespace
+{
+	// 16 floats / 8 doubles per batch. As in the AVX2 kernel, escaped lanes
+	// keep iterating and only stop counting.
+	struct BatchPs
+	{
+		__m512 Zx, Zy, Cx, Cy, N;
+		__m512 SavedX, SavedY, Period;
+		__mmask16 Active;
+		__m512 Zx2, Zy2;   // Zx², Zy², shared by the escape test and the next Step
+
+		void Square()
+		{
+			Zx2 = _mm512_mul_ps(Zx, Zx);
+			Zy2 = _mm512_mul_ps(Zy, Zy);
+		}
+
+		void Step(__m512 two, __m512 one, __m512 bailout)
+		{
+			const __m512 newX = _mm512_add_ps(_mm512_sub_ps(Zx2, Zy2), Cx);
+			const __m512 newY = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(two, Zx), Zy), Cy);
+			Zx = newX;
+			Zy = newY;
+
+			Square();
+			const __m512 magnitude = _mm512_add_ps(Zx2, Zy2);
+			Active = _mm512_mask_cmp_ps_mask(Active, magnitude, bailout, _CMP_NGT_UQ);
+			N = _mm512_mask_add_ps(N, Active, N, one);
+		}
+
+		// Brent cycle detection, after Step: lanes back within `tolerance` of
+		// the saved z (squared distance below `toleranceSq`) are interior
+		// with the given period. |dx| < tolerance is implied by the full
+		// test, so lanes failing it are ruled out at half the cost; escaping
+		// orbits almost never pass it.
+		void DetectCycle(__m512 tolerance, __m512 toleranceSq, __m512 maxIter, int period)
+		{
+			const __m512 dx = _mm512_sub_ps(Zx, SavedX);
+			if (_mm512_mask_cmp_ps_mask(Active, _mm512_abs_ps(dx), tolerance, _CMP_LT_OQ) == 0)
+				return;
+
+			const __m512 dy = _mm512_sub_ps(Zy, SavedY);
+			const __m512 distance = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+			const __mmask16 cycle = _mm512_mask_cmp_ps_mask(Active, distance, toleranceSq, _CMP_LT_OQ);
+			N = _mm512_mask_mov_ps(N, cycle, maxIter);
+			Period = _mm512_mask_mov_ps(Period, cycle, _mm512_set1_ps((float) period));
+			Active = (__mmask16) (Active & ~cycle);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+	struct BatchPd
+	{
+		__m512d Zx, Zy, Cx, Cy, N;
+		__m512d SavedX, SavedY, Period;
+		__mmask8 Active;
+		__m512d Zx2, Zy2;   // Zx², Zy², shared by the escape test and the next Step
+
+		void Square()
+		{
+			Zx2 = _mm512_mul_pd(Zx, Zx);
+			Zy2 = _mm512_mul_pd(Zy, Zy);
+		}
+
+		void Step(__m512d two, __m512d one, __m512d bailout)
+		{
+			const __m512d newX = _mm512_add_pd(_mm512_sub_pd(Zx2, Zy2), Cx);
+			const __m512d newY = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, Zx), Zy), Cy);
+			Zx = newX;
+			Zy = newY;
+
+			Square();
+			const __m512d magnitude = _mm512_add_pd(Zx2, Zy2);
+			Active = _mm512_mask_cmp_pd_mask(Active, magnitude, bailout, _CMP_NGT_UQ);
+			N = _mm512_mask_add_pd(N, Active, N, one);
+		}
+
+		void DetectCycle(__m512d tolerance, __m512d toleranceSq, __m512d maxIter, int period)
+		{
+			const __m512d dx = _mm512_sub_pd(Zx, SavedX);
+			if (_mm512_mask_cmp_pd_mask(Active, _mm512_abs_pd(dx), tolerance, _CMP_LT_OQ) == 0)
+				return;
+
+			const __m512d dy = _mm512_sub_pd(Zy, SavedY);
+			const __m512d distance = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+			const __mmask8 cycle = _mm512_mask_cmp_pd_mask(Active, distance, toleranceSq, _CMP_LT_OQ);
+			N = _mm512_mask_mov_pd(N, cycle, maxIter);
+			Period = _mm512_mask_mov_pd(Period, cycle, _mm512_set1_pd((double) period));
+			Active = (__mmask8) (Active & ~cycle);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+
+	// MainComponentPeriod() from Fractal.h, lane by lane: 1 in the main
+	// cardioid, 2 in the period-2 bulb, 0 elsewhere.
+	inline __m512 MainComponentPeriod(__m512 cx, __m512 cy)
+	{
+		const __m512 y2 = _mm512_mul_ps(cy, cy);
+		const __m512 x = _mm512_sub_ps(cx, _mm512_set1_ps(0.25f));
+		const __m512 q = _mm512_add_ps(_mm512_mul_ps(x, x), y2);
+		const __mmask16 cardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, x)), _mm512_mul_ps(_mm512_set1_ps(0.25f), y2), _CMP_LE_OQ);
+		const __m512 x1 = _mm512_add_ps(cx, _mm512_set1_ps(1.0f));
+		const __mmask16 bulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(x1, x1), y2), _mm512_set1_ps(0.0625f), _CMP_LE_OQ);
+		return _mm512_mask_mov_ps(_mm512_maskz_mov_ps(bulb, _mm512_set1_ps(2.0f)), cardioid, _mm512_set1_ps(1.0f));
+	}
+	inline __m512d MainComponentPeriod(__m512d cx, __m512d cy)
+	{
+		const __m512d y2 = _mm512_mul_pd(cy, cy);
+		const __m512d x = _mm512_sub_pd(cx, _mm512_set1_pd(0.25));
+		const __m512d q = _mm512_add_pd(_mm512_mul_pd(x, x), y2);
+		const __mmask8 cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, x)), _mm512_mul_pd(_mm512_set1_pd(0.25), y2), _CMP_LE_OQ);
+		const __m512d x1 = _mm512_add_pd(cx, _mm512_set1_pd(1.0));
+		const __mmask8 bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x1, x1), y2), _mm512_set1_pd(0.0625), _CMP_LE_OQ);
+		return _mm512_mask_mov_pd(_mm512_maskz_mov_pd(bulb, _mm512_set1_pd(2.0)), cardioid, _mm512_set1_pd(1.0));
+	}
+
+	// The kernels below compute pixel i at (x + i, y), or at (xs[i], ys[i])
+	// when xs is set; a gathered call loads each batch's coordinates from
+	// the lists here. Lanes past `count` repeat its last
+	// pixel; they are retired before the first iteration anyway.
+	inline void GatherLanes(const u32 *xs, const u32 *ys, u32 count, u32 first, u32 lanes, int *laneX, int *laneY)
+	{
+		for (u32 lane = 0; lane < lanes; lane++)
+		{
+			const u32 index = first + lane < count ? first + lane : count - 1;
+			laneX[lane] = (int) xs[index];
+			laneY[lane] = (int) ys[index];
+		}
+	}
+
+	// Resumed calls (see EscapeResumeFn) load each batch's orbits lane by lane
+	// the same way: field f of lane l goes to fields[f * lanes + l], fields
+	// in EscapeState's order.
+	template<typename T>
+	void LoadStates(const EscapeState *states, u32 count, u32 first, u32 lanes, T *fields)
+	{
+		for (u32 lane = 0; lane < lanes; lane++)
+		{
+			const EscapeState &state = states[first + lane < count ? first + lane : count - 1];
+			const double values[] = { state.Zx, state.Zy, state.SavedX, state.SavedY, state.ZxLo, state.ZyLo, state.SavedXLo, state.SavedYLo };
+			for (u32 field = 0; field < 8; field++)
+				fields[field * lanes + lane] = (T) values[field];
+		}
+	}
+	template<typename T>
+	EscapeState LaneState(const T *fields, u32 lanes, u32 lane)
+	{
+		return EscapeState { (double) fields[lane], (double) fields[lanes + lane], (double) fields[2 * lanes + lane], (double) fields[3 * lanes + lane],
+			(double) fields[4 * lanes + lane], (double) fields[5 * lanes + lane], (double) fields[6 * lanes + lane], (double) fields[7 * lanes + lane] };
+	}
+
+	// The highest power of two up to `start`: where the cycle detection of an
+	// orbit resumed after `start` iterations last saved z.
+	inline int LastSave(u32 start)
+	{
+		int savedAt = 0;
+		for (u32 k = 1; k <= start; k *= 2)
+			savedAt = (int) k;
+		return savedAt;
+	}
+
+	constexpr u32 BatchesInFlight = 2;
+
+	u32 Avx512Float(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const float zoom = (float) view.Zoom.ToDouble();
+		const float py = (((float) y + 0.5f) - (float) view.Height / 2.0f) / zoom - (float) view.Offset.y;
+
+		const __m512 half       = _mm512_set1_ps(0.5f);
+		const __m512 two        = _mm512_set1_ps(2.0f);
+		const __m512 one        = _mm512_set1_ps(1.0f);
+		const __m512 bailout    = _mm512_set1_ps(16.0f);
+		const __m512 halfWidth  = _mm512_set1_ps((float) view.Width / 2.0f);
+		const __m512 zoomV      = _mm512_set1_ps(zoom);
+		const __m512 offsetX    = _mm512_set1_ps((float) view.Offset.x);
+		const __m512 pyV        = _mm512_set1_ps(py);
+		const __m512 halfHeight = _mm512_set1_ps((float) view.Height / 2.0f);
+		const __m512 offsetY    = _mm512_set1_ps((float) view.Offset.y);
+		const __m512 juliaX     = _mm512_set1_ps((float) view.JuliaC.x);
+		const __m512 juliaY     = _mm512_set1_ps((float) view.JuliaC.y);
+		const __m512 maxIter    = _mm512_set1_ps((float) view.MaxIterations);
+		const __m512i laneIndex = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		const float tolerance   = (float) PeriodTolerance / zoom;
+		const __m512 toleranceV = _mm512_set1_ps(tolerance);
+		const __m512 toleranceSq = _mm512_set1_ps(tolerance * tolerance);
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 16 * BatchesInFlight)
+		{
+			BatchPs batches[BatchesInFlight];
+			u32 interiorLanes = 0;
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				const u32 first = i + b * 16;
+				// Lanes past `count` start out retired.
+				const int remaining = (int) count - (int) first;
+				const __mmask16 valid = _mm512_cmp_ps_mask(_mm512_cvtepi32_ps(laneIndex), _mm512_set1_ps((float) remaining), _CMP_LT_OQ);
+				__m512i pixelX = _mm512_add_epi32(_mm512_set1_epi32((int) (x + first)), laneIndex);
+				__m512 py = pyV;
+				if (xs)
+				{
+					alignas(64) int laneX[16], laneY[16];
+					GatherLanes(xs, ys, count, first, 16, laneX, laneY);
+					pixelX = _mm512_load_si512((__m512i *) laneX);
+					py = _mm512_sub_ps(
+						_mm512_div_ps(_mm512_sub_ps(_mm512_add_ps(_mm512_cvtepi32_ps(_mm512_load_si512((__m512i *) laneY)), half), halfHeight), zoomV),
+						offsetY);
+				}
+				const __m512 px = _mm512_sub_ps(
+					_mm512_div_ps(_mm512_sub_ps(_mm512_add_ps(_mm512_cvtepi32_ps(pixelX), half), halfWidth), zoomV),
+					offsetX);
+
+				BatchPs &batch = batches[b];
+				batch.Zx = julia ? px  : _mm512_setzero_ps();
+				batch.Zy = julia ? py  : _mm512_setzero_ps();
+				batch.Cx = julia ? juliaX : px;
+				batch.Cy = julia ? juliaY : py;
+
+				batch.SavedX = batch.Zx;
+				batch.SavedY = batch.Zy;
+
+				// Interior lanes start out finished at the full count; resumed
+				// lanes are past that test.
+				batch.Period = julia || start > 0 ? _mm512_setzero_ps() : MainComponentPeriod(px, py);
+				const __mmask16 inside = _mm512_cmp_ps_mask(batch.Period, _mm512_setzero_ps(), _CMP_GT_OQ);
+				batch.N = _mm512_maskz_mov_ps(inside, maxIter);
+				batch.Active = (__mmask16) (valid & ~inside);
+				interiorLanes |= (u32) inside << (b * 16);
+				// Resumed lanes carry on from where they ran out.
+				if (start > 0)
+				{
+					alignas(64) float fields[8 * 16];
+					LoadStates(states, count, first, 16, fields);
+					batch.Zx = _mm512_load_ps(fields);
+					batch.Zy = _mm512_load_ps(fields + 16);
+					batch.SavedX = _mm512_load_ps(fields + 2 * 16);
+					batch.SavedY = _mm512_load_ps(fields + 3 * 16);
+					batch.N = _mm512_set1_ps((float) start);
+				}
+				batch.Square();
+			}
+
+			// z is saved after iterations 1, 2, 4, 8, ... (the same for
+			// every lane), so the period is the distance back to savedAt
+			// and the check schedule is shared by the whole batch.
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batches[0].Step(two, one, bailout);
+				batches[1].Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+				{
+					batches[0].DetectCycle(toleranceV, toleranceSq, maxIter, k - savedAt);
+					batches[1].DetectCycle(toleranceV, toleranceSq, maxIter, k - savedAt);
+				}
+				if ((k & (k - 1)) == 0)
+				{
+					batches[0].Save();
+					batches[1].Save();
+					savedAt = k;
+				}
+
+				if ((batches[0].Active | batches[1].Active) == 0)
+					break;
+			}
+
+			alignas(64) float result[16 * BatchesInFlight];
+			alignas(64) float period[16 * BatchesInFlight];
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				_mm512_store_ps(result + b * 16, _mm512_div_ps(batches[b].N, maxIter));
+				_mm512_store_ps(period + b * 16, batches[b].Period);
+			}
+
+			const u32 lanes = count - i < 16 * BatchesInFlight ? count - i : 16 * BatchesInFlight;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = result[lane];
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(64) float fields[8 * 16 * BatchesInFlight] = {};
+				for (u32 b = 0; b < BatchesInFlight; b++)
+				{
+					_mm512_store_ps(fields + b * 16, batches[b].Zx);
+					_mm512_store_ps(fields + 16 * BatchesInFlight + b * 16, batches[b].Zy);
+					_mm512_store_ps(fields + 2 * 16 * BatchesInFlight + b * 16, batches[b].SavedX);
+					_mm512_store_ps(fields + 3 * 16 * BatchesInFlight + b * 16, batches[b].SavedY);
+				}
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= 1.0f && period[lane] == 0.0f)
+						states[i + lane] = LaneState(fields, 16 * BatchesInFlight, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	u32 Avx512Double(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const double py = (((double) y + 0.5) - (double) view.Height / 2.0) / view.Zoom.ToDouble() - view.Offset.y;
+
+		const __m512d half       = _mm512_set1_pd(0.5);
+		const __m512d two        = _mm512_set1_pd(2.0);
+		const __m512d one        = _mm512_set1_pd(1.0);
+		const __m512d bailout    = _mm512_set1_pd(16.0);
+		const __m512d halfWidth  = _mm512_set1_pd((double) view.Width / 2.0);
+		const __m512d zoomV      = _mm512_set1_pd(view.Zoom.ToDouble());
+		const __m512d offsetX    = _mm512_set1_pd(view.Offset.x);
+		const __m512d pyV        = _mm512_set1_pd(py);
+		const __m512d halfHeight = _mm512_set1_pd((double) view.Height / 2.0);
+		const __m512d offsetY    = _mm512_set1_pd(view.Offset.y);
+		const __m512d juliaX     = _mm512_set1_pd(view.JuliaC.x);
+		const __m512d juliaY     = _mm512_set1_pd(view.JuliaC.y);
+		const __m256i laneIndex  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m512d maxIterV   = _mm512_set1_pd((double) view.MaxIterations);
+		const double tolerance   = PeriodTolerance / view.Zoom.ToDouble();
+		const __m512d toleranceV = _mm512_set1_pd(tolerance);
+		const __m512d toleranceSq = _mm512_set1_pd(tolerance * tolerance);
+		const float maxIter = (float) view.MaxIterations;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 8 * BatchesInFlight)
+		{
+			BatchPd batches[BatchesInFlight];
+			u32 interiorLanes = 0;
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				const u32 first = i + b * 8;
+				// Lanes past `count` start out retired.
+				const int remaining = (int) count - (int) first;
+				const __mmask8 valid = _mm512_cmp_pd_mask(_mm512_cvtepi32_pd(laneIndex), _mm512_set1_pd((double) remaining), _CMP_LT_OQ);
+				__m256i pixelX = _mm256_add_epi32(_mm256_set1_epi32((int) (x + first)), laneIndex);
+				__m512d py = pyV;
+				if (xs)
+				{
+					alignas(32) int laneX[8], laneY[8];
+					GatherLanes(xs, ys, count, first, 8, laneX, laneY);
+					pixelX = _mm256_load_si256((__m256i *) laneX);
+					py = _mm512_sub_pd(
+						_mm512_div_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_cvtepi32_pd(_mm256_load_si256((__m256i *) laneY)), half), halfHeight), zoomV),
+						offsetY);
+				}
+				const __m512d px = _mm512_sub_pd(
+					_mm512_div_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_cvtepi32_pd(pixelX), half), halfWidth), zoomV),
+					offsetX);
+
+				BatchPd &batch = batches[b];
+				batch.Zx = julia ? px  : _mm512_setzero_pd();
+				batch.Zy = julia ? py  : _mm512_setzero_pd();
+				batch.Cx = julia ? juliaX : px;
+				batch.Cy = julia ? juliaY : py;
+
+				batch.SavedX = batch.Zx;
+				batch.SavedY = batch.Zy;
+
+				batch.Period = julia || start > 0 ? _mm512_setzero_pd() : MainComponentPeriod(px, py);
+				const __mmask8 inside = _mm512_cmp_pd_mask(batch.Period, _mm512_setzero_pd(), _CMP_GT_OQ);
+				batch.N = _mm512_maskz_mov_pd(inside, maxIterV);
+				batch.Active = (__mmask8) (valid & ~inside);
+				interiorLanes |= (u32) inside << (b * 8);
+				// Resumed lanes carry on from where they ran out.
+				if (start > 0)
+				{
+					alignas(64) double fields[8 * 8];
+					LoadStates(states, count, first, 8, fields);
+					batch.Zx = _mm512_load_pd(fields);
+					batch.Zy = _mm512_load_pd(fields + 8);
+					batch.SavedX = _mm512_load_pd(fields + 2 * 8);
+					batch.SavedY = _mm512_load_pd(fields + 3 * 8);
+					batch.N = _mm512_set1_pd((double) start);
+				}
+				batch.Square();
+			}
+
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batches[0].Step(two, one, bailout);
+				batches[1].Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+				{
+					batches[0].DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+					batches[1].DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+				}
+				if ((k & (k - 1)) == 0)
+				{
+					batches[0].Save();
+					batches[1].Save();
+					savedAt = k;
+				}
+
+				if ((batches[0].Active | batches[1].Active) == 0)
+					break;
+			}
+
+			alignas(64) double result[8 * BatchesInFlight];
+			alignas(64) double period[8 * BatchesInFlight];
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				_mm512_store_pd(result + b * 8, batches[b].N);
+				_mm512_store_pd(period + b * 8, batches[b].Period);
+			}
+
+			const u32 lanes = count - i < 8 * BatchesInFlight ? count - i : 8 * BatchesInFlight;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = (float) result[lane] / maxIter;
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(64) double fields[8 * 8 * BatchesInFlight] = {};
+				for (u32 b = 0; b < BatchesInFlight; b++)
+				{
+					_mm512_store_pd(fields + b * 8, batches[b].Zx);
+					_mm512_store_pd(fields + 8 * BatchesInFlight + b * 8, batches[b].Zy);
+					_mm512_store_pd(fields + 2 * 8 * BatchesInFlight + b * 8, batches[b].SavedX);
+					_mm512_store_pd(fields + 3 * 8 * BatchesInFlight + b * 8, batches[b].SavedY);
+				}
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= (double) view.MaxIterations && period[lane] == 0.0)
+						states[i + lane] = LaneState(fields, 8 * BatchesInFlight, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	// Double-double lanes: exactly the operation sequence of the scalar
+	// kernel's Dd, so results match it bit for bit.
+	struct DdPd
+	{
+		__m512d Hi, Lo;
+	};
+
+	inline DdPd TwoSum(__m512d a, __m512d b)
+	{
+		const __m512d s = _mm512_add_pd(a, b);
+		const __m512d v = _mm512_sub_pd(s, a);
+		return DdPd { s, _mm512_add_pd(_mm512_sub_pd(a, _mm512_sub_pd(s, v)), _mm512_sub_pd(b, v)) };
+	}
+	inline DdPd QuickTwoSum(__m512d a, __m512d b)
+	{
+		const __m512d s = _mm512_add_pd(a, b);
+		return DdPd { s, _mm512_sub_pd(b, _mm512_sub_pd(s, a)) };
+	}
+	inline void Split(__m512d a, __m512d &hi, __m512d &lo)
+	{
+		const __m512d t = _mm512_mul_pd(_mm512_set1_pd(134217729.0), a);
+		hi = _mm512_sub_pd(t, _mm512_sub_pd(t, a));
+		lo = _mm512_sub_pd(a, hi);
+	}
+	inline DdPd TwoProduct(__m512d a, __m512d b)
+	{
+		__m512d aHi, aLo, bHi, bLo;
+		Split(a, aHi, aLo);
+		Split(b, bHi, bLo);
+		const __m512d p = _mm512_mul_pd(a, b);
+		__m512d e = _mm512_sub_pd(_mm512_mul_pd(aHi, bHi), p);
+		e = _mm512_add_pd(e, _mm512_mul_pd(aHi, bLo));
+		e = _mm512_add_pd(e, _mm512_mul_pd(aLo, bHi));
+		e = _mm512_add_pd(e, _mm512_mul_pd(aLo, bLo));
+		return DdPd { p, e };
+	}
+	inline DdPd Add(DdPd a, DdPd b)
+	{
+		const DdPd s = TwoSum(a.Hi, b.Hi);
+		return QuickTwoSum(s.Hi, _mm512_add_pd(s.Lo, _mm512_add_pd(a.Lo, b.Lo)));
+	}
+	inline __m512d FlipSign(__m512d a)
+	{
+		// _mm512_xor_pd needs AVX512DQ; the integer xor is plain AVX512F.
+		const __m512i sign = _mm512_set1_epi64((long long) 0x8000000000000000ull);
+		return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), sign));
+	}
+	inline DdPd Negate(DdPd a)
+	{
+		return DdPd { FlipSign(a.Hi), FlipSign(a.Lo) };
+	}
+	inline DdPd Mul(DdPd a, DdPd b)
+	{
+		const DdPd p = TwoProduct(a.Hi, b.Hi);
+		return QuickTwoSum(p.Hi, _mm512_add_pd(p.Lo, _mm512_add_pd(_mm512_mul_pd(a.Hi, b.Lo), _mm512_mul_pd(a.Lo, b.Hi))));
+	}
+
+	struct BatchDd
+	{
+		DdPd Zx, Zy, Cx, Cy;
+		__m512d N;
+		DdPd SavedX, SavedY;
+		__m512d Period;
+		__mmask8 Active;
+
+		void Step(__m512d two, __m512d one, __m512d bailout)
+		{
+			const DdPd newX = Add(Add(Mul(Zx, Zx), Negate(Mul(Zy, Zy))), Cx);
+			const DdPd newY = Add(Mul(DdPd { _mm512_mul_pd(two, Zx.Hi), _mm512_mul_pd(two, Zx.Lo) }, Zy), Cy);
+			Zx.Hi = _mm512_mask_mov_pd(Zx.Hi, Active, newX.Hi);
+			Zx.Lo = _mm512_mask_mov_pd(Zx.Lo, Active, newX.Lo);
+			Zy.Hi = _mm512_mask_mov_pd(Zy.Hi, Active, newY.Hi);
+			Zy.Lo = _mm512_mask_mov_pd(Zy.Lo, Active, newY.Lo);
+
+			const __m512d magnitude = _mm512_add_pd(_mm512_mul_pd(Zx.Hi, Zx.Hi), _mm512_mul_pd(Zy.Hi, Zy.Hi));
+			Active = _mm512_mask_cmp_pd_mask(Active, magnitude, bailout, _CMP_NGT_UQ);
+			N = _mm512_mask_add_pd(N, Active, N, one);
+		}
+
+		void DetectCycle(__m512d tolerance, __m512d toleranceSq, __m512d maxIter, int period)
+		{
+			const __m512d dx = _mm512_add_pd(_mm512_sub_pd(Zx.Hi, SavedX.Hi), _mm512_sub_pd(Zx.Lo, SavedX.Lo));
+			if (_mm512_mask_cmp_pd_mask(Active, _mm512_abs_pd(dx), tolerance, _CMP_LT_OQ) == 0)
+				return;
+
+			const __m512d dy = _mm512_add_pd(_mm512_sub_pd(Zy.Hi, SavedY.Hi), _mm512_sub_pd(Zy.Lo, SavedY.Lo));
+			const __m512d distance = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+			const __mmask8 cycle = _mm512_mask_cmp_pd_mask(Active, distance, toleranceSq, _CMP_LT_OQ);
+			N = _mm512_mask_mov_pd(N, cycle, maxIter);
+			Period = _mm512_mask_mov_pd(Period, cycle, _mm512_set1_pd((double) period));
+			Active = (__mmask8) (Active & ~cycle);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+
+	// The double-double state is four times the size of a double batch, so
+	// one batch is enough to keep the ports busy.
+	u32 Avx512DoubleDouble(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const double dy = (((double) y + 0.5) - (double) view.Height / 2.0) / view.Zoom.ToDouble();
+
+		const __m512d zero       = _mm512_setzero_pd();
+		const __m512d half       = _mm512_set1_pd(0.5);
+		const __m512d two        = _mm512_set1_pd(2.0);
+		const __m512d one        = _mm512_set1_pd(1.0);
+		const __m512d bailout    = _mm512_set1_pd(16.0);
+		const __m512d halfWidth  = _mm512_set1_pd((double) view.Width / 2.0);
+		const __m512d halfHeight = _mm512_set1_pd((double) view.Height / 2.0);
+		const __m512d zoomV      = _mm512_set1_pd(view.Zoom.ToDouble());
+		const DdPd offsetX       = { _mm512_set1_pd(-view.Offset.x), _mm512_set1_pd(-view.OffsetLo.x) };
+		const DdPd offsetY       = { _mm512_set1_pd(-view.Offset.y), _mm512_set1_pd(-view.OffsetLo.y) };
+		const DdPd rowY          = Add(DdPd { _mm512_set1_pd(dy), zero }, offsetY);
+		const DdPd juliaX        = { _mm512_set1_pd(view.JuliaC.x), zero };
+		const DdPd juliaY        = { _mm512_set1_pd(view.JuliaC.y), zero };
+		const __m256i laneIndex  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m512d maxIterV   = _mm512_set1_pd((double) view.MaxIterations);
+		const double tolerance   = PeriodTolerance / view.Zoom.ToDouble();
+		const __m512d toleranceV = _mm512_set1_pd(tolerance);
+		const __m512d toleranceSq = _mm512_set1_pd(tolerance * tolerance);
+		const float maxIter = (float) view.MaxIterations;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 8)
+		{
+			const u32 first = i;
+			// Lanes past `count` start out retired.
+			const int remaining = (int) count - (int) first;
+			const __mmask8 valid = _mm512_cmp_pd_mask(_mm512_cvtepi32_pd(laneIndex), _mm512_set1_pd((double) remaining), _CMP_LT_OQ);
+			__m256i pixelX = _mm256_add_epi32(_mm256_set1_epi32((int) (x + first)), laneIndex);
+			DdPd py = rowY;
+			if (xs)
+			{
+				alignas(32) int laneX[8], laneY[8];
+				GatherLanes(xs, ys, count, first, 8, laneX, laneY);
+				pixelX = _mm256_load_si256((__m256i *) laneX);
+				const __m512d dy = _mm512_div_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_cvtepi32_pd(_mm256_load_si256((__m256i *) laneY)), half), halfHeight), zoomV);
+				py = Add(DdPd { dy, zero }, offsetY);
+			}
+			const __m512d dx = _mm512_div_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_cvtepi32_pd(pixelX), half), halfWidth), zoomV);
+			const DdPd px = Add(DdPd { dx, zero }, offsetX);
+
+			BatchDd batch;
+			batch.Zx = julia ? px : DdPd { zero, zero };
+			batch.Zy = julia ? py : DdPd { zero, zero };
+			batch.Cx = julia ? juliaX : px;
+			batch.Cy = julia ? juliaY : py;
+
+			batch.SavedX = batch.Zx;
+			batch.SavedY = batch.Zy;
+
+			// Tested on Hi alone, like the scalar kernel.
+			batch.Period = julia || start > 0 ? zero : MainComponentPeriod(px.Hi, py.Hi);
+			const __mmask8 inside = _mm512_cmp_pd_mask(batch.Period, zero, _CMP_GT_OQ);
+			batch.N = _mm512_maskz_mov_pd(inside, maxIterV);
+			batch.Active = (__mmask8) (valid & ~inside);
+			const u32 interiorLanes = inside;
+			if (start > 0)
+			{
+				alignas(64) double fields[8 * 8];
+				LoadStates(states, count, first, 8, fields);
+				batch.Zx = DdPd { _mm512_load_pd(fields), _mm512_load_pd(fields + 4 * 8) };
+				batch.Zy = DdPd { _mm512_load_pd(fields + 8), _mm512_load_pd(fields + 5 * 8) };
+				batch.SavedX = DdPd { _mm512_load_pd(fields + 2 * 8), _mm512_load_pd(fields + 6 * 8) };
+				batch.SavedY = DdPd { _mm512_load_pd(fields + 3 * 8), _mm512_load_pd(fields + 7 * 8) };
+				batch.N = _mm512_set1_pd((double) start);
+			}
+
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batch.Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+					batch.DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+				if ((k & (k - 1)) == 0)
+				{
+					batch.Save();
+					savedAt = k;
+				}
+
+				if (batch.Active == 0)
+					break;
+			}
+
+			alignas(64) double result[8];
+			alignas(64) double period[8];
+			_mm512_store_pd(result, batch.N);
+			_mm512_store_pd(period, batch.Period);
+
+			const u32 lanes = count - i < 8 ? count - i : 8;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = (float) result[lane] / maxIter;
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(64) double fields[8 * 8];
+				_mm512_store_pd(fields, batch.Zx.Hi);
+				_mm512_store_pd(fields + 8, batch.Zy.Hi);
+				_mm512_store_pd(fields + 2 * 8, batch.SavedX.Hi);
+				_mm512_store_pd(fields + 3 * 8, batch.SavedY.Hi);
+				_mm512_store_pd(fields + 4 * 8, batch.Zx.Lo);
+				_mm512_store_pd(fields + 5 * 8, batch.Zy.Lo);
+				_mm512_store_pd(fields + 6 * 8, batch.SavedX.Lo);
+				_mm512_store_pd(fields + 7 * 8, batch.SavedY.Lo);
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= (double) view.MaxIterations && period[lane] == 0.0)
+						states[i + lane] = LaneState(fields, 8, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	u32 Avx512KernelFloat(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Avx512Float(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Avx512GatherFloat(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Avx512Float(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Avx512KernelDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Avx512Double(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Avx512GatherDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Avx512Double(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Avx512KernelDoubleDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Avx512DoubleDouble(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Avx512GatherDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Avx512DoubleDouble(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Avx512ResumeFloat(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Avx512Float(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 Avx512ResumeDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Avx512Double(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 Avx512ResumeDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Avx512DoubleDouble(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+}
+
+namespace EscapeKernels
+{
+	const EscapeKernel *Avx512()
+	{
+		static const EscapeKernel kernel = { "AVX-512",
+			&Avx512KernelFloat, &Avx512KernelDouble, &Avx512KernelDoubleDouble,
+			&Avx512GatherFloat, &Avx512GatherDouble, &Avx512GatherDoubleDouble,
+			&Avx512ResumeFloat, &Avx512ResumeDouble, &Avx512ResumeDoubleDouble };
+		return &kernel;
+	}
+}
+
+#else
+
+namespace EscapeKernels
+{
+	const EscapeKernel *Avx512()
+	{
+		return nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,779 @@
+#include "EscapeKernels.h"
+
+// SSE2 is part of the x86-64 baseline, so this file needs no extra compiler
+// flags. MSVC does not define __SSE2__ for x64, hence the second test.
+#if defined(__SSE2__) || defined(_M_X64)
+
+#include <emmintrin.h>
+
+
+namespace
+{
+	// Same scheme as the AVX2 kernel at 4 floats / 2 doubles per lane group.
+	// SSE2 has no blendv, so lane masks are applied with and/andnot/or.
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+	inline __m128d Select(__m128d mask, __m128d a, __m128d b)
+	{
+		return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+	}
+
+	struct BatchPs
+	{
+		__m128 Zx, Zy, Cx, Cy, N, Active;
+		__m128 SavedX, SavedY, Period;
+		__m128 Zx2, Zy2;   // Zx², Zy², shared by the escape test and the next Step
+
+		void Square()
+		{
+			Zx2 = _mm_mul_ps(Zx, Zx);
+			Zy2 = _mm_mul_ps(Zy, Zy);
+		}
+
+		void Step(__m128 two, __m128 one, __m128 bailout)
+		{
+			const __m128 newX = _mm_add_ps(_mm_sub_ps(Zx2, Zy2), Cx);
+			const __m128 newY = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, Zx), Zy), Cy);
+			Zx = newX;
+			Zy = newY;
+
+			Square();
+			const __m128 magnitude = _mm_add_ps(Zx2, Zy2);
+			Active = _mm_andnot_ps(_mm_cmpgt_ps(magnitude, bailout), Active);
+			N = _mm_add_ps(N, _mm_and_ps(Active, one));
+		}
+
+		// Brent cycle detection, after Step: lanes back within `tolerance` of
+		// the saved z (squared distance below `toleranceSq`) are interior
+		// with the given period. |dx| < tolerance is implied by the full
+		// test, so lanes failing it are ruled out at half the cost; escaping
+		// orbits almost never pass it.
+		void DetectCycle(__m128 tolerance, __m128 toleranceSq, __m128 maxIter, int period)
+		{
+			const __m128 dx = _mm_sub_ps(Zx, SavedX);
+			const __m128 near = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), dx), tolerance);
+			if (_mm_movemask_ps(_mm_and_ps(near, Active)) == 0)
+				return;
+
+			const __m128 dy = _mm_sub_ps(Zy, SavedY);
+			const __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			const __m128 cycle = _mm_and_ps(_mm_cmplt_ps(distance, toleranceSq), Active);
+			N = Select(cycle, maxIter, N);
+			Period = Select(cycle, _mm_set1_ps((float) period), Period);
+			Active = _mm_andnot_ps(cycle, Active);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+	struct BatchPd
+	{
+		__m128d Zx, Zy, Cx, Cy, N, Active;
+		__m128d SavedX, SavedY, Period;
+		__m128d Zx2, Zy2;   // Zx², Zy², shared by the escape test and the next Step
+
+		void Square()
+		{
+			Zx2 = _mm_mul_pd(Zx, Zx);
+			Zy2 = _mm_mul_pd(Zy, Zy);
+		}
+
+		void Step(__m128d two, __m128d one, __m128d bailout)
+		{
+			const __m128d newX = _mm_add_pd(_mm_sub_pd(Zx2, Zy2), Cx);
+			const __m128d newY = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, Zx), Zy), Cy);
+			Zx = newX;
+			Zy = newY;
+
+			Square();
+			const __m128d magnitude = _mm_add_pd(Zx2, Zy2);
+			Active = _mm_andnot_pd(_mm_cmpgt_pd(magnitude, bailout), Active);
+			N = _mm_add_pd(N, _mm_and_pd(Active, one));
+		}
+
+		void DetectCycle(__m128d tolerance, __m128d toleranceSq, __m128d maxIter, int period)
+		{
+			const __m128d dx = _mm_sub_pd(Zx, SavedX);
+			const __m128d near = _mm_cmplt_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), dx), tolerance);
+			if (_mm_movemask_pd(_mm_and_pd(near, Active)) == 0)
+				return;
+
+			const __m128d dy = _mm_sub_pd(Zy, SavedY);
+			const __m128d distance = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+			const __m128d cycle = _mm_and_pd(_mm_cmplt_pd(distance, toleranceSq), Active);
+			N = Select(cycle, maxIter, N);
+			Period = Select(cycle, _mm_set1_pd((double) period), Period);
+			Active = _mm_andnot_pd(cycle, Active);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+
+	// MainComponentPeriod() from Fractal.h, lane by lane: 1 in the main
+	// cardioid, 2 in the period-2 bulb, 0 elsewhere.
+	inline __m128 MainComponentPeriod(__m128 cx, __m128 cy)
+	{
+		const __m128 y2 = _mm_mul_ps(cy, cy);
+		const __m128 x = _mm_sub_ps(cx, _mm_set1_ps(0.25f));
+		const __m128 q = _mm_add_ps(_mm_mul_ps(x, x), y2);
+		const __m128 cardioid = _mm_cmple_ps(_mm_mul_ps(q, _mm_add_ps(q, x)), _mm_mul_ps(_mm_set1_ps(0.25f), y2));
+		const __m128 x1 = _mm_add_ps(cx, _mm_set1_ps(1.0f));
+		const __m128 bulb = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(x1, x1), y2), _mm_set1_ps(0.0625f));
+		return Select(cardioid, _mm_set1_ps(1.0f), _mm_and_ps(bulb, _mm_set1_ps(2.0f)));
+	}
+	inline __m128d MainComponentPeriod(__m128d cx, __m128d cy)
+	{
+		const __m128d y2 = _mm_mul_pd(cy, cy);
+		const __m128d x = _mm_sub_pd(cx, _mm_set1_pd(0.25));
+		const __m128d q = _mm_add_pd(_mm_mul_pd(x, x), y2);
+		const __m128d cardioid = _mm_cmple_pd(_mm_mul_pd(q, _mm_add_pd(q, x)), _mm_mul_pd(_mm_set1_pd(0.25), y2));
+		const __m128d x1 = _mm_add_pd(cx, _mm_set1_pd(1.0));
+		const __m128d bulb = _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(x1, x1), y2), _mm_set1_pd(0.0625));
+		return Select(cardioid, _mm_set1_pd(1.0), _mm_and_pd(bulb, _mm_set1_pd(2.0)));
+	}
+
+	// The kernels below compute pixel i at (x + i, y), or at (xs[i], ys[i])
+	// when xs is set; a gathered call loads each batch's coordinates from
+	// the lists here. Lanes past `count` repeat its last
+	// pixel; they are retired before the first iteration anyway.
+	inline void GatherLanes(const u32 *xs, const u32 *ys, u32 count, u32 first, u32 lanes, int *laneX, int *laneY)
+	{
+		for (u32 lane = 0; lane < lanes; lane++)
+		{
+			const u32 index = first + lane < count ? first + lane : count - 1;
+			laneX[lane] = (int) xs[index];
+			laneY[lane] = (int) ys[index];
+		}
+	}
+
+	// Resumed calls (see EscapeResumeFn) load each batch's orbits lane by lane
+	// the same way: field f of lane l goes to fields[f * lanes + l], fields
+	// in EscapeState's order.
+	template<typename T>
+	void LoadStates(const EscapeState *states, u32 count, u32 first, u32 lanes, T *fields)
+	{
+		for (u32 lane = 0; lane < lanes; lane++)
+		{
+			const EscapeState &state = states[first + lane < count ? first + lane : count - 1];
+			const double values[] = { state.Zx, state.Zy, state.SavedX, state.SavedY, state.ZxLo, state.ZyLo, state.SavedXLo, state.SavedYLo };
+			for (u32 field = 0; field < 8; field++)
+				fields[field * lanes + lane] = (T) values[field];
+		}
+	}
+	template<typename T>
+	EscapeState LaneState(const T *fields, u32 lanes, u32 lane)
+	{
+		return EscapeState { (double) fields[lane], (double) fields[lanes + lane], (double) fields[2 * lanes + lane], (double) fields[3 * lanes + lane],
+			(double) fields[4 * lanes + lane], (double) fields[5 * lanes + lane], (double) fields[6 * lanes + lane], (double) fields[7 * lanes + lane] };
+	}
+
+	// The highest power of two up to `start`: where the cycle detection of an
+	// orbit resumed after `start` iterations last saved z.
+	inline int LastSave(u32 start)
+	{
+		int savedAt = 0;
+		for (u32 k = 1; k <= start; k *= 2)
+			savedAt = (int) k;
+		return savedAt;
+	}
+
+	constexpr u32 BatchesInFlight = 2;
+
+	u32 Sse2Float(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const float zoom = (float) view.Zoom.ToDouble();
+		const float py = (((float) y + 0.5f) - (float) view.Height / 2.0f) / zoom - (float) view.Offset.y;
+
+		const __m128 half       = _mm_set1_ps(0.5f);
+		const __m128 two        = _mm_set1_ps(2.0f);
+		const __m128 one        = _mm_set1_ps(1.0f);
+		const __m128 bailout    = _mm_set1_ps(16.0f);
+		const __m128 halfWidth  = _mm_set1_ps((float) view.Width / 2.0f);
+		const __m128 zoomV      = _mm_set1_ps(zoom);
+		const __m128 offsetX    = _mm_set1_ps((float) view.Offset.x);
+		const __m128 pyV        = _mm_set1_ps(py);
+		const __m128 halfHeight = _mm_set1_ps((float) view.Height / 2.0f);
+		const __m128 offsetY    = _mm_set1_ps((float) view.Offset.y);
+		const __m128 juliaX     = _mm_set1_ps((float) view.JuliaC.x);
+		const __m128 juliaY     = _mm_set1_ps((float) view.JuliaC.y);
+		const __m128 maxIter    = _mm_set1_ps((float) view.MaxIterations);
+		const __m128i laneIndex  = _mm_setr_epi32(0, 1, 2, 3);
+		const float tolerance   = (float) PeriodTolerance / zoom;
+		const __m128 toleranceV = _mm_set1_ps(tolerance);
+		const __m128 toleranceSq = _mm_set1_ps(tolerance * tolerance);
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 4 * BatchesInFlight)
+		{
+			BatchPs batches[BatchesInFlight];
+			u32 interiorLanes = 0;
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				const u32 first = i + b * 4;
+				// Lanes past `count` start out retired.
+				const int remaining = (int) count - (int) first;
+				const __m128 valid = _mm_cmplt_ps(_mm_cvtepi32_ps(laneIndex), _mm_set1_ps((float) remaining));
+				__m128i pixelX = _mm_add_epi32(_mm_set1_epi32((int) (x + first)), laneIndex);
+				__m128 py = pyV;
+				if (xs)
+				{
+					alignas(16) int laneX[4], laneY[4];
+					GatherLanes(xs, ys, count, first, 4, laneX, laneY);
+					pixelX = _mm_load_si128((__m128i *) laneX);
+					py = _mm_sub_ps(
+						_mm_div_ps(_mm_sub_ps(_mm_add_ps(_mm_cvtepi32_ps(_mm_load_si128((__m128i *) laneY)), half), halfHeight), zoomV),
+						offsetY);
+				}
+				const __m128 px = _mm_sub_ps(
+					_mm_div_ps(_mm_sub_ps(_mm_add_ps(_mm_cvtepi32_ps(pixelX), half), halfWidth), zoomV),
+					offsetX);
+
+				BatchPs &batch = batches[b];
+				batch.Zx = julia ? px  : _mm_setzero_ps();
+				batch.Zy = julia ? py  : _mm_setzero_ps();
+				batch.Cx = julia ? juliaX : px;
+				batch.Cy = julia ? juliaY : py;
+
+				batch.SavedX = batch.Zx;
+				batch.SavedY = batch.Zy;
+
+				// Interior lanes start out finished at the full count; resumed
+				// lanes are past that test.
+				batch.Period = julia || start > 0 ? _mm_setzero_ps() : MainComponentPeriod(px, py);
+				const __m128 inside = _mm_cmpgt_ps(batch.Period, _mm_setzero_ps());
+				batch.N = _mm_and_ps(inside, maxIter);
+				batch.Active = _mm_andnot_ps(inside, valid);
+				interiorLanes |= (u32) _mm_movemask_ps(inside) << (b * 4);
+				// Resumed lanes carry on from where they ran out.
+				if (start > 0)
+				{
+					alignas(16) float fields[8 * 4];
+					LoadStates(states, count, first, 4, fields);
+					batch.Zx = _mm_load_ps(fields);
+					batch.Zy = _mm_load_ps(fields + 4);
+					batch.SavedX = _mm_load_ps(fields + 2 * 4);
+					batch.SavedY = _mm_load_ps(fields + 3 * 4);
+					batch.N = _mm_set1_ps((float) start);
+				}
+				batch.Square();
+			}
+
+			// z is saved after iterations 1, 2, 4, 8, ... (the same for
+			// every lane), so the period is the distance back to savedAt
+			// and the check schedule is shared by the whole batch.
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batches[0].Step(two, one, bailout);
+				batches[1].Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+				{
+					batches[0].DetectCycle(toleranceV, toleranceSq, maxIter, k - savedAt);
+					batches[1].DetectCycle(toleranceV, toleranceSq, maxIter, k - savedAt);
+				}
+				if ((k & (k - 1)) == 0)
+				{
+					batches[0].Save();
+					batches[1].Save();
+					savedAt = k;
+				}
+
+				if (_mm_movemask_ps(_mm_or_ps(batches[0].Active, batches[1].Active)) == 0)
+					break;
+			}
+
+			alignas(16) float result[4 * BatchesInFlight];
+			alignas(16) float period[4 * BatchesInFlight];
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				_mm_store_ps(result + b * 4, _mm_div_ps(batches[b].N, maxIter));
+				_mm_store_ps(period + b * 4, batches[b].Period);
+			}
+
+			const u32 lanes = count - i < 4 * BatchesInFlight ? count - i : 4 * BatchesInFlight;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = result[lane];
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(16) float fields[8 * 4 * BatchesInFlight] = {};
+				for (u32 b = 0; b < BatchesInFlight; b++)
+				{
+					_mm_store_ps(fields + b * 4, batches[b].Zx);
+					_mm_store_ps(fields + 4 * BatchesInFlight + b * 4, batches[b].Zy);
+					_mm_store_ps(fields + 2 * 4 * BatchesInFlight + b * 4, batches[b].SavedX);
+					_mm_store_ps(fields + 3 * 4 * BatchesInFlight + b * 4, batches[b].SavedY);
+				}
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= 1.0f && period[lane] == 0.0f)
+						states[i + lane] = LaneState(fields, 4 * BatchesInFlight, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	u32 Sse2Double(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const double py = (((double) y + 0.5) - (double) view.Height / 2.0) / view.Zoom.ToDouble() - view.Offset.y;
+
+		const __m128d half       = _mm_set1_pd(0.5);
+		const __m128d two        = _mm_set1_pd(2.0);
+		const __m128d one        = _mm_set1_pd(1.0);
+		const __m128d bailout    = _mm_set1_pd(16.0);
+		const __m128d halfWidth  = _mm_set1_pd((double) view.Width / 2.0);
+		const __m128d zoomV      = _mm_set1_pd(view.Zoom.ToDouble());
+		const __m128d offsetX    = _mm_set1_pd(view.Offset.x);
+		const __m128d pyV        = _mm_set1_pd(py);
+		const __m128d halfHeight = _mm_set1_pd((double) view.Height / 2.0);
+		const __m128d offsetY    = _mm_set1_pd(view.Offset.y);
+		const __m128d juliaX     = _mm_set1_pd(view.JuliaC.x);
+		const __m128d juliaY     = _mm_set1_pd(view.JuliaC.y);
+		const __m128i laneIndex  = _mm_setr_epi32(0, 1, 0, 0);
+		const __m128d maxIterV   = _mm_set1_pd((double) view.MaxIterations);
+		const double tolerance   = PeriodTolerance / view.Zoom.ToDouble();
+		const __m128d toleranceV = _mm_set1_pd(tolerance);
+		const __m128d toleranceSq = _mm_set1_pd(tolerance * tolerance);
+		const float maxIter = (float) view.MaxIterations;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 2 * BatchesInFlight)
+		{
+			BatchPd batches[BatchesInFlight];
+			u32 interiorLanes = 0;
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				const u32 first = i + b * 2;
+				// Lanes past `count` start out retired.
+				const int remaining = (int) count - (int) first;
+				const __m128d valid = _mm_cmplt_pd(_mm_cvtepi32_pd(laneIndex), _mm_set1_pd((double) remaining));
+				__m128i pixelX = _mm_add_epi32(_mm_set1_epi32((int) (x + first)), laneIndex);
+				__m128d py = pyV;
+				if (xs)
+				{
+					alignas(16) int laneX[4], laneY[4];
+					GatherLanes(xs, ys, count, first, 4, laneX, laneY);
+					pixelX = _mm_load_si128((__m128i *) laneX);
+					py = _mm_sub_pd(
+						_mm_div_pd(_mm_sub_pd(_mm_add_pd(_mm_cvtepi32_pd(_mm_load_si128((__m128i *) laneY)), half), halfHeight), zoomV),
+						offsetY);
+				}
+				const __m128d px = _mm_sub_pd(
+					_mm_div_pd(_mm_sub_pd(_mm_add_pd(_mm_cvtepi32_pd(pixelX), half), halfWidth), zoomV),
+					offsetX);
+
+				BatchPd &batch = batches[b];
+				batch.Zx = julia ? px  : _mm_setzero_pd();
+				batch.Zy = julia ? py  : _mm_setzero_pd();
+				batch.Cx = julia ? juliaX : px;
+				batch.Cy = julia ? juliaY : py;
+
+				batch.SavedX = batch.Zx;
+				batch.SavedY = batch.Zy;
+
+				batch.Period = julia || start > 0 ? _mm_setzero_pd() : MainComponentPeriod(px, py);
+				const __m128d inside = _mm_cmpgt_pd(batch.Period, _mm_setzero_pd());
+				batch.N = _mm_and_pd(inside, maxIterV);
+				batch.Active = _mm_andnot_pd(inside, valid);
+				interiorLanes |= (u32) _mm_movemask_pd(inside) << (b * 2);
+				// Resumed lanes carry on from where they ran out.
+				if (start > 0)
+				{
+					alignas(16) double fields[8 * 2];
+					LoadStates(states, count, first, 2, fields);
+					batch.Zx = _mm_load_pd(fields);
+					batch.Zy = _mm_load_pd(fields + 2);
+					batch.SavedX = _mm_load_pd(fields + 2 * 2);
+					batch.SavedY = _mm_load_pd(fields + 3 * 2);
+					batch.N = _mm_set1_pd((double) start);
+				}
+				batch.Square();
+			}
+
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batches[0].Step(two, one, bailout);
+				batches[1].Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+				{
+					batches[0].DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+					batches[1].DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+				}
+				if ((k & (k - 1)) == 0)
+				{
+					batches[0].Save();
+					batches[1].Save();
+					savedAt = k;
+				}
+
+				if (_mm_movemask_pd(_mm_or_pd(batches[0].Active, batches[1].Active)) == 0)
+					break;
+			}
+
+			alignas(16) double result[2 * BatchesInFlight];
+			alignas(16) double period[2 * BatchesInFlight];
+			for (u32 b = 0; b < BatchesInFlight; b++)
+			{
+				_mm_store_pd(result + b * 2, batches[b].N);
+				_mm_store_pd(period + b * 2, batches[b].Period);
+			}
+
+			const u32 lanes = count - i < 2 * BatchesInFlight ? count - i : 2 * BatchesInFlight;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = (float) result[lane] / maxIter;
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(16) double fields[8 * 2 * BatchesInFlight] = {};
+				for (u32 b = 0; b < BatchesInFlight; b++)
+				{
+					_mm_store_pd(fields + b * 2, batches[b].Zx);
+					_mm_store_pd(fields + 2 * BatchesInFlight + b * 2, batches[b].Zy);
+					_mm_store_pd(fields + 2 * 2 * BatchesInFlight + b * 2, batches[b].SavedX);
+					_mm_store_pd(fields + 3 * 2 * BatchesInFlight + b * 2, batches[b].SavedY);
+				}
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= (double) view.MaxIterations && period[lane] == 0.0)
+						states[i + lane] = LaneState(fields, 2 * BatchesInFlight, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	// Double-double lanes: exactly the operation sequence of the scalar
+	// kernel's Dd, so results match it bit for bit.
+	struct DdPd
+	{
+		__m128d Hi, Lo;
+	};
+
+	inline DdPd TwoSum(__m128d a, __m128d b)
+	{
+		const __m128d s = _mm_add_pd(a, b);
+		const __m128d v = _mm_sub_pd(s, a);
+		return DdPd { s, _mm_add_pd(_mm_sub_pd(a, _mm_sub_pd(s, v)), _mm_sub_pd(b, v)) };
+	}
+	inline DdPd QuickTwoSum(__m128d a, __m128d b)
+	{
+		const __m128d s = _mm_add_pd(a, b);
+		return DdPd { s, _mm_sub_pd(b, _mm_sub_pd(s, a)) };
+	}
+	inline void Split(__m128d a, __m128d &hi, __m128d &lo)
+	{
+		const __m128d t = _mm_mul_pd(_mm_set1_pd(134217729.0), a);
+		hi = _mm_sub_pd(t, _mm_sub_pd(t, a));
+		lo = _mm_sub_pd(a, hi);
+	}
+	inline DdPd TwoProduct(__m128d a, __m128d b)
+	{
+		__m128d aHi, aLo, bHi, bLo;
+		Split(a, aHi, aLo);
+		Split(b, bHi, bLo);
+		const __m128d p = _mm_mul_pd(a, b);
+		__m128d e = _mm_sub_pd(_mm_mul_pd(aHi, bHi), p);
+		e = _mm_add_pd(e, _mm_mul_pd(aHi, bLo));
+		e = _mm_add_pd(e, _mm_mul_pd(aLo, bHi));
+		e = _mm_add_pd(e, _mm_mul_pd(aLo, bLo));
+		return DdPd { p, e };
+	}
+	inline DdPd Add(DdPd a, DdPd b)
+	{
+		const DdPd s = TwoSum(a.Hi, b.Hi);
+		return QuickTwoSum(s.Hi, _mm_add_pd(s.Lo, _mm_add_pd(a.Lo, b.Lo)));
+	}
+	inline DdPd Negate(DdPd a)
+	{
+		return DdPd { _mm_xor_pd(a.Hi, _mm_set1_pd(-0.0)), _mm_xor_pd(a.Lo, _mm_set1_pd(-0.0)) };
+	}
+	inline DdPd Mul(DdPd a, DdPd b)
+	{
+		const DdPd p = TwoProduct(a.Hi, b.Hi);
+		return QuickTwoSum(p.Hi, _mm_add_pd(p.Lo, _mm_add_pd(_mm_mul_pd(a.Hi, b.Lo), _mm_mul_pd(a.Lo, b.Hi))));
+	}
+
+	struct BatchDd
+	{
+		DdPd Zx, Zy, Cx, Cy;
+		__m128d N, Active;
+		DdPd SavedX, SavedY;
+		__m128d Period;
+
+		void Step(__m128d two, __m128d one, __m128d bailout)
+		{
+			const DdPd newX = Add(Add(Mul(Zx, Zx), Negate(Mul(Zy, Zy))), Cx);
+			const DdPd newY = Add(Mul(DdPd { _mm_mul_pd(two, Zx.Hi), _mm_mul_pd(two, Zx.Lo) }, Zy), Cy);
+			Zx.Hi = Select(Active, newX.Hi, Zx.Hi);
+			Zx.Lo = Select(Active, newX.Lo, Zx.Lo);
+			Zy.Hi = Select(Active, newY.Hi, Zy.Hi);
+			Zy.Lo = Select(Active, newY.Lo, Zy.Lo);
+
+			const __m128d magnitude = _mm_add_pd(_mm_mul_pd(Zx.Hi, Zx.Hi), _mm_mul_pd(Zy.Hi, Zy.Hi));
+			Active = _mm_andnot_pd(_mm_cmpgt_pd(magnitude, bailout), Active);
+			N = _mm_add_pd(N, _mm_and_pd(Active, one));
+		}
+
+		void DetectCycle(__m128d tolerance, __m128d toleranceSq, __m128d maxIter, int period)
+		{
+			const __m128d dx = _mm_add_pd(_mm_sub_pd(Zx.Hi, SavedX.Hi), _mm_sub_pd(Zx.Lo, SavedX.Lo));
+			const __m128d near = _mm_cmplt_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), dx), tolerance);
+			if (_mm_movemask_pd(_mm_and_pd(near, Active)) == 0)
+				return;
+
+			const __m128d dy = _mm_add_pd(_mm_sub_pd(Zy.Hi, SavedY.Hi), _mm_sub_pd(Zy.Lo, SavedY.Lo));
+			const __m128d distance = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+			const __m128d cycle = _mm_and_pd(_mm_cmplt_pd(distance, toleranceSq), Active);
+			N = Select(cycle, maxIter, N);
+			Period = Select(cycle, _mm_set1_pd((double) period), Period);
+			Active = _mm_andnot_pd(cycle, Active);
+		}
+		void Save()
+		{
+			SavedX = Zx;
+			SavedY = Zy;
+		}
+	};
+
+	// The double-double state is four times the size of a double batch, so
+	// one batch is enough to keep the ports busy.
+	u32 Sse2DoubleDouble(const FractalView &view, u32 x, u32 y, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods,
+		u32 start, EscapeState *states)
+	{
+		if (view.MaxIterations <= 0)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				out[i] = 0.0f;
+				periods[i] = 0;
+			}
+			return 0;
+		}
+
+		const bool julia = view.Type == FractalType::JuliaSet;
+		const double dy = (((double) y + 0.5) - (double) view.Height / 2.0) / view.Zoom.ToDouble();
+
+		const __m128d zero       = _mm_setzero_pd();
+		const __m128d half       = _mm_set1_pd(0.5);
+		const __m128d two        = _mm_set1_pd(2.0);
+		const __m128d one        = _mm_set1_pd(1.0);
+		const __m128d bailout    = _mm_set1_pd(16.0);
+		const __m128d halfWidth  = _mm_set1_pd((double) view.Width / 2.0);
+		const __m128d halfHeight = _mm_set1_pd((double) view.Height / 2.0);
+		const __m128d zoomV      = _mm_set1_pd(view.Zoom.ToDouble());
+		const DdPd offsetX       = { _mm_set1_pd(-view.Offset.x), _mm_set1_pd(-view.OffsetLo.x) };
+		const DdPd offsetY       = { _mm_set1_pd(-view.Offset.y), _mm_set1_pd(-view.OffsetLo.y) };
+		const DdPd rowY          = Add(DdPd { _mm_set1_pd(dy), zero }, offsetY);
+		const DdPd juliaX        = { _mm_set1_pd(view.JuliaC.x), zero };
+		const DdPd juliaY        = { _mm_set1_pd(view.JuliaC.y), zero };
+		const __m128i laneIndex  = _mm_setr_epi32(0, 1, 0, 0);
+		const __m128d maxIterV   = _mm_set1_pd((double) view.MaxIterations);
+		const double tolerance   = PeriodTolerance / view.Zoom.ToDouble();
+		const __m128d toleranceV = _mm_set1_pd(tolerance);
+		const __m128d toleranceSq = _mm_set1_pd(tolerance * tolerance);
+		const float maxIter = (float) view.MaxIterations;
+
+		u32 interior = 0;
+		for (u32 i = 0; i < count; i += 2)
+		{
+			const u32 first = i;
+			// Lanes past `count` start out retired.
+			const int remaining = (int) count - (int) first;
+			const __m128d valid = _mm_cmplt_pd(_mm_cvtepi32_pd(laneIndex), _mm_set1_pd((double) remaining));
+			__m128i pixelX = _mm_add_epi32(_mm_set1_epi32((int) (x + first)), laneIndex);
+			DdPd py = rowY;
+			if (xs)
+			{
+				alignas(16) int laneX[4], laneY[4];
+				GatherLanes(xs, ys, count, first, 4, laneX, laneY);
+				pixelX = _mm_load_si128((__m128i *) laneX);
+				const __m128d dy = _mm_div_pd(_mm_sub_pd(_mm_add_pd(_mm_cvtepi32_pd(_mm_load_si128((__m128i *) laneY)), half), halfHeight), zoomV);
+				py = Add(DdPd { dy, zero }, offsetY);
+			}
+			const __m128d dx = _mm_div_pd(_mm_sub_pd(_mm_add_pd(_mm_cvtepi32_pd(pixelX), half), halfWidth), zoomV);
+			const DdPd px = Add(DdPd { dx, zero }, offsetX);
+
+			BatchDd batch;
+			batch.Zx = julia ? px : DdPd { zero, zero };
+			batch.Zy = julia ? py : DdPd { zero, zero };
+			batch.Cx = julia ? juliaX : px;
+			batch.Cy = julia ? juliaY : py;
+
+			batch.SavedX = batch.Zx;
+			batch.SavedY = batch.Zy;
+
+			// Tested on Hi alone, like the scalar kernel.
+			batch.Period = julia || start > 0 ? zero : MainComponentPeriod(px.Hi, py.Hi);
+			const __m128d inside = _mm_cmpgt_pd(batch.Period, zero);
+			batch.N = _mm_and_pd(inside, maxIterV);
+			batch.Active = _mm_andnot_pd(inside, valid);
+			const u32 interiorLanes = (u32) _mm_movemask_pd(inside);
+			if (start > 0)
+			{
+				alignas(16) double fields[8 * 2];
+				LoadStates(states, count, first, 2, fields);
+				batch.Zx = DdPd { _mm_load_pd(fields), _mm_load_pd(fields + 4 * 2) };
+				batch.Zy = DdPd { _mm_load_pd(fields + 2), _mm_load_pd(fields + 5 * 2) };
+				batch.SavedX = DdPd { _mm_load_pd(fields + 2 * 2), _mm_load_pd(fields + 6 * 2) };
+				batch.SavedY = DdPd { _mm_load_pd(fields + 3 * 2), _mm_load_pd(fields + 7 * 2) };
+				batch.N = _mm_set1_pd((double) start);
+			}
+
+			int savedAt = LastSave(start);
+			for (int iteration = (int) start; iteration < view.MaxIterations; iteration++)
+			{
+				batch.Step(two, one, bailout);
+
+				const int k = iteration + 1;
+				if (k - savedAt <= (savedAt >> PeriodCheckShift))
+					batch.DetectCycle(toleranceV, toleranceSq, maxIterV, k - savedAt);
+				if ((k & (k - 1)) == 0)
+				{
+					batch.Save();
+					savedAt = k;
+				}
+
+				if (_mm_movemask_pd(batch.Active) == 0)
+					break;
+			}
+
+			alignas(16) double result[2];
+			alignas(16) double period[2];
+			_mm_store_pd(result, batch.N);
+			_mm_store_pd(period, batch.Period);
+
+			const u32 lanes = count - i < 2 ? count - i : 2;
+			for (u32 lane = 0; lane < lanes; lane++)
+			{
+				out[i + lane] = (float) result[lane] / maxIter;
+				periods[i + lane] = (u32) period[lane];
+				interior += (interiorLanes >> lane) & 1;
+			}
+			if (states)
+			{
+				alignas(16) double fields[8 * 2];
+				_mm_store_pd(fields, batch.Zx.Hi);
+				_mm_store_pd(fields + 2, batch.Zy.Hi);
+				_mm_store_pd(fields + 2 * 2, batch.SavedX.Hi);
+				_mm_store_pd(fields + 3 * 2, batch.SavedY.Hi);
+				_mm_store_pd(fields + 4 * 2, batch.Zx.Lo);
+				_mm_store_pd(fields + 5 * 2, batch.Zy.Lo);
+				_mm_store_pd(fields + 6 * 2, batch.SavedX.Lo);
+				_mm_store_pd(fields + 7 * 2, batch.SavedY.Lo);
+				for (u32 lane = 0; lane < lanes; lane++)
+				{
+					if (result[lane] >= (double) view.MaxIterations && period[lane] == 0.0)
+						states[i + lane] = LaneState(fields, 2, lane);
+				}
+			}
+		}
+		return interior;
+	}
+
+	u32 Sse2KernelFloat(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Sse2Float(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Sse2GatherFloat(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Sse2Float(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Sse2KernelDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Sse2Double(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Sse2GatherDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Sse2Double(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Sse2KernelDoubleDouble(const FractalView &view, u32 x, u32 y, u32 count, float *out, u32 *periods)
+	{
+		return Sse2DoubleDouble(view, x, y, nullptr, nullptr, count, out, periods, 0, nullptr);
+	}
+	u32 Sse2GatherDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, float *out, u32 *periods)
+	{
+		return Sse2DoubleDouble(view, 0, 0, xs, ys, count, out, periods, 0, nullptr);
+	}
+
+	u32 Sse2ResumeFloat(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Sse2Float(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 Sse2ResumeDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Sse2Double(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+	u32 Sse2ResumeDoubleDouble(const FractalView &view, const u32 *xs, const u32 *ys, u32 count, u32 start, EscapeState *states, float *out, u32 *periods)
+	{
+		return Sse2DoubleDouble(view, 0, 0, xs, ys, count, out, periods, start, states);
+	}
+}
+
+namespace EscapeKernels
+{
+	const EscapeKernel *Sse2()
+	{
+		static const EscapeKernel kernel = { "SSE2",
+			&Sse2KernelFloat, &Sse2KernelDouble, &Sse2KernelDoubleDouble,
+			&Sse2GatherFloat, &Sse2GatherDouble, &Sse2GatherDoubleDouble,
+			&Sse2ResumeFloat, &Sse2ResumeDouble, &Sse2ResumeDoubleDouble };
+		return &kernel;
+	}
+}
+
+#else
+
+namespace EscapeKernels
+{
+	const EscapeKernel *Sse2()
+	{
+		return nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "FloatExp.h"
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+
+FloatExp FloatExp::Parse(const char *text)
+{
+	const char *marker = text;
+	while (*marker && *marker != 'e' && *marker != 'E')
+		marker++;
+
+	// Within double's range strtod already rounds correctly.
+	const long exponent10 = *marker ? std::strtol(marker + 1, nullptr, 10) : 0;
+	if (std::labs(exponent10) <= 300)
+		return FloatExp(std::strtod(text, nullptr));
+
+	// Otherwise 10^k = 2^(k log2 10): an exact power of two times a factor
+	// in [1, 2). The product k log2 10 carries ~1e-16 relative error, so the
+	// result is good to ~12 digits at 1e1000 -- plenty for a zoom factor.
+	const double mantissa = std::strtod(std::string(text, marker).c_str(), nullptr);
+	const double bits = (double) exponent10 * std::log2(10.0);
+	const double whole = std::floor(bits);
+	return FloatExp(mantissa) * FromParts(std::exp2(bits - whole), (int) whole);
+}
+
+double FloatExp::ToDouble() const
+{
+	return std::ldexp(m_Mantissa, m_Exponent);
+}
+
+void FloatExp::Format(char *buffer, size_t size, int digits) const
+{
+	const double value = ToDouble();
+	if (IsZero() || (std::fabs(value) >= DBL_MIN && std::fabs(value) <= DBL_MAX))
+	{
+		std::snprintf(buffer, size, "%.*e", digits, value);
+		return;
+	}
+
+	const double log10 = Log2() * std::log10(2.0);
+	int exponent10 = (int) std::floor(log10);
+	double mantissa = std::pow(10.0, log10 - exponent10);
+	// Rounding to `digits` may carry into the next power of ten.
+	if (mantissa >= 10.0 - 0.5 * std::pow(10.0, -digits))
+	{
+		mantissa /= 10.0;
+		exponent10++;
+	}
+	std::snprintf(buffer, size, "%s%.*fe%+d", m_Mantissa < 0.0 ? "-" : "", digits, mantissa, exponent10);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Core.h"
+
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+
+// Extended-range float: a double mantissa normalized to [1, 2) (or exactly 0)
+// times 2^exponent with a 32-bit exponent, so values far outside double's
+// ~1e+-308 keep all 53 bits. Each operation is the double one plus a few
+// integer ops to renormalize -- several times slower than a bare double, so
+// it is only used where doubles would run out of range: the zoom itself, and
+// the deltas, series coefficients and BLA bounds past ~1e270 of zoom.
+//
+// ToDouble() is deliberately out of line: the SIMD kernel TUs need it but
+// must not instantiate inline code shared with other TUs (see CMakeLists.txt).
+class FloatExp
+{
+public:
+	FloatExp() = default;
+	FloatExp(double value) { Set(value, 0); }
+
+	static FloatExp FromParts(double mantissa, int exponent)
+	{
+		FloatExp result;
+		result.Set(mantissa, exponent);
+		return result;
+	}
+	static constexpr FloatExp Exp2(int exponent) { return FloatExp(1.0, exponent, 0); }
+
+	// Decimal like strtod ("1.5e-4", "2e1000"), with no limit on the exponent.
+	static FloatExp Parse(const char *text);
+
+	double GetMantissa() const { return m_Mantissa; }
+	int GetExponent() const { return m_Exponent; }
+	bool IsZero() const { return m_Mantissa == 0.0; }
+
+	// Rounds to double; 0 / +-inf outside its range.
+	double ToDouble() const;
+	// log2 |x|, -inf for 0.
+	double Log2() const { return IsZero() ? -INFINITY : (double) m_Exponent + std::log2(std::fabs(m_Mantissa)); }
+	// printf("%.*e") style, "1.234e+1000" past double's range.
+	void Format(char *buffer, size_t size, int digits = 3) const;
+
+	FloatExp Abs() const { return FloatExp(std::fabs(m_Mantissa), m_Exponent, 0); }
+	FloatExp Sqrt() const
+	{
+		// Halve an even exponent; an odd one leaves a factor 2 in the root.
+		if (m_Exponent & 1)
+			return FromParts(std::sqrt(2.0 * m_Mantissa), (m_Exponent - 1) / 2);
+		return FromParts(std::sqrt(m_Mantissa), m_Exponent / 2);
+	}
+
+	FloatExp operator-() const { return FloatExp(-m_Mantissa, m_Exponent, 0); }
+
+	friend FloatExp operator+(const FloatExp &a, const FloatExp &b)
+	{
+		// Past 64 bits apart the smaller operand can't touch the result.
+		const int difference = a.m_Exponent - b.m_Exponent;
+		if (difference > 64)
+			return a;
+		if (difference < -64)
+			return b;
+		return difference >= 0 ?
+			FromParts(a.m_Mantissa + b.m_Mantissa * Pow2(-difference), a.m_Exponent) :
+			FromParts(a.m_Mantissa * Pow2(difference) + b.m_Mantissa, b.m_Exponent);
+	}
+	friend FloatExp operator-(const FloatExp &a, const FloatExp &b) { return a + -b; }
+	friend FloatExp operator*(const FloatExp &a, const FloatExp &b)
+	{
+		return FromParts(a.m_Mantissa * b.m_Mantissa, a.m_Exponent + b.m_Exponent);
+	}
+	friend FloatExp operator/(const FloatExp &a, const FloatExp &b)
+	{
+		return FromParts(a.m_Mantissa / b.m_Mantissa, a.m_Exponent - b.m_Exponent);
+	}
+	FloatExp &operator+=(const FloatExp &other) { return *this = *this + other; }
+	FloatExp &operator-=(const FloatExp &other) { return *this = *this - other; }
+	FloatExp &operator*=(const FloatExp &other) { return *this = *this * other; }
+	FloatExp &operator/=(const FloatExp &other) { return *this = *this / other; }
+
+	friend bool operator==(const FloatExp &a, const FloatExp &b) { return a.m_Mantissa == b.m_Mantissa && a.m_Exponent == b.m_Exponent; }
+	friend bool operator!=(const FloatExp &a, const FloatExp &b) { return !(a == b); }
+	friend bool operator<(const FloatExp &a, const FloatExp &b) { return (a - b).m_Mantissa < 0.0; }
+	friend bool operator>(const FloatExp &a, const FloatExp &b) { return b < a; }
+	friend bool operator<=(const FloatExp &a, const FloatExp &b) { return !(b < a); }
+	friend bool operator>=(const FloatExp &a, const FloatExp &b) { return !(a < b); }
+
+private:
+	// Zero carries an exponent far below any real value so that additions
+	// pick the other operand without a special case. Half of INT_MIN leaves
+	// room for the sum of two of them in a product.
+	static constexpr int ZeroExponent = INT_MIN / 2;
+
+	constexpr FloatExp(double normalizedMantissa, int exponent, int)
+		: m_Mantissa(normalizedMantissa), m_Exponent(exponent)
+	{
+	}
+
+	// 2^exponent for -1022 <= exponent <= 1023, built from its bits.
+	static double Pow2(int exponent)
+	{
+		const u64 bits = (u64) (exponent + 1023) << 52;
+		double result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	void Set(double mantissa, int exponent)
+	{
+		u64 bits;
+		std::memcpy(&bits, &mantissa, sizeof(bits));
+		int biased = (int) ((bits >> 52) & 0x7FF);
+		if (biased == 0)
+		{
+			if (mantissa == 0.0)
+			{
+				m_Mantissa = 0.0;
+				m_Exponent = ZeroExponent;
+				return;
+			}
+			// Subnormal: scale into the normal range first.
+			mantissa *= 0x1p64;
+			exponent -= 64;
+			std::memcpy(&bits, &mantissa, sizeof(bits));
+			biased = (int) ((bits >> 52) & 0x7FF);
+		}
+		if (biased == 0x7FF)
+		{
+			m_Mantissa = mantissa;   // inf / NaN pass through
+			m_Exponent = exponent;
+			return;
+		}
+
+		bits = (bits & ~(0x7FFull << 52)) | (1023ull << 52);
+		std::memcpy(&m_Mantissa, &bits, sizeof(m_Mantissa));
+		m_Exponent = exponent + biased - 1023;
+	}
+
+private:
+	double m_Mantissa = 0.0;
+	int m_Exponent = ZeroExponent;
+};
+
+// Extended-range counterpart of dvec2.
+struct FloatExpVec2
+{
+	FloatExp x, y;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Core.h"
+#include "FloatExp.h"
+
+
+// fp32 precision floor: pixel spacing 1/Z must stay above the smallest
+// representable delta at |c| ~ 2, i.e. FLT_EPSILON * 2 ~= 2.4e-7. That gives
+// Z <= ~4.2e6 as the strict ceiling; we sit slightly past it (mirroring the
+// original `dvec2` value's 1.5x stretch over the fp64 floor) and accept some
+// visible pixelation at maximum zoom. Deeper zooms switch to emulated
+// double-float in the shaders and fp64 / double-double on the CPU.
+static const double MaxZoomLevel = 5.0e6;
+// The same floor for the shaders' float-float pairs (~48 significant bits,
+// strict ceiling ~1.4e14), with headroom for their slightly inexact products.
+// Deeper Mandelbrot zooms switch to perturbation theory, see Perturbation.h.
+static const double MaxFloatFloatZoomLevel = 1.0e12;
+// fp64 on the CPU (strict ceiling ~2.2e15).
+static const double MaxDoubleZoomLevel = 1.0e13;
+// Double-double on the CPU (~106 bits, strict ceiling ~1e31). Only the Julia
+// set goes this deep without perturbation.
+static const double MaxDoubleDoubleZoomLevel = 1.0e28;
+// Perturbation stores the view centre in BigFixed and iterates deltas in
+// doubles, switching to FloatExp where those would underflow, so the range
+// is open-ended; this cap (~1e1000) only bounds the BigFixed cost of the
+// reference orbit.
+static constexpr FloatExp MaxDeepZoomLevel = FloatExp::Exp2(3322);
+
+// Order matches the "Current Fractal" combo box in the Settings window.
+enum class FractalType : int
+{
+	Mandelbrot = 0,
+	JuliaSet   = 1
+};
+
+// Arithmetic used by the CPU escape kernels. Float reproduces the fragment
+// shaders bit for bit; Double pushes the CPU path's useful zoom range out to
+// ~1e13 at roughly half the SIMD width; DoubleDouble to ~1e28 at roughly a
+// tenth of Double's speed. Order matches the CPU precision combo box.
+enum class Precision : int
+{
+	Float        = 0,
+	Double       = 1,
+	DoubleDouble = 2
+};
+
+// Narrowest CPU arithmetic that still resolves single pixels at `zoom`.
+inline Precision RequiredPrecision(const FloatExp &zoom)
+{
+	if (zoom <= MaxZoomLevel)
+		return Precision::Float;
+	if (zoom <= MaxDoubleZoomLevel)
+		return Precision::Double;
+	return Precision::DoubleDouble;
+}
+
+// Closed-form interior test for the two largest components of the Mandelbrot
+// set, the main cardioid  q (q + x - 1/4) <= y^2 / 4  with
+// q = (x - 1/4)^2 + y^2, and the period-2 disc  |c + 1| <= 1/4. Returns the
+// period of the component c lies in (1 or 2), 0 if neither; points inside
+// never escape, so callers skip straight to the MaxIterations result. Same
+// operation order as MainComponentPeriod() in Mandelbrot.glsl, so the float
+// instantiation classifies exactly the pixels the shader does. A positive
+// `margin` only accepts points inside by at least that much, for callers
+// whose c is itself only approximate. The SIMD kernels carry their own
+// vector copies (see CMakeLists.txt on sharing inline code with them).
+template<typename T>
+int MainComponentPeriod(T cx, T cy, T margin = T(0))
+{
+	const T y2 = cy * cy;
+	const T x = cx - T(0.25);
+	const T q = x * x + y2;
+	if (q * (q + x) + margin <= T(0.25) * y2)
+		return 1;
+	const T x1 = cx + T(1);
+	return x1 * x1 + y2 + margin <= T(0.0625) ? 2 : 0;
+}
+
+// Cycle detection in the escape loops (Brent): z is saved after iterations
+// 1, 2, 4, 8, ... and an orbit that comes back to within this many pixels
+// (divided by the zoom) of the saved value has settled into an attracting
+// cycle. Its distance from the save is the period; the pixel is interior.
+static const double PeriodTolerance = 1.0e-3;
+// Comparisons only run over the first 1 / 2^PeriodCheckShift of each save
+// interval, k - savedAt <= savedAt >> PeriodCheckShift. A cycle of period p
+// is still found, with the exact period, once the interval reaches
+// 2^PeriodCheckShift p; escaping orbits only pay for an eighth of the checks.
+static const int PeriodCheckShift = 3;
+
+// Everything needed to reproduce one frame of Mandelbrot.glsl / JuliaSet.glsl.
+// Each field mirrors the uniform of the same meaning, so a view built from the
+// Application state maps each pixel to exactly the same point in the complex
+// plane as gl_FragCoord does in the shaders.
+struct FractalView
+{
+	FractalType Type = FractalType::Mandelbrot;
+	int MaxIterations = 100;         // u_MaxIterations
+	u32 Width = 0, Height = 0;       // u_ScreenSize (framebuffer pixels)
+	FloatExp Zoom = 400.0;           // u_Zoom (extended: deep zooms pass 1e308)
+	dvec2 Offset = { 0.0, 0.0 };     // u_Offset
+	dvec2 OffsetLo = { 0.0, 0.0 };   // u_OffsetLo: Offset's rounding error, for double-float / double-double
+	dvec2 JuliaC = { 0.0, 0.0 };     // u_RealComponent / u_ImaginaryComponent
+};
+
+inline bool operator==(const FractalView &a, const FractalView &b)
+{
+	return a.Type == b.Type && a.MaxIterations == b.MaxIterations && a.Width == b.Width && a.Height == b.Height &&
+		a.Zoom == b.Zoom && a.Offset.x == b.Offset.x && a.Offset.y == b.Offset.y &&
+		a.OffsetLo.x == b.OffsetLo.x && a.OffsetLo.y == b.OffsetLo.y && a.JuliaC.x == b.JuliaC.x && a.JuliaC.y == b.JuliaC.y;
+}
+
+inline bool operator!=(const FractalView &a, const FractalView &b)
+{
+	return !(a == b);
+}
+
+// Same view apart from where the camera is.
+inline bool IsTranslationOf(const FractalView &a, const FractalView &b)
+{
+	return a.Type == b.Type && a.MaxIterations == b.MaxIterations && a.Width == b.Width && a.Height == b.Height &&
+		a.Zoom == b.Zoom && a.JuliaC.x == b.JuliaC.x && a.JuliaC.y == b.JuliaC.y;
+}
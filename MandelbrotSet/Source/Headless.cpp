@@ -0,0 +1,729 @@
+#include "Headless.h"
+
+#include "ColorMap.h"
+#include "CpuRenderer.h"
+#include "IterationTuner.h"
+#include "JuliaPreview.h"
+#include "TileStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <stb_image_write.h>
+
+
+namespace
+{
+	struct Options
+	{
+		FractalView View;
+		const char *OffsetX = "0";
+		const char *OffsetY = "0";
+		Precision KernelPrecision = Precision::Float;
+		u32 Threads = 0;
+		vec4 Color = { 0.5f, 1.0f, 0.7f, 1.0f };
+		const char *Output = "Mandelbrot.png";
+		const char *RawOutput = nullptr;
+		bool InteriorByPeriod = false;
+		const EscapeKernel *Kernel = nullptr;
+		bool Benchmark = false;
+		bool DepthBenchmark = false;
+		bool BignumBenchmark = false;
+		bool StrategyBenchmark = false;
+		bool BlaCheck = false;
+		bool JuliaPreview = false;
+		bool AutoIterations = false;
+		CpuStrategy Strategy = CpuStrategy::Full;
+		bool Series = true;
+		bool Bla = true;
+		u32 GlitchPasses = CpuRenderer::DefaultGlitchPasses;
+		const char *StoreDirectory = nullptr;
+		size_t StoreCapacity = TileStore::DefaultCapacity;
+		bool CompactStore = false;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: MandelbrotSet --headless [options]\n"
+			"  --size <w> <h>         output size in pixels (default 1920 1080)\n"
+			"  --iterations <n>       max iterations (default 100)\n"
+			"  --auto-iterations      pick max iterations the way the window's Auto mode\n"
+			"                         does, starting from --iterations\n"
+			"  --zoom <z>             pixels per world unit (default 400), any exponent\n"
+			"  --offset <x> <y>       camera offset, same sign as u_Offset (default 0 0);\n"
+			"                         decimal strings, exact to any number of digits\n"
+			"  --julia <re> <im>      render the Julia set for c = re + im*i\n"
+			"  --miim                 with --julia, only outline the set by inverse\n"
+			"                         iteration, as the window does while c is dragged\n"
+			"  --precision <f|d|dd>   float (matches the shaders), double or double-double;\n"
+			"                         raised automatically when the zoom needs more\n"
+			"  --threads <n>          worker threads (default: one per hardware thread)\n"
+			"  --kernel <name>        force an escape kernel: scalar, sse2, avx2, avx-512\n"
+			"  --output <file.png>    colored image (default Mandelbrot.png)\n"
+			"  --raw <file.f32>       raw normalized iteration buffer, bottom row first\n"
+			"  --color-periods        color interior pixels by the period cycle detection\n"
+			"                         found, as the window's 'Color interior by period'\n"
+			"  --no-series            disable the series approximation at deep zoom\n"
+			"  --no-bla               disable bilinear approximation at deep zoom\n"
+			"  --glitch-passes <n>    glitch correction passes at deep zoom (default 8, 0 = off)\n"
+			"  --subdivide            fill rectangles with a uniform border without iterating\n"
+			"                         them (Mariani-Silver)\n"
+			"  --trace                iterate only the outlines of equal-dwell regions and\n"
+			"                         fill them (boundary tracing)\n"
+			"  --guess                iterate every 32nd row and column, then fill blocks\n"
+			"                         with a uniform border or split them (solid guessing)\n"
+			"  --tile-store <dir>     read and write finished 128x128 tiles in an on-disk\n"
+			"                         store shared with the window and other runs; the\n"
+			"                         view moves by under a pixel onto the tiles' grid\n"
+			"  --store-cap <MB>       size cap of the store's tiles (default 4096); past it\n"
+			"                         new tiles replace the least recently used\n"
+			"  --compact-store        with --tile-store, rewrite the store's most recently\n"
+			"                         used tiles up to --store-cap and exit\n"
+			"  --bench                time every available escape kernel on the view\n"
+			"  --bench-depth          time the perturbation path on the view at zooms\n"
+			"                         from 1e100 to 1e1000 (deltas go extended past ~1e271)\n"
+			"  --bench-bignum         time BigFixed squaring, multiplication and reference\n"
+			"                         orbit iterations from 128 to 16384 bits\n"
+			"  --bench-strategy       time full, subdivided, traced and solid-guessed renders\n"
+			"                         of a set of standard views at --size, --precision and\n"
+			"                         --threads\n"
+			"  --check-bla            render the deep view with and without bilinear\n"
+			"                         approximation, compare both to exact orbits of ~1000\n"
+			"                         sample pixels and fail if BLA misses by more than 2\n"
+			"                         iterations on over 0.25%% more of them\n");
+	}
+
+	bool ParseOptions(int argc, char **argv, Options &options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const char *arg = argv[i];
+			const int remaining = argc - i - 1;
+
+			if (std::strcmp(arg, "--headless") == 0)
+				continue;
+			else if (std::strcmp(arg, "--size") == 0 && remaining >= 2)
+			{
+				options.View.Width = (u32) std::strtoul(argv[++i], nullptr, 10);
+				options.View.Height = (u32) std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(arg, "--iterations") == 0 && remaining >= 1)
+				options.View.MaxIterations = std::atoi(argv[++i]);
+			else if (std::strcmp(arg, "--zoom") == 0 && remaining >= 1)
+				options.View.Zoom = FloatExp::Parse(argv[++i]);
+			else if (std::strcmp(arg, "--offset") == 0 && remaining >= 2)
+			{
+				options.OffsetX = argv[++i];
+				options.OffsetY = argv[++i];
+			}
+			else if (std::strcmp(arg, "--julia") == 0 && remaining >= 2)
+			{
+				options.View.Type = FractalType::JuliaSet;
+				options.View.JuliaC.x = std::strtod(argv[++i], nullptr);
+				options.View.JuliaC.y = std::strtod(argv[++i], nullptr);
+			}
+			else if (std::strcmp(arg, "--precision") == 0 && remaining >= 1)
+			{
+				const char *precision = argv[++i];
+				options.KernelPrecision =
+					std::strcmp(precision, "dd") == 0 ? Precision::DoubleDouble :
+					precision[0] == 'd' ? Precision::Double : Precision::Float;
+			}
+			else if (std::strcmp(arg, "--threads") == 0 && remaining >= 1)
+				options.Threads = (u32) std::strtoul(argv[++i], nullptr, 10);
+			else if (std::strcmp(arg, "--kernel") == 0 && remaining >= 1)
+			{
+				options.Kernel = EscapeKernels::Find(argv[++i]);
+				if (!options.Kernel)
+				{
+					std::fprintf(stderr, "[ERROR] Escape kernel '%s' is not available on this host\n", argv[i]);
+					return false;
+				}
+			}
+			else if (std::strcmp(arg, "--output") == 0 && remaining >= 1)
+				options.Output = argv[++i];
+			else if (std::strcmp(arg, "--raw") == 0 && remaining >= 1)
+				options.RawOutput = argv[++i];
+			else if (std::strcmp(arg, "--color-periods") == 0)
+				options.InteriorByPeriod = true;
+			else if (std::strcmp(arg, "--no-series") == 0)
+				options.Series = false;
+			else if (std::strcmp(arg, "--no-bla") == 0)
+				options.Bla = false;
+			else if (std::strcmp(arg, "--glitch-passes") == 0 && remaining >= 1)
+				options.GlitchPasses = (u32) std::strtoul(argv[++i], nullptr, 10);
+			else if (std::strcmp(arg, "--subdivide") == 0)
+				options.Strategy = CpuStrategy::Subdivision;
+			else if (std::strcmp(arg, "--trace") == 0)
+				options.Strategy = CpuStrategy::BoundaryTrace;
+			else if (std::strcmp(arg, "--auto-iterations") == 0)
+				options.AutoIterations = true;
+			else if (std::strcmp(arg, "--miim") == 0)
+				options.JuliaPreview = true;
+			else if (std::strcmp(arg, "--guess") == 0)
+				options.Strategy = CpuStrategy::SolidGuess;
+			else if (std::strcmp(arg, "--tile-store") == 0 && remaining >= 1)
+				options.StoreDirectory = argv[++i];
+			else if (std::strcmp(arg, "--store-cap") == 0 && remaining >= 1)
+				options.StoreCapacity = (size_t) std::strtoull(argv[++i], nullptr, 10) << 20;
+			else if (std::strcmp(arg, "--compact-store") == 0)
+				options.CompactStore = true;
+			else if (std::strcmp(arg, "--bench") == 0)
+				options.Benchmark = true;
+			else if (std::strcmp(arg, "--bench-depth") == 0)
+				options.DepthBenchmark = true;
+			else if (std::strcmp(arg, "--bench-bignum") == 0)
+				options.BignumBenchmark = true;
+			else if (std::strcmp(arg, "--bench-strategy") == 0)
+				options.StrategyBenchmark = true;
+			else if (std::strcmp(arg, "--check-bla") == 0)
+				options.BlaCheck = true;
+			else
+			{
+				std::fprintf(stderr, "[ERROR] Unknown or incomplete option '%s'\n", arg);
+				return false;
+			}
+		}
+
+		if (options.View.Width == 0 || options.View.Height == 0 || options.View.Zoom <= 0.0)
+		{
+			std::fprintf(stderr, "[ERROR] Size and zoom must be positive\n");
+			return false;
+		}
+		return true;
+	}
+
+	// With `periods` set, interior pixels with a period are coloured by it.
+	bool WriteImage(const char *path, const std::vector<float> &iterations, u32 width, u32 height, const vec4 &color,
+		const u32 *periods = nullptr)
+	{
+		std::vector<unsigned char> pixels((size_t) width * height * 3u);
+		for (size_t i = 0; i < iterations.size(); i++)
+		{
+			const vec3 rgb = periods && iterations[i] >= 1.0f && periods[i] > 0 ?
+				PeriodToColor(periods[i]) : MapToColor(iterations[i], color);
+			pixels[i * 3 + 0] = (unsigned char) (rgb.x * 255.0f + 0.5f);
+			pixels[i * 3 + 1] = (unsigned char) (rgb.y * 255.0f + 0.5f);
+			pixels[i * 3 + 2] = (unsigned char) (rgb.z * 255.0f + 0.5f);
+		}
+
+		// The buffer is bottom-up like glReadPixels; PNG expects top-down.
+		stbi_flip_vertically_on_write(1);
+		return stbi_write_png(path, (int) width, (int) height, 3, pixels.data(), 0) != 0;
+	}
+
+	const char *PrecisionName(Precision precision)
+	{
+		switch (precision)
+		{
+			case Precision::Double:       return "double";
+			case Precision::DoubleDouble: return "double-double";
+			default:                      return "float";
+		}
+	}
+
+	bool WriteRaw(const char *path, const std::vector<float> &iterations)
+	{
+		FILE *file = std::fopen(path, "wb");
+		if (!file)
+			return false;
+
+		const size_t written = std::fwrite(iterations.data(), sizeof(float), iterations.size(), file);
+		std::fclose(file);
+		return written == iterations.size();
+	}
+
+	int RunBenchmark(const Options &options)
+	{
+		std::vector<const EscapeKernel *> kernels = EscapeKernels::Available();
+		if (options.Kernel)
+			kernels = { options.Kernel };
+
+		CpuRenderer renderer(options.Threads);
+		std::printf("%ux%u, %d iterations, %u threads\n",
+			options.View.Width, options.View.Height, options.View.MaxIterations, renderer.GetThreadCount());
+		std::printf("%-10s %14s %14s %14s\n", "Kernel", "float Mpix/s", "double Mpix/s", "dd Mpix/s");
+
+		for (const EscapeKernel *kernel : kernels)
+		{
+			renderer.SetKernel(*kernel);
+
+			// Best of three, so a stray page fault or a thread that woke up
+			// late does not decide the result.
+			double best[3] = { 0.0, 0.0, 0.0 };
+			for (int precision = 0; precision < 3; precision++)
+			{
+				for (int run = 0; run < 3; run++)
+				{
+					renderer.Render(options.View, (Precision) precision);
+					if (renderer.GetStats().MegapixelsPerSecond > best[precision])
+						best[precision] = renderer.GetStats().MegapixelsPerSecond;
+				}
+			}
+			std::printf("%-10s %14.2f %14.2f %14.2f\n", kernel->Name, best[0], best[1], best[2]);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Same view, offset and settings at increasing depth, so the cost of the
+	// extended-range deltas shows up next to the plain double ones. Orbit
+	// time is listed separately: it grows with the BigFixed precision alone.
+	int RunDepthBenchmark(const Options &options)
+	{
+		static const char *const Depths[] = { "1e100", "1e200", "1e260", "1e280", "1e300", "1e400", "1e700", "1e1000" };
+
+		CpuRenderer renderer(options.Threads);
+		std::printf("%ux%u, %d iterations, %u threads\n",
+			options.View.Width, options.View.Height, options.View.MaxIterations, renderer.GetThreadCount());
+		std::printf("%-8s %-8s %6s %10s %8s %10s %10s %9s\n",
+			"Zoom", "Deltas", "Bits", "Orbit ms", "Skipped", "Render ms", "Mpix/s", "Slowdown");
+
+		double baseline = 0.0;
+		for (const char *depth : Depths)
+		{
+			FractalView view = options.View;
+			view.Zoom = FloatExp::Parse(depth);
+
+			const u32 limbs = BigFixed::LimbsForZoom(view.Zoom);
+			const BigVec2 offset = { BigFixed::FromString(options.OffsetX, limbs), BigFixed::FromString(options.OffsetY, limbs) };
+			view.Offset = offset.ToDouble();
+			view.OffsetLo = offset.ToDoubleRemainder();
+
+			Perturbation perturbation;
+			perturbation.SetSeriesEnabled(options.Series);
+			perturbation.SetBlaEnabled(options.Bla);
+			perturbation.Update(view, offset);
+
+			double best = 0.0;
+			for (int run = 0; run < 3; run++)
+			{
+				renderer.Render(view, Precision::Double, &perturbation);
+				if (run == 0 || renderer.GetStats().Milliseconds < best)
+					best = renderer.GetStats().Milliseconds;
+			}
+			if (baseline == 0.0)
+				baseline = best;
+
+			const bool extended = (FloatExp(1.0) / view.Zoom).GetExponent() < Perturbation::DoubleDeltaExponent;
+			std::printf("%-8s %-8s %6u %10.2f %8d %10.2f %10.2f %8.2fx\n",
+				depth, extended ? "extended" : "double", limbs * 32, perturbation.GetOrbitMilliseconds(),
+				perturbation.GetSeriesSkip(), best, (double) view.Width * view.Height / (best * 1000.0),
+				baseline > 0.0 ? best / baseline : 0.0);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Calls fn(count) with doubling counts until one batch takes 100 ms;
+	// returns the time per unit of that batch in nanoseconds.
+	template<typename Fn>
+	double TimePerUnit(Fn &&fn)
+	{
+		for (u32 count = 1;; count *= 2)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			fn(count);
+			const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			if (ns >= 1.0e8)
+				return ns / (double) count;
+		}
+	}
+
+	// Reference orbit cost against precision. c = -0.1 + 0.6i lies in the
+	// main cardioid, so the orbit never escapes, and neither coordinate is
+	// a short binary fraction, so every limb stays busy.
+	int RunBignumBenchmark()
+	{
+		static const u32 Bits[] = { 128, 256, 512, 1024, 2048, 4096, 8192, 16384 };
+
+		std::printf("Karatsuba from %u limbs\n", BigFixed::KaratsubaCutoff);
+		std::printf("%6s %6s %12s %12s %14s\n", "Bits", "Limbs", "Square ns", "Multiply ns", "Iterations/s");
+
+		for (u32 bits : Bits)
+		{
+			const u32 limbs = bits / 32;
+			const BigFixed cx = BigFixed::FromString("-0.1", limbs);
+			const BigFixed cy = BigFixed::FromString("0.6", limbs);
+
+			// Squaring the operand in place would drift to 0; squaring a
+			// copy of it keeps every run on the same dense limbs.
+			std::vector<u32> scratch = BigFixed::MakeScratch(limbs);
+			BigFixed result(0.0, limbs);
+			const double square = TimePerUnit([&](u32 count)
+			{
+				for (u32 i = 0; i < count; i++)
+					BigFixed::Square(cy, result, scratch);
+			});
+			const double multiply = TimePerUnit([&](u32 count)
+			{
+				for (u32 i = 0; i < count; i++)
+					BigFixed::Multiply(cx, cy, result, scratch);
+			});
+
+			std::vector<dvec2> orbit;
+			const double iteration = TimePerUnit([&](u32 count)
+			{
+				Perturbation::ComputeOrbit(cx, cy, (int) count, orbit);
+			});
+
+			std::printf("%6u %6u %12.1f %12.1f %14.0f\n", bits, limbs, square, multiply, 1.0e9 / iteration);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// The same views rendered with every strategy. "Differing" counts the
+	// pixels a strategy filled wrong against the full render.
+	int RunStrategyBenchmark(const Options &options)
+	{
+		struct StandardView
+		{
+			const char *Name;
+			FractalType Type;
+			double Zoom;
+			dvec2 Offset;
+			int MaxIterations;
+		};
+		static const StandardView Views[] = {
+			{ "Overview",  FractalType::Mandelbrot, 400.0,  { 0.5, 0.0 },                500 },
+			{ "Seahorse",  FractalType::Mandelbrot, 2.0e4,  { 0.745, -0.11 },            1000 },
+			{ "Elephant",  FractalType::Mandelbrot, 2.0e4,  { -0.28, -0.008 },           1000 },
+			{ "Bulb",      FractalType::Mandelbrot, 2.0e4,  { 0.1226, -0.7449 },         5000 },
+			{ "Spiral",    FractalType::Mandelbrot, 1.0e7,  { 0.743643887, -0.131825904 }, 5000 },
+			{ "Deep",      FractalType::Mandelbrot, 1.0e9,  { 0.743643887037151, -0.131825904205330 }, 5000 },
+			{ "Julia",     FractalType::JuliaSet,   400.0,  { 0.0, 0.0 },                1000 },
+		};
+
+		CpuRenderer renderer(options.Threads);
+		if (options.Kernel)
+			renderer.SetKernel(*options.Kernel);
+		std::printf("%ux%u, %s, %u threads\n",
+			options.View.Width, options.View.Height, PrecisionName(options.KernelPrecision), renderer.GetThreadCount());
+		std::printf("%-10s %8s %9s | %9s %8s %8s %9s | %9s %8s %8s %9s | %9s %8s %8s %9s\n", "View", "Iter", "Full ms",
+			"Subdiv ms", "Speedup", "Guessed", "Differing", "Trace ms", "Speedup", "Filled", "Differing",
+			"Guess ms", "Speedup", "Guessed", "Differing");
+
+		for (const StandardView &standard : Views)
+		{
+			FractalView view = options.View;
+			view.Type = standard.Type;
+			view.Zoom = standard.Zoom;
+			view.Offset = standard.Offset;
+			view.OffsetLo = { 0.0, 0.0 };
+			view.MaxIterations = standard.MaxIterations;
+			if (standard.Type == FractalType::JuliaSet)
+				view.JuliaC = { -0.8, 0.156 };
+			const Precision precision = std::max(options.KernelPrecision, RequiredPrecision(view.Zoom));
+
+			static const CpuStrategy Strategies[] = {
+				CpuStrategy::Full, CpuStrategy::Subdivision, CpuStrategy::BoundaryTrace, CpuStrategy::SolidGuess };
+			constexpr int StrategyCount = sizeof(Strategies) / sizeof(Strategies[0]);
+			double best[StrategyCount] = {};
+			double guessed[StrategyCount] = {};
+			u64 differing[StrategyCount] = {};
+			std::vector<float> full;
+			for (int s = 0; s < StrategyCount; s++)
+			{
+				renderer.SetStrategy(Strategies[s]);
+				for (int run = 0; run < 3; run++)
+				{
+					renderer.Render(view, precision);
+					if (run == 0 || renderer.GetStats().Milliseconds < best[s])
+						best[s] = renderer.GetStats().Milliseconds;
+				}
+				if (Strategies[s] == CpuStrategy::Full)
+					full = renderer.GetIterations();
+
+				const std::vector<float> &iterations = renderer.GetIterations();
+				for (size_t i = 0; i < full.size(); i++)
+					differing[s] += full[i] != iterations[i];
+				const CpuRenderStats &stats = renderer.GetStats();
+				guessed[s] = 100.0 * (double) stats.GuessedPixels / (double) stats.Pixels;
+			}
+
+			std::printf("%-10s %8d %9.2f", standard.Name, view.MaxIterations, best[0]);
+			for (int s = 1; s < StrategyCount; s++)
+			{
+				std::printf(" | %9.2f %7.2fx %7.1f%% %9llu",
+					best[s], best[s] > 0.0 ? best[0] / best[s] : 0.0, guessed[s], (unsigned long long) differing[s]);
+			}
+			std::printf("\n");
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Exact escape count of the pixel at (x, y): its own orbit iterated in
+	// BigFixed, with the first |z|^2 > 16 counted like IsFinished() does.
+	int ExactIterations(const FractalView &view, const BigVec2 &offset, u32 x, u32 y, std::vector<dvec2> &orbit)
+	{
+		const u32 limbs = BigFixed::LimbsForZoom(view.Zoom);
+		const dvec2 pixel = { x + 0.5 - view.Width / 2.0, y + 0.5 - view.Height / 2.0 };
+		const BigFixed cx = BigFixed(FloatExp(pixel.x) / view.Zoom, limbs) - offset.x;
+		const BigFixed cy = BigFixed(FloatExp(pixel.y) / view.Zoom, limbs) - offset.y;
+		Perturbation::ComputeOrbit(cx, cy, view.MaxIterations, orbit);
+		for (size_t n = 1; n < orbit.size(); n++)
+		{
+			if (orbit[n].x * orbit[n].x + orbit[n].y * orbit[n].y > 16.0)
+				return (int) n - 1;
+		}
+		return view.MaxIterations;
+	}
+
+	// Where the orbit is chaotic enough for the last bit of a delta to decide
+	// the escape, even --no-bla renders are off, so both renders are checked
+	// against exactly iterated orbits on a grid of sample pixels, and BLA may
+	// only add a few more misses than the exact double steps already have.
+	int RunBlaCheck(const Options &options, const BigVec2 &offset)
+	{
+		constexpr int Tolerance = 2;
+		constexpr u32 Samples = 1024;
+		constexpr double MaxExtraShare = 2.5e-3;
+
+		if (!Perturbation::IsRequired(options.View))
+		{
+			std::fprintf(stderr, "[ERROR] --check-bla needs a Mandelbrot view deep enough for perturbation\n");
+			return EXIT_FAILURE;
+		}
+
+		const FractalView &view = options.View;
+		CpuRenderer renderer(options.Threads);
+		renderer.SetGlitchPasses(options.GlitchPasses);
+
+		std::vector<float> iterations[2];
+		double milliseconds[2] = {};
+		for (int bla = 0; bla < 2; bla++)
+		{
+			Perturbation perturbation;
+			perturbation.SetSeriesEnabled(options.Series);
+			perturbation.SetBlaEnabled(bla == 1);
+			perturbation.Update(view, offset);
+			renderer.Render(view, Precision::Double, &perturbation);
+			iterations[bla] = renderer.GetIterations();
+			milliseconds[bla] = renderer.GetStats().Milliseconds;
+		}
+
+		u64 differing = 0;
+		for (size_t i = 0; i < iterations[0].size(); i++)
+			differing += iterations[1][i] != iterations[0][i];
+
+		// Sample pixels in the middle of each grid cell.
+		const u32 step = std::max(1u, (u32) std::lround(std::sqrt((double) view.Width * view.Height / Samples)));
+		std::vector<u32> samples;
+		for (u32 y = step / 2; y < view.Height; y += step)
+		{
+			for (u32 x = step / 2; x < view.Width; x += step)
+				samples.push_back(y * view.Width + x);
+		}
+
+		std::vector<int> exact(samples.size());
+		std::atomic<size_t> next { 0 };
+		auto worker = [&]()
+		{
+			std::vector<dvec2> orbit;
+			for (size_t i = next++; i < samples.size(); i = next++)
+				exact[i] = ExactIterations(view, offset, samples[i] % view.Width, samples[i] / view.Width, orbit);
+		};
+		std::vector<std::thread> workers;
+		for (u32 t = 0; t < renderer.GetThreadCount(); t++)
+			workers.emplace_back(worker);
+		for (std::thread &thread : workers)
+			thread.join();
+
+		const double maxIterations = (double) view.MaxIterations;
+		u64 off[2] = {};
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			for (int bla = 0; bla < 2; bla++)
+			{
+				const int rendered = (int) std::lround(iterations[bla][samples[i]] * maxIterations);
+				off[bla] += std::abs(rendered - exact[i]) > Tolerance;
+			}
+		}
+
+		const u64 allowed = off[0] + (u64) (MaxExtraShare * (double) samples.size());
+		std::printf("BLA: %.2f ms, without: %.2f ms (%.2fx); %llu pixels differ between them\n",
+			milliseconds[1], milliseconds[0], milliseconds[1] > 0.0 ? milliseconds[0] / milliseconds[1] : 0.0,
+			(unsigned long long) differing);
+		std::printf("Exact orbits at %zu pixels: %llu off by more than %d iterations with BLA, %llu without\n",
+			samples.size(), (unsigned long long) off[1], Tolerance, (unsigned long long) off[0]);
+		if (off[1] > allowed)
+		{
+			std::fprintf(stderr, "[ERROR] BLA render is off on more than %.2f%% of the sampled pixels beyond the render without it\n",
+				100.0 * MaxExtraShare);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}
+
+int Headless::Run(int argc, char **argv)
+{
+	Options options;
+	options.View.Width = 1920;
+	options.View.Height = 1080;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	const u32 limbs = BigFixed::LimbsForZoom(options.View.Zoom);
+	const BigVec2 offset = { BigFixed::FromString(options.OffsetX, limbs), BigFixed::FromString(options.OffsetY, limbs) };
+	options.View.Offset = offset.ToDouble();
+	options.View.OffsetLo = offset.ToDoubleRemainder();
+
+	TileStore store;
+	if (options.StoreDirectory)
+	{
+		if (!store.Open(options.StoreDirectory))
+			return EXIT_FAILURE;
+		store.SetCapacity(options.StoreCapacity);
+		if (options.CompactStore)
+		{
+			const size_t before = store.GetTileCount();
+			if (!store.Compact(options.StoreCapacity))
+				return EXIT_FAILURE;
+			std::printf("Tile store: compacted %zu slots to %zu tiles, %.1f MB\n",
+				before, store.GetTileCount(), (double) store.GetBytes() / (1024.0 * 1024.0));
+			return EXIT_SUCCESS;
+		}
+
+		// Stored tiles only fit views on their grid; see TileCache.
+		double gridX, gridY;
+		if (TileCache::GetGridOrigin(options.View, gridX, gridY))
+		{
+			const double zoom = options.View.Zoom.ToDouble();
+			options.View.Offset.x += (gridX - std::round(gridX)) / zoom;
+			options.View.Offset.y += (gridY - std::round(gridY)) / zoom;
+		}
+	}
+
+	if (options.Benchmark)
+		return RunBenchmark(options);
+	if (options.DepthBenchmark)
+		return RunDepthBenchmark(options);
+	if (options.BignumBenchmark)
+		return RunBignumBenchmark();
+	if (options.StrategyBenchmark)
+		return RunStrategyBenchmark(options);
+	if (options.BlaCheck)
+		return RunBlaCheck(options, offset);
+
+	if (options.JuliaPreview && options.View.Type == FractalType::JuliaSet)
+	{
+		JuliaPreview preview;
+		preview.Render(options.View);
+		std::printf("%ux%u, inverse iteration: %.2f ms, %llu points\n", preview.GetWidth(), preview.GetHeight(),
+			preview.GetMilliseconds(), (unsigned long long) preview.GetPoints());
+		if (!WriteImage(options.Output, preview.GetIterations(), preview.GetWidth(), preview.GetHeight(), options.Color))
+		{
+			std::fprintf(stderr, "[ERROR] Failed to write image: %s\n", options.Output);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (options.AutoIterations)
+	{
+		// Probes until the cap settles, as the window's GPU path does.
+		IterationTuner tuner;
+		Perturbation perturbation;
+		int steps = 0;
+		for (; steps < 32; steps++)
+		{
+			const bool deep = Perturbation::IsRequired(options.View);
+			if (deep)
+				perturbation.Update(options.View, offset);
+			const IterationSample sample = IterationTuner::Probe(options.View, deep ? &perturbation : nullptr);
+			const int next = tuner.Choose(options.View.Zoom, options.View.MaxIterations, sample);
+			if (next == options.View.MaxIterations)
+				break;
+			options.View.MaxIterations = next;
+		}
+		std::printf("Auto iterations: %d after %d steps, %.1f%% of probes capped, %.0f%% of work\n",
+			options.View.MaxIterations, steps, 100.0 * tuner.GetCappedShare(), 100.0 * tuner.GetCappedWorkShare());
+	}
+
+	CpuRenderer renderer(options.Threads);
+	if (options.Kernel)
+		renderer.SetKernel(*options.Kernel);
+	renderer.SetGlitchPasses(options.GlitchPasses);
+	renderer.SetStrategy(options.Strategy);
+	if (store.IsOpen())
+		renderer.GetTileCache().SetStore(&store);
+
+	// Same switch-over points as the interactive renderer.
+	const Precision required = RequiredPrecision(options.View.Zoom);
+	if (options.KernelPrecision < required)
+		options.KernelPrecision = required;
+
+	if (Perturbation::IsRequired(options.View))
+	{
+		Perturbation perturbation;
+		perturbation.SetSeriesEnabled(options.Series);
+		perturbation.SetBlaEnabled(options.Bla);
+		perturbation.Update(options.View, offset);
+		std::printf("Perturbation: %u-bit reference, %d iterations, series skipped %d, %.2f ms\n",
+			limbs * 32, perturbation.GetReferenceLength() - 1, perturbation.GetSeriesSkip(), perturbation.GetOrbitMilliseconds());
+		if (options.Bla)
+		{
+			const BlaTable &table = perturbation.GetBlaTable();
+			std::printf("BLA: %d levels, %zu steps, built in %.2f ms\n",
+				table.GetLevelCount(), table.GetStepCount(), table.GetBuildMilliseconds());
+		}
+		// Deltas are iterated in fp64 whatever the kernels would have used.
+		options.KernelPrecision = Precision::Double;
+		renderer.Render(options.View, options.KernelPrecision, &perturbation);
+
+		const CpuRenderStats &stats = renderer.GetStats();
+		std::printf("Glitches: %llu pixels, %u passes, %u references, %llu left, %.2f ms\n",
+			(unsigned long long) stats.GlitchedPixels, stats.GlitchPasses, stats.References,
+			(unsigned long long) stats.UnfixedPixels, stats.GlitchMilliseconds);
+	}
+	else
+	{
+		renderer.Render(options.View, options.KernelPrecision);
+	}
+
+	const CpuRenderStats &stats = renderer.GetStats();
+	std::printf("%ux%u, %d iterations, %s/%s, %u threads: %.2f ms, %.2f Mpix/s, %u tiles, %llu steals\n",
+		renderer.GetWidth(), renderer.GetHeight(), options.View.MaxIterations,
+		stats.Kernel, PrecisionName(options.KernelPrecision),
+		renderer.GetThreadCount(), stats.Milliseconds, stats.MegapixelsPerSecond,
+		stats.Tiles, (unsigned long long) stats.Steals);
+	if (options.View.Type == FractalType::Mandelbrot)
+		std::printf("Interior: %llu pixels (%.1f%%) skipped by the cardioid / bulb test\n",
+			(unsigned long long) stats.InteriorPixels, 100.0 * (double) stats.InteriorPixels / (double) stats.Pixels);
+	if (!Perturbation::IsRequired(options.View))
+		std::printf("Periodic: %llu pixels (%.1f%%) settled by cycle detection\n",
+			(unsigned long long) stats.PeriodicPixels, 100.0 * (double) stats.PeriodicPixels / (double) stats.Pixels);
+	if (options.Strategy != CpuStrategy::Full)
+		std::printf("Guessed: %llu pixels (%.1f%%) filled by %s\n",
+			(unsigned long long) stats.GuessedPixels, 100.0 * (double) stats.GuessedPixels / (double) stats.Pixels,
+			options.Strategy == CpuStrategy::Subdivision ? "subdivision" :
+			options.Strategy == CpuStrategy::BoundaryTrace ? "boundary tracing" : "solid guessing");
+	if (store.IsOpen())
+		std::printf("Tile store: %llu of %llu tiles read (%llu px), %zu tiles, %.1f MB\n",
+			(unsigned long long) store.GetHits(), (unsigned long long) store.GetLookups(),
+			(unsigned long long) stats.CachedPixels, store.GetTileCount(), (double) store.GetBytes() / (1024.0 * 1024.0));
+
+	if (!WriteImage(options.Output, renderer.GetIterations(), renderer.GetWidth(), renderer.GetHeight(), options.Color,
+		options.InteriorByPeriod ? renderer.GetPeriods().data() : nullptr))
+	{
+		std::fprintf(stderr, "[ERROR] Failed to write image: %s\n", options.Output);
+		return EXIT_FAILURE;
+	}
+	if (options.RawOutput && !WriteRaw(options.RawOutput, renderer.GetIterations()))
+	{
+		std::fprintf(stderr, "[ERROR] Failed to write raw buffer: %s\n", options.RawOutput);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
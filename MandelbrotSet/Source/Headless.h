@@ -0,0 +1,10 @@
+#pragma once
+
+
+// Command-line renderer for machines without a GPU or display. Selected with
+// `MandelbrotSet --headless [options]`; see PrintUsage() for the options.
+class Headless
+{
+public:
+	static int Run(int argc, char **argv);
+};
@@ -0,0 +1,84 @@
+#include "IterationTuner.h"
+
+#include "EscapeKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+int IterationTuner::GetZoomFloor(const FloatExp &zoom)
+{
+	// 100 at the default zoom of 400, +25 per doubling.
+	const double floor = 100.0 + 25.0 * (zoom.Log2() - std::log2(400.0));
+	return (int) std::clamp(floor, (double) MinIterations, (double) MaxIterations);
+}
+
+IterationSample IterationTuner::SampleBuffer(const std::vector<float> &iterations, const std::vector<u32> &periods,
+	u32 width, u32 height, u32 stride)
+{
+	IterationSample sample;
+	for (u32 y = stride / 2; y < height; y += stride)
+	{
+		for (u32 x = stride / 2; x < width; x += stride)
+		{
+			const size_t pixel = (size_t) y * width + x;
+			sample.Add(iterations[pixel], periods.empty() ? 0 : periods[pixel]);
+		}
+	}
+	return sample;
+}
+
+IterationSample IterationTuner::Probe(const FractalView &view, const Perturbation *perturbation)
+{
+	std::vector<u32> xs, ys;
+	for (u32 y = ProbeSpacing / 2; y < view.Height; y += ProbeSpacing)
+	{
+		for (u32 x = ProbeSpacing / 2; x < view.Width; x += ProbeSpacing)
+		{
+			xs.push_back(x);
+			ys.push_back(y);
+		}
+	}
+
+	const u32 count = (u32) xs.size();
+	std::vector<float> values(count);
+	std::vector<u32> periods(count, 0);
+	if (perturbation)
+	{
+		for (u32 i = 0; i < count; i++)
+			perturbation->IterateSpan(view, xs[i], ys[i], 1, &values[i]);
+	}
+	else if (count > 0)
+	{
+		const EscapeGatherFn gatherFn = EscapeKernels::Default().GetGather(RequiredPrecision(view.Zoom));
+		gatherFn(view, xs.data(), ys.data(), count, values.data(), periods.data());
+	}
+
+	IterationSample sample;
+	for (u32 i = 0; i < count; i++)
+		sample.Add(values[i], periods[i]);
+	return sample;
+}
+
+int IterationTuner::Choose(const FloatExp &zoom, int current, const IterationSample &sample)
+{
+	m_Last = sample;
+
+	int next = current;
+	const double share = RaiseShare * (double) sample.Pixels;
+	if ((double) sample.Capped >= share && ((double) sample.Late >= share || sample.Deepest == 0.0f))
+		next = current * 2;
+	else if (sample.Deepest < 0.125f)
+		next = (int) std::ceil(4.0 * sample.Deepest * current);
+	return std::clamp(next, GetZoomFloor(zoom), MaxIterations);
+}
+
+double IterationTuner::GetCappedShare() const
+{
+	return m_Last.Pixels ? (double) m_Last.Capped / (double) m_Last.Pixels : 0.0;
+}
+
+double IterationTuner::GetCappedWorkShare() const
+{
+	return m_Last.Work > 0.0 ? (double) m_Last.Capped / m_Last.Work : 0.0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Core.h"
+#include "Fractal.h"
+#include "Perturbation.h"
+
+#include <vector>
+
+
+// Escape statistics of some of a frame's pixels, in the renderers' normalized
+// form (n / MaxIterations, 1 for pixels that never escaped).
+struct IterationSample
+{
+	u64 Pixels = 0;
+	// Ran out of iterations without cycle detection settling them; some of
+	// these would escape under a higher cap.
+	u64 Capped = 0;
+	// Escaped in the upper half of the cap.
+	u64 Late = 0;
+	// Largest value among the pixels that escaped.
+	float Deepest = 0.0f;
+	// Sum of all values: roughly the iterations spent, in units of the cap
+	// (cycle detection ends some interior pixels early).
+	double Work = 0.0;
+
+	void Add(float value, u32 period)
+	{
+		Pixels++;
+		Work += value;
+		if (value >= 1.0f)
+		{
+			Capped += period == 0;
+			return;
+		}
+		Late += value > 0.5f;
+		Deepest = value > Deepest ? value : Deepest;
+	}
+};
+
+// Automatic MaxIterations. The cap never drops below a floor that grows with
+// the zoom's log2, as features at depth take more iterations to resolve.
+// Above the floor it follows the last frame. It doubles while at least
+// RaiseShare of the pixels are capped and as many escaped late: the escape
+// counts run on past the cap, so a higher one resolves more of the capped
+// pixels. Capped pixels with nothing escaping late are interior the cycle
+// detection missed, and stay capped whatever the cap, unless nothing
+// escaped at all: a view that deep past the cap keeps doubling until its
+// first pixels escape. The cap falls back to 4x the deepest escape once
+// that is under an eighth of it. Neither rule undoes the other, so the cap
+// settles after a few frames.
+class IterationTuner
+{
+public:
+	static constexpr int MinIterations = 100;
+	static constexpr int MaxIterations = 1 << 17;
+	// Share of the sampled pixels that have to be capped, and escape late,
+	// to raise the cap.
+	static constexpr double RaiseShare = 1.0e-3;
+	// Pixel spacing of Probe()'s grid.
+	static constexpr u32 ProbeSpacing = 32;
+
+	static int GetZoomFloor(const FloatExp &zoom);
+
+	// Every `stride`-th pixel of every `stride`-th row of a CPU render.
+	static IterationSample SampleBuffer(const std::vector<float> &iterations, const std::vector<u32> &periods,
+		u32 width, u32 height, u32 stride);
+	// Iterates a ProbeSpacing grid of `view` itself, for renders whose
+	// results stay on the GPU. `perturbation` must be set, Update()d for
+	// `view`, when Perturbation::IsRequired(view).
+	static IterationSample Probe(const FractalView &view, const Perturbation *perturbation);
+
+	// The cap to render `sample`'s view with next; `current` is the one it
+	// was rendered with.
+	int Choose(const FloatExp &zoom, int current, const IterationSample &sample);
+
+	// Share of the last sample's pixels at the cap, and of the iterations
+	// spent on them.
+	double GetCappedShare() const;
+	double GetCappedWorkShare() const;
+
+private:
+	IterationSample m_Last;
+};
@@ -0,0 +1,83 @@
+#include "JuliaPreview.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+namespace
+{
+	// Principal square root; the other branch is its negation.
+	dvec2 Sqrt(double x, double y)
+	{
+		const double r = std::sqrt(x * x + y * y);
+		const double re = std::sqrt(0.5 * (r + x));
+		const double im = std::copysign(std::sqrt(0.5 * std::max(r - x, 0.0)), y);
+		return dvec2 { re, im };
+	}
+}
+
+void JuliaPreview::Render(const FractalView &view)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	m_Width = view.Width;
+	m_Height = view.Height;
+	m_Iterations.assign((size_t) m_Width * m_Height, 0.0f);
+	m_PixelHits.assign(m_Iterations.size(), 0);
+	m_GridHits.assign((size_t) GridSize * GridSize, 0);
+	m_Points = 0;
+
+	const double cx = view.JuliaC.x, cy = view.JuliaC.y;
+	// The set lies within |z| <= 1/2 + sqrt(1/4 + |c|).
+	const double radius = 0.5 + std::sqrt(0.25 + std::sqrt(cx * cx + cy * cy));
+	const double gridScale = GridSize / (2.0 * radius);
+
+	// Inverse of the kernels' pixel mapping,
+	// z = (pixel + 0.5 - size / 2) / zoom - offset.
+	const double zoom = view.Zoom.ToDouble();
+	const double originX = view.Offset.x * zoom + (double) m_Width / 2.0;
+	const double originY = view.Offset.y * zoom + (double) m_Height / 2.0;
+
+	// Repelling fixed point z = 1/2 + sqrt(1/4 - c), always on the boundary.
+	const dvec2 root = Sqrt(0.25 - cx, -cy);
+	m_Stack.clear();
+	m_Stack.push_back(dvec2 { 0.5 + root.x, root.y });
+
+	while (!m_Stack.empty() && m_Points < MaxPoints)
+	{
+		const dvec2 z = m_Stack.back();
+		m_Stack.pop_back();
+		m_Points++;
+
+		const double px = z.x * zoom + originX;
+		const double py = z.y * zoom + originY;
+		if (px >= 0.0 && py >= 0.0 && px < (double) m_Width && py < (double) m_Height)
+		{
+			const size_t pixel = (size_t) py * m_Width + (size_t) px;
+			if (m_PixelHits[pixel] >= MaxPixelHits)
+				continue;
+			m_PixelHits[pixel]++;
+			m_Iterations[pixel] = BoundaryValue;
+		}
+		else
+		{
+			const double gx = (z.x + radius) * gridScale;
+			const double gy = (z.y + radius) * gridScale;
+			if (gx >= 0.0 && gy >= 0.0 && gx < (double) GridSize && gy < (double) GridSize)
+			{
+				const size_t cell = (size_t) gy * GridSize + (size_t) gx;
+				if (m_GridHits[cell] >= MaxPixelHits)
+					continue;
+				m_GridHits[cell]++;
+			}
+		}
+
+		const dvec2 w = Sqrt(z.x - cx, z.y - cy);
+		m_Stack.push_back(w);
+		m_Stack.push_back(dvec2 { -w.x, -w.y });
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	m_Milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
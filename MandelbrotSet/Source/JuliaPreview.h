@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Core.h"
+#include "Fractal.h"
+
+#include <vector>
+
+
+// Quick outline of a Julia set for while c is being dragged, by the modified
+// inverse iteration method (MIIM). The set's boundary is invariant under both
+// branches of z -> ±sqrt(z - c), and repelled from everywhere else, so walking
+// the tree of preimages from a point on it (the repelling fixed point) lands
+// on the boundary every step. The tree doubles with each level and piles up
+// in a few places, so a branch is cut once the pixel it reaches has been hit
+// MaxPixelHits times; a whole outline takes a few points per boundary pixel
+// instead of MaxIterations per screen pixel.
+//
+// Produces the same buffer layout as CpuRenderer, with boundary pixels at
+// BoundaryValue and everything else 0, for the same colorize pass.
+class JuliaPreview
+{
+public:
+	static constexpr u32 MaxPixelHits = 2;
+	// Preimages that land off screen are culled on a GridSize x GridSize grid
+	// over the disc the whole set lies in instead, so branches leaving the
+	// view can still come back into it without the walk covering the set at
+	// screen resolution.
+	static constexpr u32 GridSize = 1024;
+	// Hard cap on points per Render(), in case the grid does not cut enough.
+	static constexpr u64 MaxPoints = 1ull << 22;
+	static constexpr float BoundaryValue = 0.5f;
+
+	// Only view.Type == FractalType::JuliaSet is meaningful.
+	void Render(const FractalView &view);
+
+	const std::vector<float> &GetIterations() const { return m_Iterations; }
+	u32 GetWidth() const { return m_Width; }
+	u32 GetHeight() const { return m_Height; }
+
+	// Preimages visited by the last Render() and the time it took.
+	u64 GetPoints() const { return m_Points; }
+	double GetMilliseconds() const { return m_Milliseconds; }
+
+private:
+	std::vector<float> m_Iterations;
+	std::vector<u8> m_PixelHits;
+	std::vector<u8> m_GridHits;
+	std::vector<dvec2> m_Stack;
+	u32 m_Width = 0, m_Height = 0;
+
+	u64 m_Points = 0;
+	double m_Milliseconds = 0.0;
+};
@@ -1,11 +1,20 @@
 #include "Application.h"
+#include "Headless.h"
+
+#include <cstring>
 
 
 int main(int argc, char **argv)
 {
-	(void) argc; (void) argv;
+	// --headless renders on the CPU without ever touching GLFW / OpenGL, so it
+	// also works on render nodes that have neither a GPU nor a display.
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+			return Headless::Run(argc, argv);
+	}
 
 	Application app;
 	app.Run();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,435 @@
+#include "Perturbation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+namespace
+{
+	inline dvec2 Mul(dvec2 a, dvec2 b)
+	{
+		return dvec2 { a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x };
+	}
+	inline double Magnitude(dvec2 a)
+	{
+		return std::hypot(a.x, a.y);
+	}
+
+	inline FloatExpVec2 Mul(const FloatExpVec2 &a, const FloatExpVec2 &b)
+	{
+		return FloatExpVec2 { a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x };
+	}
+	inline FloatExpVec2 Mul(dvec2 a, const FloatExpVec2 &b)
+	{
+		return Mul(FloatExpVec2 { a.x, a.y }, b);
+	}
+	inline FloatExpVec2 Add(const FloatExpVec2 &a, const FloatExpVec2 &b)
+	{
+		return FloatExpVec2 { a.x + b.x, a.y + b.y };
+	}
+	inline FloatExp Norm(const FloatExpVec2 &a)
+	{
+		return a.x * a.x + a.y * a.y;
+	}
+
+	// Escape and glitch tests at z_n = Z_n + d_n, shared by the double and
+	// extended loops. Returns true once the pixel is decided.
+	inline bool IsFinished(const dvec2 &Z, double dx, double dy, int n, int &escaped, bool &glitch)
+	{
+		const double zx = Z.x + dx;
+		const double zy = Z.y + dy;
+		const double norm = zx * zx + zy * zy;
+		if (norm > 16.0)
+		{
+			// The shaders' loop would have broken out with n - 1.
+			escaped = n - 1;
+			glitch = false;
+			return true;
+		}
+		if (norm < Perturbation::GlitchTolerance * (Z.x * Z.x + Z.y * Z.y))
+		{
+			escaped = n;
+			glitch = true;
+			return true;
+		}
+		return false;
+	}
+}
+
+
+bool Perturbation::Update(const FractalView &view, const BigVec2 &offset)
+{
+	if (m_Version != 0 && view.Zoom == m_Zoom && view.MaxIterations == m_MaxIterations &&
+		view.Width == m_Width && view.Height == m_Height && m_SeriesEnabled == m_SeriesComputedEnabled &&
+		m_BlaEnabled == m_BlaComputedEnabled &&
+		offset.x == m_Offset.x && offset.y == m_Offset.y)
+		return false;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	const int maxIterations = std::max(view.MaxIterations, 0);
+
+	m_ReferencePixel = dvec2 { 0.0, 0.0 };
+	ComputeOrbitAt(view, offset, m_ReferencePixel, m_Orbit);
+
+	// A reference that escapes early leaves every slower pixel without Z_n to
+	// iterate against. If the centre escapes, probe a coarse grid across the
+	// view and keep whichever point survives longest.
+	if (m_Orbit.size() < (size_t) maxIterations + 1)
+	{
+		std::vector<dvec2> candidate;
+		for (int j = -2; j <= 2; j++)
+		{
+			for (int i = -2; i <= 2; i++)
+			{
+				if (i == 0 && j == 0)
+					continue;
+
+				const dvec2 pixel = { i * (double) view.Width / 6.0, j * (double) view.Height / 6.0 };
+				ComputeOrbitAt(view, offset, pixel, candidate);
+				if (candidate.size() > m_Orbit.size())
+				{
+					m_Orbit.swap(candidate);
+					m_ReferencePixel = pixel;
+				}
+			}
+		}
+	}
+
+	ComputeSeries(view);
+
+	if (m_BlaEnabled)
+		m_Bla.Build(m_Orbit, FloatExp(m_SeriesRadius) / view.Zoom);
+	else
+		m_Bla.Clear();
+	m_Secondary.clear();
+
+	m_Offset = offset;
+	m_Zoom = view.Zoom;
+	m_MaxIterations = view.MaxIterations;
+	m_Width = view.Width;
+	m_Height = view.Height;
+	m_SeriesComputedEnabled = m_SeriesEnabled;
+	m_BlaComputedEnabled = m_BlaEnabled;
+	m_Version++;
+
+	const auto end = std::chrono::steady_clock::now();
+	m_OrbitMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	return true;
+}
+
+int Perturbation::AddReference(const FractalView &view, dvec2 pixel)
+{
+	for (size_t i = 0; i < m_Secondary.size(); i++)
+	{
+		if (m_Secondary[i].Pixel.x == pixel.x && m_Secondary[i].Pixel.y == pixel.y)
+			return (int) i + 1;
+	}
+
+	Reference reference;
+	reference.Pixel = pixel;
+	ComputeOrbitAt(view, m_Offset, pixel, reference.Orbit);
+
+	if (m_BlaEnabled)
+	{
+		// Farthest corner from this reference, as for the main one.
+		const double dx = (double) view.Width / 2.0 + std::fabs(pixel.x);
+		const double dy = (double) view.Height / 2.0 + std::fabs(pixel.y);
+		reference.Bla.Build(reference.Orbit, FloatExp(std::hypot(dx, dy)) / view.Zoom);
+	}
+
+	m_Secondary.push_back(std::move(reference));
+	return (int) m_Secondary.size();
+}
+
+void Perturbation::ComputeOrbitAt(const FractalView &view, const BigVec2 &offset, dvec2 pixel, std::vector<dvec2> &orbit)
+{
+	// c = pixel / zoom - offset, see the shaders.
+	const u32 limbs = BigFixed::LimbsForZoom(view.Zoom);
+	const BigFixed cx = BigFixed(FloatExp(pixel.x) / view.Zoom, limbs) - offset.x;
+	const BigFixed cy = BigFixed(FloatExp(pixel.y) / view.Zoom, limbs) - offset.y;
+	ComputeOrbit(cx, cy, std::max(view.MaxIterations, 0), orbit);
+}
+
+void Perturbation::ComputeOrbit(const BigFixed &cx, const BigFixed &cy, int maxIterations, std::vector<dvec2> &orbit)
+{
+	const u32 limbs = std::max(cx.GetFractionLimbs(), cy.GetFractionLimbs());
+	BigVec2 c = { cx, cy };
+	c.SetFractionLimbs(limbs);
+
+	// Everything the loop touches is sized here, so the iterations
+	// themselves never allocate.
+	BigFixed zx(0.0, limbs);
+	BigFixed zy(0.0, limbs);
+	BigFixed xx(0.0, limbs);
+	BigFixed yy(0.0, limbs);
+	BigFixed xy(0.0, limbs);
+	std::vector<u32> scratch = BigFixed::MakeScratch(limbs);
+
+	orbit.clear();
+	orbit.reserve((size_t) maxIterations + 1);
+	orbit.push_back(dvec2 { 0.0, 0.0 });
+
+	for (int n = 0; n < maxIterations; n++)
+	{
+		BigFixed::Square(zx, xx, scratch);
+		BigFixed::Square(zy, yy, scratch);
+		BigFixed::Multiply(zx, zy, xy, scratch);
+		BigFixed::Subtract(xx, yy, zx);
+		BigFixed::Add(zx, c.x, zx);
+		BigFixed::Add(xy, xy, zy);
+		BigFixed::Add(zy, c.y, zy);
+
+		const dvec2 z = { zx.ToDouble(), zy.ToDouble() };
+		orbit.push_back(z);
+		if (z.x * z.x + z.y * z.y > ReferenceBailout)
+			break;
+	}
+}
+
+void Perturbation::ComputeSeries(const FractalView &view)
+{
+	m_SeriesSkip = 0;
+	m_Series.fill(FloatExpVec2 {});
+	m_SeriesDouble.fill(dvec2 { 0.0, 0.0 });
+
+	// Probes are the four screen corners: the pixels farthest from the
+	// reference, and so the first ones the truncated series fails for.
+	const double halfWidth = (double) view.Width / 2.0;
+	const double halfHeight = (double) view.Height / 2.0;
+	const dvec2 corners[4] = {
+		{ -halfWidth - m_ReferencePixel.x, -halfHeight - m_ReferencePixel.y },
+		{  halfWidth - m_ReferencePixel.x, -halfHeight - m_ReferencePixel.y },
+		{ -halfWidth - m_ReferencePixel.x,  halfHeight - m_ReferencePixel.y },
+		{  halfWidth - m_ReferencePixel.x,  halfHeight - m_ReferencePixel.y },
+	};
+
+	m_SeriesRadius = 1.0;
+	for (const dvec2 &corner : corners)
+		m_SeriesRadius = std::max(m_SeriesRadius, Magnitude(corner));
+
+	const int last = std::min(view.MaxIterations, GetReferenceLength() - 1);
+	if (!m_SeriesEnabled || last < 2)
+		return;
+
+	const FloatExp radius = FloatExp(m_SeriesRadius) / view.Zoom;
+	// Compared squared: |a| <= tol |b|  <=>  |a|^2 <= tol^2 |b|^2.
+	const FloatExp tolerance = SeriesTolerance * SeriesTolerance;
+
+	// b_{k,n+1} = 2 Z_n b_{k,n} + sum_{i+j=k} b_{i,n} b_{j,n} + [k == 1] r,
+	// i.e. the usual a_k recurrence with every term scaled by r^k.
+	std::array<FloatExpVec2, SeriesTerms> b = {};
+	std::array<FloatExpVec2, SeriesTerms> next = {};
+
+	FloatExpVec2 probeDelta[4] = {};
+	FloatExpVec2 probeDc[4];
+	dvec2 probeU[4];
+	for (int p = 0; p < 4; p++)
+	{
+		probeDc[p] = FloatExpVec2 { FloatExp(corners[p].x) / view.Zoom, FloatExp(corners[p].y) / view.Zoom };
+		probeU[p] = dvec2 { corners[p].x / m_SeriesRadius, corners[p].y / m_SeriesRadius };
+	}
+
+	// Stop one short of `last` so every pixel still runs at least one
+	// iteration of its own (and gets its escape test).
+	for (int n = 0; n < last - 1; n++)
+	{
+		const dvec2 twoZ = { 2.0 * m_Orbit[n].x, 2.0 * m_Orbit[n].y };
+		for (int k = 0; k < SeriesTerms; k++)
+		{
+			FloatExpVec2 sum = Mul(twoZ, b[k]);
+			for (int i = 0; i < k; i++)
+				sum = Add(sum, Mul(b[i], b[k - 1 - i]));
+			next[k] = sum;
+		}
+		next[0].x += radius;
+
+		bool valid = Norm(next[SeriesTerms - 1]) <= tolerance * Norm(next[0]);
+		for (int p = 0; p < 4 && valid; p++)
+		{
+			FloatExpVec2 &d = probeDelta[p];
+			d = Add(Add(Mul(twoZ, d), Mul(d, d)), probeDc[p]);
+
+			const double zx = m_Orbit[n + 1].x + d.x.ToDouble();
+			const double zy = m_Orbit[n + 1].y + d.y.ToDouble();
+			if (zx * zx + zy * zy > 16.0)
+			{
+				valid = false;
+				break;
+			}
+
+			FloatExpVec2 series = {};
+			dvec2 uk = probeU[p];
+			for (int k = 0; k < SeriesTerms; k++)
+			{
+				series = Add(series, Mul(uk, next[k]));
+				uk = Mul(uk, probeU[p]);
+			}
+			const FloatExpVec2 error = { series.x - d.x, series.y - d.y };
+			valid = Norm(error) <= tolerance * Norm(d);
+		}
+		if (!valid)
+			break;
+
+		b = next;
+		m_SeriesSkip = n + 1;
+	}
+	m_Series = b;
+	for (int k = 0; k < SeriesTerms; k++)
+		m_SeriesDouble[k] = dvec2 { b[k].x.ToDouble(), b[k].y.ToDouble() };
+}
+
+FloatExpVec2 Perturbation::EvaluateSeries(dvec2 pixelOffset) const
+{
+	const dvec2 u = { pixelOffset.x / m_SeriesRadius, pixelOffset.y / m_SeriesRadius };
+
+	FloatExpVec2 result = {};
+	dvec2 uk = u;
+	for (int k = 0; k < SeriesTerms; k++)
+	{
+		result = Add(result, Mul(uk, m_Series[k]));
+		uk = Mul(uk, u);
+	}
+	return result;
+}
+
+dvec2 Perturbation::EvaluateSeriesDouble(dvec2 pixelOffset) const
+{
+	const dvec2 u = { pixelOffset.x / m_SeriesRadius, pixelOffset.y / m_SeriesRadius };
+
+	dvec2 result = { 0.0, 0.0 };
+	dvec2 uk = u;
+	for (int k = 0; k < SeriesTerms; k++)
+	{
+		const dvec2 term = Mul(m_SeriesDouble[k], uk);
+		result.x += term.x;
+		result.y += term.y;
+		uk = Mul(uk, u);
+	}
+	return result;
+}
+
+u32 Perturbation::IterateSpan(const FractalView &view, u32 x, u32 y, u32 count, float *out,
+	u8 *glitched, int reference) const
+{
+	if (view.MaxIterations <= 0)
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			out[i] = 0.0f;
+			if (glitched)
+				glitched[i] = 0;
+		}
+		return 0;
+	}
+
+	const Reference *secondary = reference > 0 ? &m_Secondary[reference - 1] : nullptr;
+	const std::vector<dvec2> &orbit = secondary ? secondary->Orbit : m_Orbit;
+	const BlaTable &bla = secondary ? secondary->Bla : m_Bla;
+	const dvec2 referencePixel = secondary ? secondary->Pixel : m_ReferencePixel;
+	const int seriesSkip = secondary ? 0 : m_SeriesSkip;
+
+	const FloatExp scale = FloatExp(1.0) / view.Zoom;
+	const bool extended = scale.GetExponent() < DoubleDeltaExponent;
+	const double scaleDouble = scale.ToDouble();
+
+	const double offsetY = ((double) y + 0.5) - (double) view.Height / 2.0 - referencePixel.y;
+	const FloatExp extendedDcy = FloatExp(offsetY) * scale;
+	const double dcy = extendedDcy.ToDouble();
+	const int last = std::min(view.MaxIterations, (int) orbit.size() - 1);
+
+	// c = pixel / zoom - offset, as in the shaders.
+	const double cy = (offsetY + referencePixel.y) * scaleDouble - view.Offset.y;
+
+	u32 interior = 0;
+	for (u32 i = 0; i < count; i++)
+	{
+		const double offsetX = ((double) (x + i) + 0.5) - (double) view.Width / 2.0 - referencePixel.x;
+		double dcx = offsetX * scaleDouble;
+
+		if (MainComponentPeriod((offsetX + referencePixel.x) * scaleDouble - view.Offset.x, cy, InteriorMargin) > 0)
+		{
+			out[i] = 1.0f;
+			if (glitched)
+				glitched[i] = 0;
+			interior++;
+			continue;
+		}
+
+		// n counts the iterations d has been advanced by.
+		int n = seriesSkip;
+		int escaped = last;
+		// Running into the end of a reference that escaped early leaves the
+		// pixel undecided.
+		bool glitch = last < view.MaxIterations;
+		bool finished = false;
+
+		double dx = 0.0, dy = 0.0;
+		if (extended)
+		{
+			const FloatExpVec2 dc = { FloatExp(offsetX) * scale, extendedDcy };
+			FloatExpVec2 d = seriesSkip > 0 ? EvaluateSeries(dvec2 { offsetX, offsetY }) : FloatExpVec2 {};
+
+			while (n < last && std::max(d.x.GetExponent(), d.y.GetExponent()) < DoubleDeltaExponent)
+			{
+				int length = 0;
+				if (const BlaStep *step = bla.Lookup(n, Norm(d), last, length))
+				{
+					d = Add(Mul(step->A, d), Mul(step->B, dc));
+					n += length;
+				}
+				else
+				{
+					const dvec2 &Z = orbit[n];
+					d = Add(Add(Mul(dvec2 { 2.0 * Z.x, 2.0 * Z.y }, d), Mul(d, d)), dc);
+					n++;
+				}
+
+				if (IsFinished(orbit[n], d.x.ToDouble(), d.y.ToDouble(), n, escaped, glitch))
+				{
+					finished = true;
+					break;
+				}
+			}
+
+			dx = d.x.ToDouble();
+			dy = d.y.ToDouble();
+			dcx = dc.x.ToDouble();
+		}
+		else if (seriesSkip > 0)
+		{
+			const dvec2 d = EvaluateSeriesDouble(dvec2 { offsetX, offsetY });
+			dx = d.x;
+			dy = d.y;
+		}
+
+		while (!finished && n < last)
+		{
+			int length = 0;
+			if (const BlaStep *step = bla.Lookup(n, dx * dx + dy * dy, last, length))
+			{
+				const double ndx = (step->A.x * dx - step->A.y * dy) + (step->B.x * dcx - step->B.y * dcy);
+				const double ndy = (step->A.x * dy + step->A.y * dx) + (step->B.x * dcy + step->B.y * dcx);
+				dx = ndx;
+				dy = ndy;
+				n += length;
+			}
+			else
+			{
+				const dvec2 &Z = orbit[n];
+				const double ndx = 2.0 * (Z.x * dx - Z.y * dy) + (dx * dx - dy * dy) + dcx;
+				const double ndy = 2.0 * (Z.x * dy + Z.y * dx) + 2.0 * dx * dy + dcy;
+				dx = ndx;
+				dy = ndy;
+				n++;
+			}
+
+			finished = IsFinished(orbit[n], dx, dy, n, escaped, glitch);
+		}
+		out[i] = (float) escaped / (float) view.MaxIterations;
+		if (glitched)
+			glitched[i] = glitch ? 1 : 0;
+	}
+	return interior;
+}
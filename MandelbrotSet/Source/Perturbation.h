@@ -0,0 +1,165 @@
+#pragma once
+
+#include "BigFixed.h"
+#include "BlaTable.h"
+#include "FloatExp.h"
+#include "Fractal.h"
+
+#include <array>
+#include <vector>
+
+
+// Deep-zoom Mandelbrot via perturbation theory. One reference orbit Z_n is
+// iterated in BigFixed at a reference point C; every pixel c = C + dc then
+// only iterates its difference to that orbit,
+//
+//     d_{n+1} = 2 Z_n d_n + d_n^2 + dc,    z_n = Z_n + d_n,
+//
+// which stays small and therefore representable in float/double long after
+// c itself has run out of mantissa bits.
+//
+// Used by the fragment shader (orbit uploaded as a texture) and by the CPU
+// renderer (IterateSpan) whenever IsRequired() says so.
+class Perturbation
+{
+public:
+	// The reference is allowed to run past the pixel bailout for a few more
+	// iterations, so neighbours that escape slightly later than it still
+	// find Z_n values to iterate against.
+	static constexpr double ReferenceBailout = 1.0e8;
+
+	// Series approximation: for the first N iterations every pixel's delta
+	// follows a polynomial in dc,  d_n ~= sum_k a_{k,n} dc^k,  whose
+	// coefficients only depend on the reference orbit. Pixels evaluate the
+	// polynomial once and start iterating at n = N instead of 0.
+	static constexpr int SeriesTerms = 8;
+	// Relative error the truncated series may introduce into d_N, checked
+	// both on the coefficients and against exactly iterated probe pixels.
+	static constexpr double SeriesTolerance = 1.0e-9;
+
+	// Pauldelbrot's criterion: once |Z_n + d_n|^2 < GlitchTolerance |Z_n|^2
+	// the delta has cancelled the reference down to its rounding noise and
+	// the pixel follows the wrong orbit from there on. Such pixels are
+	// reported as glitched and re-rendered against a reference of their own.
+	static constexpr double GlitchTolerance = 1.0e-6;
+
+	// Deltas start out around 1 / zoom. Once that drops below 2^-900 (zoom
+	// ~1e271) they are iterated as FloatExp, and handed to the double loop
+	// as soon as they grow past 2^-900 themselves: from there d^2 may flush
+	// to zero, and dc is either still exact or negligible next to d.
+	static constexpr int DoubleDeltaExponent = -900;
+
+	// Pixels are tested with MainComponentPeriod() on c rounded to double
+	// (the view centre's low bits dropped), so they must be inside by this
+	// margin, far above that rounding, to count as interior.
+	static constexpr double InteriorMargin = 1.0e-12;
+
+	// Past float-float on the GPU (and fp64 on the CPU) both renderers switch
+	// to perturbation; the Julia set has no reference orbit to perturb.
+	static bool IsRequired(const FractalView &view)
+	{
+		return view.Type == FractalType::Mandelbrot && view.Zoom > MaxFloatFloatZoomLevel;
+	}
+
+	// Prepares the reference orbit for `view`, centred on the high-precision
+	// `offset` (same sign convention as u_Offset). Only recomputes when the
+	// centre, zoom, size or iteration cap changed; returns true if it did.
+	bool Update(const FractalView &view, const BigVec2 &offset);
+
+	void SetSeriesEnabled(bool enabled) { m_SeriesEnabled = enabled; }
+	bool IsSeriesEnabled() const { return m_SeriesEnabled; }
+
+	// Bilinear approximation tables, built with the orbit. CPU only: the
+	// shader keeps iterating every step after the series skip.
+	void SetBlaEnabled(bool enabled) { m_BlaEnabled = enabled; }
+	bool IsBlaEnabled() const { return m_BlaEnabled; }
+	const BlaTable &GetBlaTable() const { return m_Bla; }
+
+	// Same contract as EscapeKernelFn, iterating deltas in double (FloatExp
+	// below DoubleDeltaExponent) against `reference` (0 = the main one from
+	// Update, others from AddReference).
+	// The main reference starts at the series skip; every reference jumps
+	// through its BLA table wherever it can. If `glitched` is set it receives
+	// 1 for each pixel whose result can't be trusted: it tripped the glitch
+	// test, or it outlived a reference that escaped before MaxIterations.
+	// Returns the number of pixels settled by the interior test.
+	u32 IterateSpan(const FractalView &view, u32 x, u32 y, u32 count, float *out,
+		u8 *glitched = nullptr, int reference = 0) const;
+
+	// Secondary reference at `pixel` (relative to the screen centre, like
+	// GetReferencePixel) for re-rendering glitched pixels near it; returns
+	// its index for IterateSpan. Reuses an existing reference at the same
+	// pixel, so re-rendering an unchanged view costs no new orbits. Kept
+	// until the next Update() that recomputes.
+	int AddReference(const FractalView &view, dvec2 pixel);
+	// Main reference included.
+	int GetReferenceCount() const { return 1 + (int) m_Secondary.size(); }
+
+	// Iterates Z_{n+1} = Z_n^2 + c at the precision of cx / cy into `orbit`,
+	// stopping after ReferenceBailout. Allocation-free once started.
+	static void ComputeOrbit(const BigFixed &cx, const BigFixed &cy, int maxIterations, std::vector<dvec2> &orbit);
+
+	// Z_0 .. Z_{length-1}; shorter than MaxIterations + 1 if the reference escaped.
+	const std::vector<dvec2> &GetReferenceOrbit() const { return m_Orbit; }
+	int GetReferenceLength() const { return (int) m_Orbit.size(); }
+
+	// Reference point relative to the screen centre, in framebuffer pixels.
+	dvec2 GetReferencePixel() const { return m_ReferencePixel; }
+
+	// Incremented every time the orbit is recomputed (GPU re-upload trigger).
+	u64 GetVersion() const { return m_Version; }
+	// Orbit, series and BLA table together.
+	double GetOrbitMilliseconds() const { return m_OrbitMilliseconds; }
+
+	// Iterations every pixel skips (0 with the series disabled or invalid).
+	int GetSeriesSkip() const { return m_SeriesSkip; }
+	// Coefficients b_k = a_{k,N} r^k for k = 1..SeriesTerms, with r the
+	// distance in pixels from the reference to the farthest corner divided
+	// by the zoom. The delta at N is then sum_k b_k u^k for u = dc / r,
+	// |u| <= 1: pre-scaling by r^k keeps every b_k near the size of the
+	// deltas themselves, where a_k alone would overflow at depth. Extended,
+	// since the deltas themselves underflow a double past ~1e308 of zoom.
+	const std::array<FloatExpVec2, SeriesTerms> &GetSeriesCoefficients() const { return m_Series; }
+	double GetSeriesRadius() const { return m_SeriesRadius; }   // in pixels
+
+	// The series delta at N for a pixel offset (pixels from the reference).
+	FloatExpVec2 EvaluateSeries(dvec2 pixelOffset) const;
+
+private:
+	struct Reference
+	{
+		std::vector<dvec2> Orbit;
+		dvec2 Pixel = { 0.0, 0.0 };
+		BlaTable Bla;
+	};
+
+	static void ComputeOrbitAt(const FractalView &view, const BigVec2 &offset, dvec2 pixel, std::vector<dvec2> &orbit);
+	void ComputeSeries(const FractalView &view);
+	// EvaluateSeries on m_SeriesDouble, for views that don't need FloatExp.
+	dvec2 EvaluateSeriesDouble(dvec2 pixelOffset) const;
+
+private:
+	std::vector<dvec2> m_Orbit;
+	dvec2 m_ReferencePixel = { 0.0, 0.0 };
+
+	BigVec2 m_Offset;
+	FloatExp m_Zoom = 0.0;
+	int m_MaxIterations = -1;
+	u32 m_Width = 0, m_Height = 0;
+
+	bool m_SeriesEnabled = true;
+	bool m_SeriesComputedEnabled = true;
+	int m_SeriesSkip = 0;
+	std::array<FloatExpVec2, SeriesTerms> m_Series = {};
+	std::array<dvec2, SeriesTerms> m_SeriesDouble = {};
+	double m_SeriesRadius = 1.0;
+
+	bool m_BlaEnabled = true;
+	bool m_BlaComputedEnabled = true;
+	BlaTable m_Bla;
+
+	std::vector<Reference> m_Secondary;
+
+	u64 m_Version = 0;
+	double m_OrbitMilliseconds = 0.0;
+};
@@ -106,6 +106,10 @@ void Shader::SetFloatArray(const char *name, float *values, u32 count)
 {
 	glUniform1fv(glGetUniformLocation(m_ShaderHandle, name), count, values);
 }
+void Shader::SetFloat2Array(const char *name, vec2 *values, u32 count)
+{
+	glUniform2fv(glGetUniformLocation(m_ShaderHandle, name), count, &values[0].x);
+}
 void Shader::SetDoubleArray(const char *name, double *values, u32 count)
 {
 	glUniform1dv(glGetUniformLocation(m_ShaderHandle, name), count, values);
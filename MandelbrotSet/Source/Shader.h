@@ -35,6 +35,7 @@ public:
 
 	void SetIntArray(const char *name, int *values, u32 count);
 	void SetFloatArray(const char *name, float *values, u32 count);
+	void SetFloat2Array(const char *name, vec2 *values, u32 count);
 	void SetDoubleArray(const char *name, double *values, u32 count);
 
 
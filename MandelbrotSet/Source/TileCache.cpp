@@ -0,0 +1,141 @@
+#include "TileCache.h"
+
+#include "TileStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace
+{
+	void HashCombine(size_t &seed, u64 value)
+	{
+		seed ^= std::hash<u64>()(value) + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2);
+	}
+
+	u64 Bits(double value)
+	{
+		u64 bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+}
+
+size_t TileKeyHash::operator()(const TileKey &key) const
+{
+	size_t seed = 0;
+	HashCombine(seed, (u64) key.Type);
+	HashCombine(seed, (u64) key.MaxIterations);
+	HashCombine(seed, Bits(key.Zoom.GetMantissa()));
+	HashCombine(seed, (u64) key.Zoom.GetExponent());
+	HashCombine(seed, Bits(key.JuliaC.x));
+	HashCombine(seed, Bits(key.JuliaC.y));
+	HashCombine(seed, (u64) key.Precision * 8 + (u64) key.Strategy);
+	HashCombine(seed, (u64) key.X);
+	HashCombine(seed, (u64) key.Y);
+	return seed;
+}
+
+bool TileCache::GetGridOrigin(const FractalView &view, double &x, double &y)
+{
+	// Pixel p of the view is at (p + 0.5 - size / 2) / zoom - offset, grid
+	// pixel g at (g + 0.5) / zoom, so g = p - size / 2 - offset * zoom.
+	const double zoom = view.Zoom.ToDouble();
+	const double shiftX = view.Offset.x * zoom + view.OffsetLo.x * zoom;
+	const double shiftY = view.Offset.y * zoom + view.OffsetLo.y * zoom;
+	if (!(std::fabs(shiftX) < MaxGridOrigin && std::fabs(shiftY) < MaxGridOrigin))
+		return false;
+	x = -(double) view.Width / 2.0 - shiftX;
+	y = -(double) view.Height / 2.0 - shiftY;
+	return true;
+}
+
+void TileCache::SetBudget(size_t bytes)
+{
+	m_Budget = bytes;
+	Evict();
+}
+
+bool TileCache::IsEnabled() const
+{
+	return m_Budget >= TileBytes || (m_Store && m_Store->IsOpen());
+}
+
+bool TileCache::Find(const TileKey &key, float *iterations, u32 *periods, size_t stride)
+{
+	m_Lookups++;
+	const auto found = m_Index.find(key);
+	if (found == m_Index.end())
+	{
+		if (!m_Store || !m_Store->Find(key, iterations, periods, stride))
+			return false;
+		m_Hits++;
+		InsertMemory(key, iterations, periods, stride);
+		return true;
+	}
+	m_Hits++;
+
+	m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+	const Entry &entry = *found->second;
+	for (u32 row = 0; row < TileSize; row++)
+	{
+		std::copy_n(&entry.Iterations[(size_t) row * TileSize], TileSize, iterations + row * stride);
+		std::copy_n(&entry.Periods[(size_t) row * TileSize], TileSize, periods + row * stride);
+	}
+	return true;
+}
+
+void TileCache::Insert(const TileKey &key, const float *iterations, const u32 *periods, size_t stride)
+{
+	if (m_Store)
+		m_Store->Insert(key, iterations, periods, stride);
+	InsertMemory(key, iterations, periods, stride);
+}
+
+void TileCache::InsertMemory(const TileKey &key, const float *iterations, const u32 *periods, size_t stride)
+{
+	if (m_Budget < TileBytes)
+		return;
+	const auto found = m_Index.find(key);
+	if (found != m_Index.end())
+	{
+		m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+		return;
+	}
+
+	// Reuses the storage of the tile it is about to evict, if any.
+	Entry entry;
+	if (GetBytes() + TileBytes > m_Budget)
+	{
+		m_Index.erase(m_Entries.back().Key);
+		entry = std::move(m_Entries.back());
+		m_Entries.pop_back();
+	}
+	entry.Key = key;
+	entry.Iterations.resize((size_t) TileSize * TileSize);
+	entry.Periods.resize((size_t) TileSize * TileSize);
+	for (u32 row = 0; row < TileSize; row++)
+	{
+		std::copy_n(iterations + row * stride, TileSize, &entry.Iterations[(size_t) row * TileSize]);
+		std::copy_n(periods + row * stride, TileSize, &entry.Periods[(size_t) row * TileSize]);
+	}
+	m_Entries.push_front(std::move(entry));
+	m_Index[key] = m_Entries.begin();
+	Evict();
+}
+
+void TileCache::Clear()
+{
+	m_Entries.clear();
+	m_Index.clear();
+}
+
+void TileCache::Evict()
+{
+	while (!m_Entries.empty() && GetBytes() > m_Budget)
+	{
+		m_Index.erase(m_Entries.back().Key);
+		m_Entries.pop_back();
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Core.h"
+#include "Fractal.h"
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+
+// Identifies a TileSize x TileSize block of finished iteration values. Tiles
+// live on a global pixel grid per zoom: pixel (X, Y) of it is the world point
+// ((X + 0.5) / Zoom, (Y + 0.5) / Zoom), so a view whose pixels fall on that
+// grid (see GetGridOrigin) can reuse any tile it shows in full. The
+// application zooms in fixed steps, which makes each Zoom a level of the
+// quadtree. Precision and Strategy are part of the key because both change
+// the values a little.
+struct TileKey
+{
+	FractalType Type = FractalType::Mandelbrot;
+	int MaxIterations = 0;
+	FloatExp Zoom;
+	dvec2 JuliaC = { 0.0, 0.0 };
+	int Precision = 0;
+	int Strategy = 0;
+	i64 X = 0, Y = 0;   // grid pixel of the tile's bottom left corner
+
+	friend bool operator==(const TileKey &a, const TileKey &b)
+	{
+		return a.Type == b.Type && a.MaxIterations == b.MaxIterations && a.Zoom == b.Zoom &&
+			a.JuliaC.x == b.JuliaC.x && a.JuliaC.y == b.JuliaC.y && a.Precision == b.Precision &&
+			a.Strategy == b.Strategy && a.X == b.X && a.Y == b.Y;
+	}
+};
+
+struct TileKeyHash
+{
+	size_t operator()(const TileKey &key) const;
+};
+
+class TileStore;
+
+// Least recently used cache of finished tiles, up to a memory budget, in
+// front of an optional TileStore on disk. Not thread safe; CpuRenderer only
+// touches it between tile runs.
+class TileCache
+{
+public:
+	static constexpr u32 TileSize = 128;
+	// Largest |grid pixel| a view may start at, so the grid origin is exact
+	// to well under a pixel in a double.
+	static constexpr double MaxGridOrigin = 1099511627776.0;   // 2^40
+	// How far off an integer a view's grid origin may be, in pixels, and
+	// still count as on the grid.
+	static constexpr double GridTolerance = 1.0 / 64.0;
+
+	// Grid pixel of the centre of pixel (0, 0) of `view`, minus a half:
+	// an integer when the view lies on the grid. False when the view is too
+	// far from the origin for that to be resolved.
+	static bool GetGridOrigin(const FractalView &view, double &x, double &y);
+
+	// 0, the default, keeps nothing. Lowering it evicts at once.
+	void SetBudget(size_t bytes);
+	size_t GetBudget() const { return m_Budget; }
+	// Misses fall through to `store`, and its hits are kept in memory too;
+	// inserts go to both. Null, the default, for none.
+	void SetStore(TileStore *store) { m_Store = store; }
+	TileStore *GetStore() const { return m_Store; }
+	// Whether Find() can return anything at all.
+	bool IsEnabled() const;
+
+	// Copies the tile's values and periods into rows of `stride` elements
+	// and makes it the most recently used. Counts towards the hit rate,
+	// store hits included.
+	bool Find(const TileKey &key, float *iterations, u32 *periods, size_t stride);
+	// Stores a copy of the tile, unless it is already there, then evicts
+	// the least recently used tiles past the budget.
+	void Insert(const TileKey &key, const float *iterations, const u32 *periods, size_t stride);
+	void Clear();
+
+	size_t GetTileCount() const { return m_Entries.size(); }
+	size_t GetBytes() const { return m_Entries.size() * TileBytes; }
+	u64 GetLookups() const { return m_Lookups; }
+	u64 GetHits() const { return m_Hits; }
+	double GetHitRate() const { return m_Lookups ? (double) m_Hits / (double) m_Lookups : 0.0; }
+
+private:
+	static constexpr size_t TileBytes = (size_t) TileSize * TileSize * (sizeof(float) + sizeof(u32));
+
+	struct Entry
+	{
+		TileKey Key;
+		std::vector<float> Iterations;
+		std::vector<u32> Periods;
+	};
+	void InsertMemory(const TileKey &key, const float *iterations, const u32 *periods, size_t stride);
+	void Evict();
+
+	// Most recently used first.
+	std::list<Entry> m_Entries;
+	std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> m_Index;
+	size_t m_Budget = 0;
+	TileStore *m_Store = nullptr;
+	u64 m_Lookups = 0;
+	u64 m_Hits = 0;
+};
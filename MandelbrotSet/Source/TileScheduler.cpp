@@ -0,0 +1,131 @@
+#include "TileScheduler.h"
+
+
+TileScheduler::TileScheduler(u32 threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	m_Workers.reserve(threadCount);
+	for (u32 i = 0; i < threadCount; i++)
+		m_Workers.push_back(std::make_unique<Worker>());
+
+	// Threads are started only once every Worker exists, since any of them
+	// may try to steal from any other as soon as the first Run() begins.
+	for (u32 i = 0; i < threadCount; i++)
+		m_Workers[i]->Thread = std::thread([this, i]() { WorkerLoop(i); });
+
+	LOG_INFO("TileScheduler: %u worker threads", threadCount);
+}
+TileScheduler::~TileScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Shutdown = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (auto &worker : m_Workers)
+		worker->Thread.join();
+}
+
+void TileScheduler::Run(const std::vector<Tile> &tiles, const TileFunc &func)
+{
+	if (tiles.empty())
+		return;
+
+	const u32 workerCount = GetWorkerCount();
+	const size_t tileCount = tiles.size();
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	// Contiguous slices rather than round-robin: neighbouring tiles share
+	// cache lines in the output buffer, and stealing evens out the load anyway.
+	for (u32 w = 0; w < workerCount; w++)
+	{
+		const size_t begin = tileCount * w / workerCount;
+		const size_t end = tileCount * (w + 1) / workerCount;
+
+		std::lock_guard<std::mutex> queueLock(m_Workers[w]->Mutex);
+		m_Workers[w]->Queue.clear();
+		for (size_t t = begin; t < end; t++)
+			m_Workers[w]->Queue.push_back((u32) t);
+	}
+
+	m_Tiles = &tiles;
+	m_Func = &func;
+	m_BusyWorkers = workerCount;
+	m_StealCount = 0;
+	m_Generation++;
+
+	m_WakeCondition.notify_all();
+	m_DoneCondition.wait(lock, [this]() { return m_BusyWorkers == 0; });
+
+	m_Tiles = nullptr;
+	m_Func = nullptr;
+	m_LastStealCount = m_StealCount.load();
+}
+
+void TileScheduler::WorkerLoop(u32 workerIndex)
+{
+	u64 seenGeneration = 0;
+
+	while (true)
+	{
+		const std::vector<Tile> *tiles = nullptr;
+		const TileFunc *func = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCondition.wait(lock, [&]() { return m_Shutdown || m_Generation != seenGeneration; });
+			if (m_Shutdown)
+				return;
+
+			seenGeneration = m_Generation;
+			tiles = m_Tiles;
+			func = m_Func;
+		}
+
+		// Tiles are only ever enqueued by Run(), so once both the local queue
+		// and every victim are empty there is nothing left to wait for.
+		u32 tileIndex;
+		while (PopLocal(workerIndex, tileIndex) || Steal(workerIndex, tileIndex))
+			(*func)((*tiles)[tileIndex], workerIndex);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (--m_BusyWorkers == 0)
+			m_DoneCondition.notify_one();
+	}
+}
+
+bool TileScheduler::PopLocal(u32 workerIndex, u32 &tileIndex)
+{
+	Worker &worker = *m_Workers[workerIndex];
+	std::lock_guard<std::mutex> lock(worker.Mutex);
+	if (worker.Queue.empty())
+		return false;
+
+	tileIndex = worker.Queue.front();
+	worker.Queue.pop_front();
+	return true;
+}
+bool TileScheduler::Steal(u32 workerIndex, u32 &tileIndex)
+{
+	// Take from the far end of the victim's slice so the thief and the owner
+	// work away from each other instead of contending over the same tiles.
+	const u32 workerCount = GetWorkerCount();
+	for (u32 i = 1; i < workerCount; i++)
+	{
+		Worker &victim = *m_Workers[(workerIndex + i) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if (victim.Queue.empty())
+			continue;
+
+		tileIndex = victim.Queue.back();
+		victim.Queue.pop_back();
+		m_StealCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Core.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct Tile
+{
+	u32 X = 0, Y = 0;
+	u32 Width = 0, Height = 0;
+};
+
+// Fixed pool of one worker per hardware thread. Every Run() hands each worker
+// a contiguous slice of the tile list; a worker that drains its own queue
+// steals from the back of a neighbour's, so slow tiles along the set boundary
+// never leave the remaining cores idle.
+class TileScheduler
+{
+public:
+	using TileFunc = std::function<void(const Tile &tile, u32 workerIndex)>;
+
+	// threadCount == 0 picks std::thread::hardware_concurrency().
+	explicit TileScheduler(u32 threadCount = 0);
+	~TileScheduler();
+
+	TileScheduler(const TileScheduler &) = delete;
+	TileScheduler &operator=(const TileScheduler &) = delete;
+
+	// Blocks until every tile has been processed. `func` is called
+	// concurrently from the worker threads and must only touch per-tile state.
+	void Run(const std::vector<Tile> &tiles, const TileFunc &func);
+
+	u32 GetWorkerCount() const { return (u32) m_Workers.size(); }
+	u64 GetLastStealCount() const { return m_LastStealCount; }
+
+private:
+	struct Worker
+	{
+		std::thread Thread;
+		std::mutex Mutex;
+		std::deque<u32> Queue;
+	};
+
+	void WorkerLoop(u32 workerIndex);
+	bool PopLocal(u32 workerIndex, u32 &tileIndex);
+	bool Steal(u32 workerIndex, u32 &tileIndex);
+
+private:
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCondition;
+	std::condition_variable m_DoneCondition;
+
+	const std::vector<Tile> *m_Tiles = nullptr;
+	const TileFunc *m_Func = nullptr;
+	u64 m_Generation = 0;
+	u32 m_BusyWorkers = 0;
+	bool m_Shutdown = false;
+
+	std::atomic<u64> m_StealCount { 0 };
+	u64 m_LastStealCount = 0;
+};
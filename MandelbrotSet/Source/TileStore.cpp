@@ -0,0 +1,587 @@
+#include "TileStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	// Thin layer over the two platforms' file and mapping calls. Handles
+	// are the same types as TileStore::FileHandle.
+#ifdef _WIN32
+	using Handle = void *;
+	constexpr Handle NoHandle = nullptr;
+
+	Handle OpenReadWrite(const std::string &path)
+	{
+		const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		return file == INVALID_HANDLE_VALUE ? NoHandle : file;
+	}
+
+	void CloseFile(Handle file)
+	{
+		CloseHandle(file);
+	}
+
+	u64 FileSize(Handle file)
+	{
+		LARGE_INTEGER size;
+		return GetFileSizeEx(file, &size) ? (u64) size.QuadPart : 0;
+	}
+
+	bool ResizeFile(Handle file, u64 size)
+	{
+		LARGE_INTEGER position;
+		position.QuadPart = (LONGLONG) size;
+		return SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+	}
+
+	bool ReadAt(Handle file, u64 offset, void *data, size_t size)
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD) offset;
+		overlapped.OffsetHigh = (DWORD) (offset >> 32);
+		DWORD read = 0;
+		return ReadFile(file, data, (DWORD) size, &read, &overlapped) && read == size;
+	}
+
+	bool WriteAt(Handle file, u64 offset, const void *data, size_t size)
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD) offset;
+		overlapped.OffsetHigh = (DWORD) (offset >> 32);
+		DWORD written = 0;
+		return WriteFile(file, data, (DWORD) size, &written, &overlapped) && written == size;
+	}
+
+	void Lock(Handle file)
+	{
+		OVERLAPPED overlapped = {};
+		LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+	}
+
+	void Unlock(Handle file)
+	{
+		OVERLAPPED overlapped = {};
+		UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &overlapped);
+	}
+
+	u8 *Map(Handle file, size_t size, void *&mapping)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD) ((u64) size >> 32), (DWORD) size, nullptr);
+		if (!mapping)
+			return nullptr;
+		void *data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (!data)
+		{
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+		return (u8 *) data;
+	}
+
+	void Unmap(u8 *data, void *mapping, size_t)
+	{
+		UnmapViewOfFile(data);
+		CloseHandle(mapping);
+	}
+#else
+	using Handle = int;
+	constexpr Handle NoHandle = -1;
+
+	Handle OpenReadWrite(const std::string &path)
+	{
+		return open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	}
+
+	void CloseFile(Handle file)
+	{
+		close(file);
+	}
+
+	u64 FileSize(Handle file)
+	{
+		struct stat status;
+		return fstat(file, &status) == 0 ? (u64) status.st_size : 0;
+	}
+
+	bool ResizeFile(Handle file, u64 size)
+	{
+		return ftruncate(file, (off_t) size) == 0;
+	}
+
+	bool ReadAt(Handle file, u64 offset, void *data, size_t size)
+	{
+		return pread(file, data, size, (off_t) offset) == (ssize_t) size;
+	}
+
+	bool WriteAt(Handle file, u64 offset, const void *data, size_t size)
+	{
+		return pwrite(file, data, size, (off_t) offset) == (ssize_t) size;
+	}
+
+	void Lock(Handle file)
+	{
+		flock(file, LOCK_EX);
+	}
+
+	void Unlock(Handle file)
+	{
+		flock(file, LOCK_UN);
+	}
+
+	u8 *Map(Handle file, size_t size, void *&mapping)
+	{
+		void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		mapping = nullptr;
+		return data == MAP_FAILED ? nullptr : (u8 *) data;
+	}
+
+	void Unmap(u8 *data, void *, size_t size)
+	{
+		munmap(data, size);
+	}
+#endif
+
+	// Shared between processes, so wall-clock rather than steady time.
+	u64 Now()
+	{
+		const auto now = std::chrono::system_clock::now().time_since_epoch();
+		return (u64) std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+	}
+
+	constexpr u32 NoSlot = ~0u;
+}
+
+TileStore::~TileStore()
+{
+	Close();
+}
+
+bool TileStore::Open(const std::string &directory)
+{
+	Close();
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	m_Directory = directory;
+	m_Index = OpenReadWrite((std::filesystem::path(directory) / "index.bin").string());
+	if (m_Index == InvalidFile)
+	{
+		std::fprintf(stderr, "[ERROR] Could not open tile store '%s'\n", directory.c_str());
+		return false;
+	}
+
+	Lock(m_Index);
+	IndexHeader header = {};
+	if (FileSize(m_Index) < sizeof(header))
+	{
+		header = { Magic, Version, 1, 0 };
+		WriteAt(m_Index, 0, &header, sizeof(header));
+	}
+	else
+	{
+		ReadAt(m_Index, 0, &header, sizeof(header));
+	}
+	const bool valid = Refresh(header);
+	if (valid)
+		RemoveStalePacks();
+	Unlock(m_Index);
+
+	if (!valid)
+	{
+		std::fprintf(stderr, "[ERROR] '%s' is not a tile store of this version\n", directory.c_str());
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void TileStore::Close()
+{
+	UnmapPacks();
+	if (m_Index != InvalidFile)
+		CloseFile(m_Index);
+	m_Index = InvalidFile;
+	m_Generation = 0;
+	m_IndexRead = 0;
+	m_SlotCount = 0;
+	m_Slots.clear();
+}
+
+bool TileStore::Find(const TileKey &key, float *iterations, u32 *periods, size_t stride)
+{
+	if (!IsOpen())
+		return false;
+	m_Lookups++;
+
+	auto found = m_Slots.find(key);
+	if (found == m_Slots.end())
+	{
+		// Another process may have stored it, or compacted the store.
+		IndexHeader header;
+		if (!ReadAt(m_Index, 0, &header, sizeof(header)) ||
+			(header.Generation == m_Generation && FileSize(m_Index) == m_IndexRead))
+			return false;
+		Lock(m_Index);
+		Refresh(header);
+		Unlock(m_Index);
+		found = m_Slots.find(key);
+		if (found == m_Slots.end())
+			return false;
+	}
+
+	const u32 slot = found->second;
+	const u8 *data = GetSlotData(slot);
+	if (!data)
+		return false;
+	SlotHeader &slotHeader = GetSlotHeader(slot);
+	const DiskKey expected = ToDisk(key);
+	if (!SameKey(slotHeader.Key, expected))
+	{
+		m_Slots.erase(found);
+		return false;
+	}
+
+	constexpr u32 size = TileCache::TileSize;
+	const float *tileIterations = (const float *) data;
+	const u32 *tilePeriods = (const u32 *) (data + (size_t) size * size * sizeof(float));
+	for (u32 row = 0; row < size; row++)
+	{
+		std::copy_n(&tileIterations[(size_t) row * size], size, iterations + row * stride);
+		std::copy_n(&tilePeriods[(size_t) row * size], size, periods + row * stride);
+	}
+	// A writer recycling the slot meanwhile clears its key first.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!SameKey(slotHeader.Key, expected))
+	{
+		m_Slots.erase(found);
+		return false;
+	}
+
+	slotHeader.LastUsed = Now();
+	m_Hits++;
+	return true;
+}
+
+void TileStore::Insert(const TileKey &key, const float *iterations, const u32 *periods, size_t stride)
+{
+	if (!IsOpen() || m_Capacity < TileBytes)
+		return;
+	const DiskKey diskKey = ToDisk(key);
+	auto found = m_Slots.find(key);
+	if (found != m_Slots.end() && GetSlotData(found->second) && SameKey(GetSlotHeader(found->second).Key, diskKey))
+	{
+		GetSlotHeader(found->second).LastUsed = Now();
+		return;
+	}
+
+	Lock(m_Index);
+	IndexHeader header;
+	if (!ReadAt(m_Index, 0, &header, sizeof(header)) || !Refresh(header))
+	{
+		Unlock(m_Index);
+		return;
+	}
+	found = m_Slots.find(key);
+	if (found != m_Slots.end() && GetSlotData(found->second) && SameKey(GetSlotHeader(found->second).Key, diskKey))
+	{
+		GetSlotHeader(found->second).LastUsed = Now();
+		Unlock(m_Index);
+		return;
+	}
+
+	const u32 slot = AllocateSlot(header);
+	u8 *data = slot != NoSlot ? GetSlotData(slot) : nullptr;
+	if (!data)
+	{
+		Unlock(m_Index);
+		return;
+	}
+
+	SlotHeader &slotHeader = GetSlotHeader(slot);
+	if (slotHeader.Key.Valid)
+	{
+		const auto recycled = m_Slots.find(FromDisk(slotHeader.Key));
+		if (recycled != m_Slots.end() && recycled->second == slot)
+			m_Slots.erase(recycled);
+	}
+	slotHeader.Key.Valid = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	constexpr u32 size = TileCache::TileSize;
+	float *tileIterations = (float *) data;
+	u32 *tilePeriods = (u32 *) (data + (size_t) size * size * sizeof(float));
+	for (u32 row = 0; row < size; row++)
+	{
+		std::copy_n(iterations + row * stride, size, &tileIterations[(size_t) row * size]);
+		std::copy_n(periods + row * stride, size, &tilePeriods[(size_t) row * size]);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	slotHeader.Key = diskKey;
+	slotHeader.LastUsed = Now();
+
+	const IndexRecord record = { diskKey, slot / PackTiles, slot % PackTiles };
+	if (WriteAt(m_Index, m_IndexRead, &record, sizeof(record)))
+	{
+		m_IndexRead += sizeof(record);
+		m_Slots[key] = slot;
+	}
+	WriteAt(m_Index, 0, &header, sizeof(header));
+	m_SlotCount = header.SlotCount;
+	Unlock(m_Index);
+}
+
+bool TileStore::Compact(size_t bytes)
+{
+	if (!IsOpen())
+		return false;
+
+	Lock(m_Index);
+	IndexHeader header;
+	if (!ReadAt(m_Index, 0, &header, sizeof(header)) || !Refresh(header))
+	{
+		Unlock(m_Index);
+		return false;
+	}
+
+	// Live tiles only: superseded and recycled slots have other keys now.
+	struct Live
+	{
+		TileKey Key;
+		u32 Slot;
+		u64 LastUsed;
+	};
+	std::vector<Live> live;
+	for (const auto &[key, slot] : m_Slots)
+	{
+		if (GetSlotData(slot) && SameKey(GetSlotHeader(slot).Key, ToDisk(key)))
+			live.push_back({ key, slot, GetSlotHeader(slot).LastUsed });
+	}
+	std::sort(live.begin(), live.end(), [](const Live &a, const Live &b) { return a.LastUsed > b.LastUsed; });
+	live.resize(std::min(live.size(), bytes / TileBytes));
+
+	// Fills the new generation's packs beside the old ones, then swaps.
+	std::vector<Pack> oldPacks = std::move(m_Packs);
+	m_Packs.clear();
+	const u32 oldGeneration = m_Generation;
+	m_Generation = header.Generation + 1;
+	std::vector<IndexRecord> records;
+	records.reserve(live.size());
+	bool written = true;
+	for (u32 slot = 0; slot < (u32) live.size() && written; slot++)
+	{
+		const Live &tile = live[slot];
+		const Pack &source = oldPacks[tile.Slot / PackTiles];
+		u8 *data = GetSlotData(slot);
+		written = data != nullptr;
+		if (!written)
+			break;
+		std::memcpy(data, source.Data + PackDataOffset + (size_t) (tile.Slot % PackTiles) * TileBytes, TileBytes);
+		GetSlotHeader(slot) = ((const SlotHeader *) source.Data)[tile.Slot % PackTiles];
+		records.push_back({ ToDisk(tile.Key), slot / PackTiles, slot % PackTiles });
+	}
+
+	if (!written)
+	{
+		// Out of disk space, most likely: keep the old generation.
+		std::fprintf(stderr, "[ERROR] Could not compact tile store '%s'\n", m_Directory.c_str());
+		UnmapPacks();
+		m_Packs = std::move(oldPacks);
+		m_Generation = oldGeneration;
+		RemoveStalePacks();
+		Unlock(m_Index);
+		return false;
+	}
+
+	header.Generation = m_Generation;
+	header.SlotCount = (u32) records.size();
+	ResizeFile(m_Index, sizeof(header));
+	WriteAt(m_Index, sizeof(header), records.data(), records.size() * sizeof(IndexRecord));
+	WriteAt(m_Index, 0, &header, sizeof(header));
+
+	for (Pack &pack : oldPacks)
+	{
+		if (pack.Data)
+			Unmap(pack.Data, pack.Mapping, PackBytes);
+		if (pack.File != InvalidFile)
+			CloseFile(pack.File);
+	}
+	m_Slots.clear();
+	for (u32 slot = 0; slot < (u32) live.size(); slot++)
+		m_Slots[live[slot].Key] = slot;
+	m_IndexRead = sizeof(header) + records.size() * sizeof(IndexRecord);
+	m_SlotCount = header.SlotCount;
+	RemoveStalePacks();
+	Unlock(m_Index);
+	return true;
+}
+
+TileStore::DiskKey TileStore::ToDisk(const TileKey &key)
+{
+	DiskKey disk = {};
+	disk.Type = (u32) key.Type;
+	disk.MaxIterations = key.MaxIterations;
+	disk.ZoomMantissa = key.Zoom.GetMantissa();
+	disk.ZoomExponent = key.Zoom.GetExponent();
+	disk.Precision = key.Precision;
+	disk.Strategy = key.Strategy;
+	disk.Valid = 1;
+	disk.JuliaCX = key.JuliaC.x;
+	disk.JuliaCY = key.JuliaC.y;
+	disk.X = key.X;
+	disk.Y = key.Y;
+	return disk;
+}
+
+TileKey TileStore::FromDisk(const DiskKey &disk)
+{
+	TileKey key;
+	key.Type = (FractalType) disk.Type;
+	key.MaxIterations = disk.MaxIterations;
+	key.Zoom = FloatExp::FromParts(disk.ZoomMantissa, disk.ZoomExponent);
+	key.JuliaC = { disk.JuliaCX, disk.JuliaCY };
+	key.Precision = disk.Precision;
+	key.Strategy = disk.Strategy;
+	key.X = disk.X;
+	key.Y = disk.Y;
+	return key;
+}
+
+bool TileStore::SameKey(const DiskKey &a, const DiskKey &b)
+{
+	return a.Valid && b.Valid && a.Type == b.Type && a.MaxIterations == b.MaxIterations &&
+		a.ZoomMantissa == b.ZoomMantissa && a.ZoomExponent == b.ZoomExponent &&
+		a.Precision == b.Precision && a.Strategy == b.Strategy &&
+		a.JuliaCX == b.JuliaCX && a.JuliaCY == b.JuliaCY && a.X == b.X && a.Y == b.Y;
+}
+
+std::string TileStore::GetPackPath(u32 generation, u32 pack) const
+{
+	char name[64];
+	std::snprintf(name, sizeof(name), "pack-%u-%u.bin", generation, pack);
+	return (std::filesystem::path(m_Directory) / name).string();
+}
+
+bool TileStore::Refresh(const IndexHeader &header)
+{
+	if (header.Magic != Magic || header.Version != Version)
+		return false;
+	if (header.Generation != m_Generation)
+	{
+		UnmapPacks();
+		m_Slots.clear();
+		m_Generation = header.Generation;
+		m_IndexRead = sizeof(IndexHeader);
+	}
+	m_SlotCount = header.SlotCount;
+
+	const u64 size = FileSize(m_Index);
+	if (size <= m_IndexRead)
+		return true;
+	std::vector<IndexRecord> records((size_t) ((size - m_IndexRead) / sizeof(IndexRecord)));
+	if (records.empty() || !ReadAt(m_Index, m_IndexRead, records.data(), records.size() * sizeof(IndexRecord)))
+		return true;
+	for (const IndexRecord &record : records)
+	{
+		if (record.Slot < PackTiles)
+			m_Slots[FromDisk(record.Key)] = record.Pack * PackTiles + record.Slot;
+	}
+	m_IndexRead += records.size() * sizeof(IndexRecord);
+	return true;
+}
+
+void TileStore::UnmapPacks()
+{
+	for (Pack &pack : m_Packs)
+	{
+		if (pack.Data)
+			Unmap(pack.Data, pack.Mapping, PackBytes);
+		if (pack.File != InvalidFile)
+			CloseFile(pack.File);
+	}
+	m_Packs.clear();
+}
+
+u8 *TileStore::MapPack(u32 pack)
+{
+	if (pack >= m_Packs.size())
+		m_Packs.resize(pack + 1);
+	Pack &mapped = m_Packs[pack];
+	if (mapped.Data)
+		return mapped.Data;
+
+	// New packs are created at full size; most filesystems keep the
+	// untouched slots sparse.
+	if (mapped.File == InvalidFile)
+		mapped.File = OpenReadWrite(GetPackPath(m_Generation, pack));
+	if (mapped.File == InvalidFile)
+		return nullptr;
+	if (FileSize(mapped.File) < PackBytes && !ResizeFile(mapped.File, PackBytes))
+		return nullptr;
+	mapped.Data = Map(mapped.File, PackBytes, mapped.Mapping);
+	return mapped.Data;
+}
+
+TileStore::SlotHeader &TileStore::GetSlotHeader(u32 slot)
+{
+	return ((SlotHeader *) m_Packs[slot / PackTiles].Data)[slot % PackTiles];
+}
+
+u8 *TileStore::GetSlotData(u32 slot)
+{
+	u8 *pack = MapPack(slot / PackTiles);
+	return pack ? pack + PackDataOffset + (size_t) (slot % PackTiles) * TileBytes : nullptr;
+}
+
+u32 TileStore::AllocateSlot(IndexHeader &header)
+{
+	if ((size_t) (header.SlotCount + 1) * TileBytes <= m_Capacity)
+		return header.SlotCount++;
+
+	u32 oldest = NoSlot;
+	u64 oldestUsed = ~0ull;
+	for (u32 slot = 0; slot < header.SlotCount; slot++)
+	{
+		if (!GetSlotData(slot))
+			continue;
+		const u64 used = GetSlotHeader(slot).LastUsed;
+		if (used < oldestUsed)
+		{
+			oldest = slot;
+			oldestUsed = used;
+		}
+	}
+	return oldest;
+}
+
+void TileStore::RemoveStalePacks()
+{
+	// Other processes may still have the old packs mapped. POSIX keeps
+	// them alive until unmapped; Windows refuses, and a later call retries.
+	std::error_code error;
+	for (const auto &entry : std::filesystem::directory_iterator(m_Directory, error))
+	{
+		u32 generation, pack;
+		const std::string name = entry.path().filename().string();
+		if (std::sscanf(name.c_str(), "pack-%u-%u.bin", &generation, &pack) == 2 && generation != m_Generation)
+			std::filesystem::remove(entry.path(), error);
+	}
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Core.h"
+#include "TileCache.h"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Finished tiles on disk, shared by every window and headless run pointed at
+// the same directory. Tiles go into fixed-size slots of pack files that are
+// memory-mapped whole, so a hit is one copy out of the page cache; an
+// append-only index file maps keys to slots.
+//
+// Layout, all native-endian:
+//   index.bin            IndexHeader, then one IndexRecord per stored tile;
+//                        a later record for the same key supersedes earlier
+//                        ones.
+//   pack-<gen>-<n>.bin   PackTiles SlotHeaders (padded to PackDataOffset),
+//                        then PackTiles slots of TileSize^2 floats followed
+//                        by TileSize^2 periods.
+//
+// Writers hold a lock on index.bin while they allocate a slot, fill it and
+// append its record. Readers copy without the lock and check the slot's key
+// before and after, since a full store recycles its least recently used
+// slots. Compact() rewrites the live tiles into packs of a new generation,
+// which other processes notice on their next miss.
+class TileStore
+{
+public:
+	static constexpr u32 PackTiles = 256;
+	static constexpr size_t DefaultCapacity = (size_t) 4096 << 20;
+
+	TileStore() = default;
+	~TileStore();
+
+	TileStore(const TileStore &) = delete;
+	TileStore &operator=(const TileStore &) = delete;
+
+	// Creates the directory and an empty index if needed.
+	bool Open(const std::string &directory);
+	void Close();
+	bool IsOpen() const { return m_Index != InvalidFile; }
+	const std::string &GetDirectory() const { return m_Directory; }
+
+	// Bytes of tile data this process lets the store grow to; once there,
+	// new tiles replace the least recently used ones.
+	void SetCapacity(size_t bytes) { m_Capacity = bytes; }
+	size_t GetCapacity() const { return m_Capacity; }
+
+	// Same contract as TileCache::Find() / Insert().
+	bool Find(const TileKey &key, float *iterations, u32 *periods, size_t stride);
+	void Insert(const TileKey &key, const float *iterations, const u32 *periods, size_t stride);
+	// Keeps the most recently used tiles, up to `bytes` of them, in packs of
+	// a new generation and deletes the old packs. Takes a while on a large
+	// store; every process sharing it waits on the lock meanwhile.
+	bool Compact(size_t bytes);
+
+	// Slots in use, counting superseded ones until the next Compact().
+	size_t GetTileCount() const { return m_SlotCount; }
+	size_t GetBytes() const { return m_SlotCount * TileBytes; }
+	u64 GetLookups() const { return m_Lookups; }
+	u64 GetHits() const { return m_Hits; }
+	double GetHitRate() const { return m_Lookups ? (double) m_Hits / (double) m_Lookups : 0.0; }
+
+private:
+	static constexpr size_t TileBytes = (size_t) TileCache::TileSize * TileCache::TileSize * (sizeof(float) + sizeof(u32));
+	static constexpr u32 Magic = 0x5354534D;   // "MSTS"
+	static constexpr u32 Version = 1;
+
+#ifdef _WIN32
+	using FileHandle = void *;
+	static constexpr FileHandle InvalidFile = nullptr;
+#else
+	using FileHandle = int;
+	static constexpr FileHandle InvalidFile = -1;
+#endif
+
+	// TileKey in a fixed layout.
+	struct DiskKey
+	{
+		u32 Type;
+		i32 MaxIterations;
+		double ZoomMantissa;
+		i32 ZoomExponent;
+		i32 Precision;
+		i32 Strategy;
+		u32 Valid;
+		double JuliaCX, JuliaCY;
+		i64 X, Y;
+	};
+	struct IndexHeader
+	{
+		u32 Magic;
+		u32 Version;
+		u32 Generation;
+		u32 SlotCount;
+	};
+	struct IndexRecord
+	{
+		DiskKey Key;
+		u32 Pack;
+		u32 Slot;
+	};
+	struct SlotHeader
+	{
+		DiskKey Key;
+		// Microseconds since the epoch of the last Find() or Insert().
+		u64 LastUsed;
+	};
+	// The files are shared between builds; keep the layout free of padding.
+	static_assert(sizeof(DiskKey) == 64 && sizeof(IndexRecord) == 72 && sizeof(SlotHeader) == 72, "tile store layout");
+	static constexpr size_t PackDataOffset = (PackTiles * sizeof(SlotHeader) + 4095) & ~(size_t) 4095;
+	static constexpr size_t PackBytes = PackDataOffset + PackTiles * TileBytes;
+
+	struct Pack
+	{
+		FileHandle File = InvalidFile;
+		void *Mapping = nullptr;
+		u8 *Data = nullptr;
+	};
+
+	static DiskKey ToDisk(const TileKey &key);
+	static TileKey FromDisk(const DiskKey &disk);
+	static bool SameKey(const DiskKey &a, const DiskKey &b);
+
+	std::string GetPackPath(u32 generation, u32 pack) const;
+	// Picks up the records other processes appended since the last call, or
+	// starts over after another process compacted. `header` is the index's
+	// current one; call with the lock held. False if it is not an index.
+	bool Refresh(const IndexHeader &header);
+	void UnmapPacks();
+	u8 *MapPack(u32 pack);
+	SlotHeader &GetSlotHeader(u32 slot);
+	u8 *GetSlotData(u32 slot);
+	// Next free slot, or the least recently used one once at capacity.
+	u32 AllocateSlot(IndexHeader &header);
+	void RemoveStalePacks();
+
+	std::string m_Directory;
+	FileHandle m_Index = InvalidFile;
+	u32 m_Generation = 0;
+	u64 m_IndexRead = 0;
+	u32 m_SlotCount = 0;
+	std::vector<Pack> m_Packs;
+	std::unordered_map<TileKey, u32, TileKeyHash> m_Slots;
+
+	size_t m_Capacity = DefaultCapacity;
+	u64 m_Lookups = 0;
+	u64 m_Hits = 0;
+};